@@ -7,6 +7,7 @@
 #include "ethsnarks.hpp"
 #include "utils.hpp"
 #include "gadgets/onewayfunction.hpp"
+#include "gadgets/mimc_constants.hpp"
 #include "sha3.h"
 #include <mutex>
 
@@ -182,30 +183,30 @@ class MiMCe7_gadget : public GadgetT
     }
 
     /**
-    * Caches the default round constants using a static variable
+    * The default round constants, from the precomputed Montgomery form
+    * table (see `mimc_constants.hpp`) instead of keccak and GMP
     *
-    * It is thread safe due to mutex lock, but must be initialised
-    * after libff's number system.
+    * It is thread safe, and doesn't need libff's number system to be
+    * initialised first.
     */
     static const std::vector<FieldT> &static_constants()
     {
-        static bool filled = false;
+        static_assert(sizeof(MIMC_CONSTANTS_MONTGOMERY) / sizeof(MIMC_CONSTANTS_MONTGOMERY[0]) == MIMC_ROUNDS, "One precomputed constant per round");
+
         static std::vector<FieldT> round_constants;
-        static std::mutex fill_lock;
+        static std::once_flag filled;
 
-        if (!filled)
-        {
-            fill_lock.lock();
-            constants_fill(round_constants);
-            filled = true;
-            fill_lock.unlock();
-        }
+        std::call_once(filled, []() {
+            round_constants = field_table(MIMC_CONSTANTS_MONTGOMERY);
+        });
 
         return round_constants;
     }
 
     /**
     * Generate a sequence of round constants from an initial seed value.
+    *
+    * Hashes the seed for every round, for custom seeds or round counts.
     */
     static void constants_fill(std::vector<FieldT> &round_constants, const char *seed = MIMC_SEED, int round_count = MIMC_ROUNDS)
     {
@@ -270,19 +271,30 @@ class MiMC_hash_MiyaguchiPreneel_gadget : public MiyaguchiPreneel_OWF<MiMC_gadge
 // generic aliases for 'MiMC', masks specific implementation
 using MiMC_hash_gadget = MiMC_hash_MiyaguchiPreneel_gadget;
 
+/**
+* Native MiMC-p/p with exponent 7, evaluated directly on field elements
+* without a protoboard.
+*
+* Bit-identical to `MiMCe7_gadget::generate_r1cs_witness` and `MiMC.MiMCpe7`:
+*
+*   t = x + k + C[i]
+*   x = t^7
+*
+* and the key is added once more to the result of the last round.
+*/
 const FieldT mimc(const std::vector<FieldT> &round_constants, const FieldT &x, const FieldT &k)
 {
-    ProtoboardT pb;
-
-    const VariableT var_x = make_variable(pb, x, "x");
-    const VariableT var_k = make_variable(pb, k, "k");
-    pb.set_input_sizes(2);
+    FieldT result = x;
 
-    MiMC_gadget the_gadget(pb, var_x, var_k, round_constants, "the_gadget");
-    the_gadget.generate_r1cs_witness();
-    the_gadget.generate_r1cs_constraints();
+    for (const auto &C_i : round_constants)
+    {
+        const FieldT t = result + k + C_i;
+        const FieldT a = t.squared(); // t^2
+        const FieldT b = a.squared(); // t^4
+        result = a * b * t;           // t^7
+    }
 
-    return pb.val(the_gadget.result());
+    return result + k;
 }
 
 const FieldT mimc(const FieldT &x, const FieldT &k)
@@ -290,39 +302,29 @@ const FieldT mimc(const FieldT &x, const FieldT &k)
     return mimc(MiMC_gadget::static_constants(), x, k);
 }
 
-const FieldT mimc_hash(const std::vector<FieldT> &m, const FieldT &k)
+/**
+* Native Miyaguchi-Preneel one-way function using MiMC as the cipher,
+* identical to `MiMC_hash_gadget` and `MiMC.MiMCpe7_mp`:
+*
+*   H_i = E(H_{i-1}, m_i) + H_{i-1} + m_i
+*
+* Where H_0 is the key (or IV)
+*/
+const FieldT mimc_hash(const std::vector<FieldT> &round_constants, const std::vector<FieldT> &m, const FieldT &k)
 {
-    ProtoboardT pb;
+    FieldT result = k;
 
-    std::vector<VariableT> var_m;
-    var_m.reserve(m.size());
     for (const auto &m_i : m)
     {
-        var_m.emplace_back(make_variable(pb, m_i, "k"));
+        result = result + m_i + mimc(round_constants, m_i, result);
     }
 
-    const auto var_k = make_variable(pb, k, "k");
-    pb.set_input_sizes(m.size() + 1);
-
-    MiMC_hash_gadget the_gadget(pb, var_k, var_m, "the_gadget");
-    the_gadget.generate_r1cs_witness();
-    the_gadget.generate_r1cs_constraints();
-
-    // Debug internal state of one-way-function
-    /*
-    int i = 0;
-    for( const auto& c : the_gadget.m_ciphers )
-    {
-        std::cout << "k "; pb.val(c.k).print();
-        std::cout << "x_i "; pb.val(c.m_rounds[0].x).print();
-        std::cout << "r "; pb.val(c.m_rounds.back().result()).print();
-        std::cout << "= "; pb.val(the_gadget.m_outputs[i]).print();
-        std::cout << std::endl;
-        i += 1;
-    }
-    */
+    return result;
+}
 
-    return pb.val(the_gadget.result());
+const FieldT mimc_hash(const std::vector<FieldT> &m, const FieldT &k)
+{
+    return mimc_hash(MiMC_gadget::static_constants(), m, k);
 }
 
 const FieldT mimc_hash(const std::vector<FieldT> &m)
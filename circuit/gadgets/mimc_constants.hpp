@@ -0,0 +1,132 @@
+#ifndef MIXER_MIMC_CONSTANTS_HPP_
+#define MIXER_MIMC_CONSTANTS_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+namespace ethsnarks
+{
+
+static_assert(sizeof(FieldT) == 4 * sizeof(uint64_t), "Constant tables assume a 4x64-bit limb scalar field");
+
+/**
+* Field elements from their Montgomery form limbs, least significant first,
+* which needs neither GMP nor libff's number system to be initialised
+*/
+template <size_t N>
+inline std::vector<FieldT> field_table(const uint64_t (&in_limbs)[N][4])
+{
+    std::vector<FieldT> elements(N);
+    for (size_t i = 0; i < N; i++)
+    {
+        memcpy(elements[i].mont_repr.data, in_limbs[i], sizeof(in_limbs[i]));
+    }
+    return elements;
+}
+
+/**
+* The default MiMC round constants, `MiMCe7_gadget::constants(MIMC_SEED, MIMC_ROUNDS)`:
+* keccak256("mimc") hashed again for each round, in Montgomery form.
+*
+* `mixer_cli test-mimc` checks them against `constants_fill`.
+*/
+static const uint64_t MIMC_CONSTANTS_MONTGOMERY[][4] = {
+    {0x95fafe165a107a9e, 0x29ef8c47a2eb3be3, 0x26dde66394f647da, 0x1799d93eb9d28486},
+    {0x27ebae303c99bddc, 0xe119af85d7427660, 0xbaa333f0044d87f8, 0x0898e040b547aa62},
+    {0x041776b4a1e2bbe6, 0x6a515a8c9faeb3cd, 0x74920a7f4e8ce6d8, 0x0497b9ca90322392},
+    {0x27246fd789e3b1e7, 0x5e7edaac7c2121d2, 0x7cf97bde97e62d05, 0x1f384c5c9ab758ce},
+    {0x120feb9478580452, 0xf9800e6a71b8a64f, 0x5c5ed5e1121dfa1d, 0x098640f821d635d3},
+    {0x4b69d0d51056e706, 0x7350619bc5b97582, 0x166729ba0fc09da9, 0x1182c21d26c3bbda},
+    {0x8cd8180f4e6abc48, 0xaef1289cdb5a5669, 0xd9b3621858ee487c, 0x2d5b816c1f7e2662},
+    {0x9b875e3faff5ad6d, 0x08c70f11ea1a33b2, 0x866670ed10bacbc6, 0x1401b926b8d7e064},
+    {0x8de3758d935c2e73, 0x2a7a2227043f82e1, 0xc812f968a3bc677d, 0x25fbbc4b6c6b7493},
+    {0x6ae7e5285b40e6cb, 0xca3becb44fc394be, 0xc4be06427f99fc41, 0x1f04c6b3654f070a},
+    {0xcc348f031a3993ec, 0x57ed640eb9ada5f9, 0x8dc1616c9604fa83, 0x042a8aab9589f734},
+    {0x535211950998db03, 0xb6bf6cd8560f644a, 0xb73798d44dc55470, 0x28eabd13a7d96d73},
+    {0x2cab9050080a6e15, 0x265743c7e6e26faf, 0xd3481ac3b2a93f77, 0x02dd98473682c24c},
+    {0x7069ff0834d76ce2, 0xf644f93157d7164c, 0x98a2035bf824c70b, 0x22c5451e70422dab},
+    {0x848e28734a4e36a1, 0xcec7cc5fe8e9b767, 0x1ffe37f53214ff8e, 0x2ab9711406a66772},
+    {0x62b90566855702ba, 0xbb028279ad258a29, 0xe593b51858411f5f, 0x27cca53a553bef87},
+    {0xfc08a07324a09999, 0xf0de493db92e181b, 0x5e0b6704a9a8de2a, 0x2684cc7798b18d83},
+    {0xb247af799f1169a9, 0xbe1a1c7d8111c9ca, 0x255ed57008cd8860, 0x2935307f373490c9},
+    {0x5a2aceb5de72147d, 0x1b4612b395ce2b1b, 0x6f1db8f37d414d70, 0x026fe389bcf40bdd},
+    {0x1cb7852357fb5b24, 0x68710614a05b3514, 0x7d2cd47d21b497b5, 0x0cd72935d321dc8b},
+    {0x7da123dae2452e2f, 0x2a6d5dd37a9d7e10, 0xc8d13dd9701b46c6, 0x20a7703eb4805dfb},
+    {0x607df78382adf697, 0x35b03c7cdea2fdc6, 0xf4550fff773d8aa5, 0x218eb33983dd0949},
+    {0xca9d7efed89840a3, 0x556a72778eec9929, 0x3b40c167bc28820c, 0x0d34cab9ed909266},
+    {0xa30f7e996f8b6680, 0xd0d06b98d694ff7d, 0x5013ab11347c477d, 0x137e786bcd86f11b},
+    {0xf0ea94d58585e6e6, 0x9918b68c8c9335b5, 0xb5c172603a4e637b, 0x2754c7a06bd9bf66},
+    {0x109bbe4a87a92576, 0x19d0ebad99ad5310, 0x2dadf66b40237dc5, 0x16c9d5e9dc416d4b},
+    {0x9d0a9e241f5e5327, 0x26772efeb027e7b7, 0x09f7863320304453, 0x1340308881ce8c0d},
+    {0x4a3fdda139509169, 0x991416cd26dc2fea, 0xa4a4f5d6c64a180e, 0x1458a55da3a3541d},
+    {0xb9faab5a257f5332, 0x78c49c781d0bb10a, 0xb2bc234d7d70aa99, 0x1bdea8856759d01e},
+    {0x94a400d564f68845, 0xeb3d50891c691591, 0xa3b3feab376f0a43, 0x06652f203d73198e},
+    {0x89c87264567fb483, 0x4b2f60c311251486, 0x03cba0cca07705e1, 0x3026e28eef2814c7},
+    {0xe0dfb20184a25aa5, 0xf385eecbf64ca745, 0xcf9037e52e9e5484, 0x1c180bc09db61af9},
+    {0xb7c65f3d422a5c41, 0xd8e7577cb5e84dbd, 0x0be8208b03168040, 0x172c7342170eb31a},
+    {0xbd9eea27581e1c19, 0x6b64613caf2ae178, 0xdac1ad7e7c334906, 0x082dcf416745a746},
+    {0x2c29b54367d2f858, 0x22b91e766882fb6e, 0x78a0e632da22f63e, 0x2c79e393526a045c},
+    {0xfe479c589c633887, 0x15cd91b885092a4f, 0xbc3d5db352d8e977, 0x17e06402d1feded3},
+    {0x6649b3d0b11e4ad3, 0x66ba9af3ae954e5f, 0x69f82fa668d4dd3b, 0x20bc999e284a6666},
+    {0x4495687da89c186f, 0x4f51d5a8a87e6856, 0xaf3ef15ed04479fb, 0x017d8dfc2eb2be87},
+    {0x0ecf798072af49c9, 0x9c9a190301f2307d, 0xafcf5eb65c37a483, 0x0d88f3c4554fb1a3},
+    {0x304492a7e795b500, 0x5dbc37194a49e60d, 0xa38971f04eeb0801, 0x292f38249aec35b5},
+    {0xb1036bf4a13521da, 0x7560d8b053a3ca0a, 0xd876a69602a92f96, 0x06f119ad4f0ed501},
+    {0x7708b7e69e54d3f4, 0x2267aba26bf9ba17, 0x0f1bd7b459a0904e, 0x26103dd88a2e57e7},
+    {0x8970c4e8ab8bc959, 0x20b109738346635f, 0x374b115d20134b2c, 0x25d95187bca6ee58},
+    {0x2fa7ad8ba4ade834, 0x031c1f91d189e9cb, 0xafc8084e19ecd05a, 0x211778b94bb483d7},
+    {0x190da57334532e6b, 0x2a60a17f2ca4202d, 0x7d0547fa294c9fb4, 0x1c544da64ceaae73},
+    {0xfd37d49d19dc2f5c, 0x2c16d0a9bfabbdbf, 0x38e71c408adc8dbf, 0x1e056f7a8b5a51cc},
+    {0x1c509ddda6f9a65f, 0xf15e09d4fcf07c29, 0x526c8977257619c6, 0x16f70ce286adcb34},
+    {0x6d2346011f94cff8, 0x88c3eadbc2c463a0, 0xce61783e2db4a6a0, 0x2d5dc12a792f1e74},
+    {0x41242a7d96f9abe1, 0x2624c926cbdc87c0, 0x7b5fc93ee100799b, 0x22a276a6f19e533c},
+    {0xe6e674ce2fef41e5, 0xfa9a6a9eac55d851, 0x5d4f98c32499df55, 0x1307be65554b2dc8},
+    {0x1a17412540ba0140, 0x407f03085b55a03f, 0xe4075dadb45354f7, 0x0a9a9b6027ca74b0},
+    {0xa56d113b823a50be, 0xf5163cac12f6afca, 0xfdb0fe1d7930a4ef, 0x2621b716894da6b4},
+    {0x90949c1fafef9c03, 0x22fc7ae4999f3f44, 0x13b3e11c2bac749f, 0x290c65af7fd1a04f},
+    {0xffc6e1a7f6bd79c8, 0x29300a58dab289b6, 0xed01191024a5d16a, 0x0e63b7d7d1e5a2ba},
+    {0xcedfdfdf99b06aa7, 0xf50be1a3eee8915a, 0x973d5a5dd1317888, 0x2cd3c7456173bb1b},
+    {0x5238a266370bb8c8, 0xcc4f3f3c6f67d6b7, 0xa75b377f05647f6e, 0x25503cd0bd5f3cf6},
+    {0x29eca4c61f2252e8, 0xa43f2dc79d694860, 0xed89e72f86cb6a77, 0x28a59c74da67f199},
+    {0x63e9e27d2c4c2d25, 0x5a5b8023755748e0, 0x8078b086349c6d1a, 0x134e256da122612a},
+    {0xcfd026adabe4cc83, 0x0ad2f0834b3b20af, 0xf7495fc3cf22a9f6, 0x1ed44e5e939a9a22},
+    {0xa70000b09a6d8f6a, 0x16b7812dfb736502, 0xb0f1086bcccafd30, 0x05ae000afd27edb7},
+    {0x51398cdd6c358435, 0x9c3ff1857395d319, 0x2688ec375b99dc8c, 0x113fb39a0d2c38fa},
+    {0x5131e3feb5d70edf, 0x192d1e532bdeda69, 0x9e86558780fdedba, 0x15898ad8aafef978},
+    {0x326e94067d5716fe, 0xc9da1034d371f1ed, 0x512fd8c22bad188a, 0x20c41bccc3e935d9},
+    {0xb59c9a8cff0b066a, 0xf6bcc27318165311, 0xb5151d4d830c521d, 0x1d90d1aa292874c6},
+    {0xac3b277342453f96, 0xabcb699492f2bc3d, 0xb80d4a84894401b3, 0x067d4d50e7107b37},
+    {0x5f84b3655ad5c495, 0x5eac570a9b9ad06c, 0x2565f7d669bcb602, 0x15340c1119581ab8},
+    {0x18ca331463d97e51, 0x0d698f353cd47d5c, 0xfca7b4b702b31b40, 0x0b03e01318fb277a},
+    {0xae2709c31f7b96d9, 0x43c3a124f14916e9, 0x74fd4339ac85c1ca, 0x11733fbb1a644719},
+    {0xec7352b2361cbd0c, 0x2772ac0aac13808e, 0x8f240611d2363071, 0x0db7ea15f8b9c8bb},
+    {0x08899a60fbcba55f, 0x279895e299c2323e, 0xb1de1a009821ef1f, 0x035e45eafd37f5e3},
+    {0xf222d549a6e441f0, 0xe37be9ab4101850e, 0x2834597489995ff9, 0x0df76295d8eae4d4},
+    {0xe79315bef11c60da, 0x4a5d74349cd91eb0, 0x1cba2f1e41bfe6b5, 0x20c8645f40a26658},
+    {0x7bbb5f9aa3854524, 0xcdfc46756aa38bbd, 0xd465150cff7bc57d, 0x27d50906d806ce39},
+    {0x775e29ff2e0cefd1, 0xf903252e4f03e221, 0xa4736b91598aefc8, 0x1fb51e7b5f05518d},
+    {0xe1ff6fd583bbdb7b, 0x984812f0a1a846ba, 0x75b52c0ee489619c, 0x14607a56dec5d322},
+    {0xedd269938d3b2374, 0xe2dce83515b56398, 0xaa0f8bfc8cc52aed, 0x163ff0efbdc1a419},
+    {0x4f62026f35947112, 0xa62d352f6bd806b4, 0x3ca57da2884d3a5c, 0x070ee56aef4bca49},
+    {0x60d65548166514a4, 0x49947a2f33815329, 0x4b7e565957e69f0f, 0x0e56cfe8d0eb9e33},
+    {0x1c1a826cf783d933, 0x1f3d9928d1c094c2, 0x761140e567be7da2, 0x23870e6600c8e588},
+    {0x447b85f6e817a17b, 0xe8e98534cf393eb9, 0x15f3c6b09f1d5e4b, 0x2b21f45a70aeae9e},
+    {0xdbfd956489e96fd7, 0xbf44a3fea83a8e46, 0x3240623f0930ac33, 0x215656eae2f01202},
+    {0x510c73536df21af0, 0x15a8eed95bbd856b, 0x2d82c2bf02d04e97, 0x04a04c2d37b7e536},
+    {0xb1e11939c72839dc, 0x540bf888208ce017, 0x885df5bf5a83788b, 0x2d92f09b299458b5},
+    {0xc073bcf8415c9b47, 0xb0d1fbcafc3602c5, 0x66c1d6383cdd34c7, 0x07d8ee809bcb95d7},
+    {0x0692b858ed0aaa1d, 0x62399fb47d26253e, 0x62999cb0c3ddc36d, 0x069854d32af2a138},
+    {0xb5a4cc0500637724, 0xbb35466061e26671, 0x809b5eca0cfba145, 0x09d56c059bdc3b72},
+    {0xbfd8ec02fdf8c114, 0x0de34a9120ff6807, 0x699e7dbdfaa1d86f, 0x09e2710fcb6ecf68},
+    {0xadb8778382a9bf88, 0x3c3b081e9b437c5a, 0x2126f0d6f5732668, 0x2e5e964691be2fc4},
+    {0xe177daefc7719363, 0x09273005c4fabc15, 0xd966ed5aded5d264, 0x1fc56830f50084e7},
+    {0x5e41ab9dff3e21ff, 0xce774bcf69ec1cbc, 0x090a5cafb93d330e, 0x26968f396dc45410},
+    {0xfb96573982592621, 0xcc001692799567e0, 0x92714c2481ac5ffc, 0x1ff8965bd6e03a29}
+};
+
+} // namespace ethsnarks
+
+#endif // MIXER_MIMC_CONSTANTS_HPP_
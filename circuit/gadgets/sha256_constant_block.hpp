@@ -0,0 +1,184 @@
+#ifndef SHA256_CONSTANT_BLOCK_HPP_
+#define SHA256_CONSTANT_BLOCK_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "ethsnarks.hpp"
+#include "utils.hpp"
+#include "gadgets/sha256_witness.hpp"
+#include "native/sha256.hpp"
+
+#include <libsnark/gadgetlib1/gadgets/hashes/sha256/sha256_components.hpp>
+
+namespace ethsnarks
+{
+
+/**
+* SHA256's compression function for a message block which is a constant,
+* such as the padding block after a 512 bit message.
+*
+* It's libsnark's `sha256_compression_function_gadget` with the message
+* schedule computed natively instead of in the circuit: the schedule's
+* words, bit decompositions and sigma functions, and the constraints tying
+* the block's bits to their constants, all go away. Each round adds its
+* word W[i] to its constant K[i], so the round function is given the
+* constant K[i] + W[i] - 1 with the ONE variable as its word, and computes
+* the same sums.
+*/
+class sha256_constant_block_gadget : public GadgetT
+{
+public:
+    typedef libsnark::pb_linear_combination_array<FieldT> WordT;
+
+    const WordT prev_output;
+    const libsnark::digest_variable<FieldT> output;
+
+    std::vector<WordT> round_a;
+    std::vector<WordT> round_b;
+    std::vector<WordT> round_c;
+    std::vector<WordT> round_d;
+    std::vector<WordT> round_e;
+    std::vector<WordT> round_f;
+    std::vector<WordT> round_g;
+    std::vector<WordT> round_h;
+    std::vector<libsnark::sha256_round_function_gadget<FieldT>> round_functions;
+
+    VariableArrayT unreduced_output;
+    VariableArrayT reduced_output;
+    std::vector<libsnark::lastbits_gadget<FieldT>> reduce_output;
+
+    sha256_constant_block_gadget(
+        ProtoboardT &in_pb,
+        const WordT &in_prev_output,
+        const uint8_t in_block[64],
+        const libsnark::digest_variable<FieldT> &in_output,
+        const std::string &annotation_prefix) : GadgetT(in_pb, annotation_prefix),
+                                                prev_output(in_prev_output),
+                                                output(in_output)
+    {
+        uint32_t W[64];
+        native::sha256_message_schedule(W, in_block);
+
+        // The previous output's bits are big-endian, words a to h
+        round_a.push_back(WordT(prev_output.rbegin() + 7 * 32, prev_output.rbegin() + 8 * 32));
+        round_b.push_back(WordT(prev_output.rbegin() + 6 * 32, prev_output.rbegin() + 7 * 32));
+        round_c.push_back(WordT(prev_output.rbegin() + 5 * 32, prev_output.rbegin() + 6 * 32));
+        round_d.push_back(WordT(prev_output.rbegin() + 4 * 32, prev_output.rbegin() + 5 * 32));
+        round_e.push_back(WordT(prev_output.rbegin() + 3 * 32, prev_output.rbegin() + 4 * 32));
+        round_f.push_back(WordT(prev_output.rbegin() + 2 * 32, prev_output.rbegin() + 3 * 32));
+        round_g.push_back(WordT(prev_output.rbegin() + 1 * 32, prev_output.rbegin() + 2 * 32));
+        round_h.push_back(WordT(prev_output.rbegin() + 0 * 32, prev_output.rbegin() + 1 * 32));
+
+        for (size_t i = 0; i < 64; i++)
+        {
+            round_h.push_back(round_g[i]);
+            round_g.push_back(round_f[i]);
+            round_f.push_back(round_e[i]);
+            round_d.push_back(round_c[i]);
+            round_c.push_back(round_b[i]);
+            round_b.push_back(round_a[i]);
+
+            round_a.emplace_back(make_var_array(in_pb, 32, FMT(annotation_prefix, ".new_round_a_%zu", i + 1)));
+            round_e.emplace_back(make_var_array(in_pb, 32, FMT(annotation_prefix, ".new_round_e_%zu", i + 1)));
+
+            const long K = long(native::SHA256_K[i]) + long(W[i]) - 1;
+            round_functions.emplace_back(in_pb,
+                                         round_a[i], round_b[i], round_c[i], round_d[i],
+                                         round_e[i], round_f[i], round_g[i], round_h[i],
+                                         libsnark::ONE, K, round_a[i + 1], round_e[i + 1],
+                                         FMT(annotation_prefix, ".round_functions_%zu", i));
+        }
+
+        unreduced_output = make_var_array(in_pb, 8, FMT(annotation_prefix, ".unreduced_output"));
+        reduced_output = make_var_array(in_pb, 8, FMT(annotation_prefix, ".reduced_output"));
+        for (size_t i = 0; i < 8; i++)
+        {
+            reduce_output.emplace_back(in_pb,
+                                       unreduced_output[i],
+                                       32 + 1,
+                                       reduced_output[i],
+                                       libsnark::pb_variable_array<FieldT>(output.bits.rbegin() + (7 - i) * 32, output.bits.rbegin() + (8 - i) * 32),
+                                       FMT(annotation_prefix, ".reduce_output_%zu", i));
+        }
+    }
+
+    void generate_r1cs_constraints()
+    {
+        for (auto &round_function : round_functions)
+        {
+            round_function.generate_r1cs_constraints();
+        }
+
+        // The previous output's words plus the last rounds' a and e
+        for (size_t i = 0; i < 4; i++)
+        {
+            this->pb.add_r1cs_constraint(
+                ConstraintT(1, round_functions[3 - i].packed_d + round_functions[63 - i].packed_new_a, unreduced_output[i]),
+                FMT(annotation_prefix, ".unreduced_output_%zu", i));
+            this->pb.add_r1cs_constraint(
+                ConstraintT(1, round_functions[3 - i].packed_h + round_functions[63 - i].packed_new_e, unreduced_output[4 + i]),
+                FMT(annotation_prefix, ".unreduced_output_%zu", 4 + i));
+        }
+
+        for (auto &reduce : reduce_output)
+        {
+            reduce.generate_r1cs_constraints();
+        }
+    }
+
+    void generate_r1cs_witness()
+    {
+        for (auto &round_function : round_functions)
+        {
+            round_function.generate_r1cs_witness();
+        }
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            this->pb.val(unreduced_output[i]) = this->pb.lc_val(round_functions[3 - i].packed_d) + this->pb.val(round_functions[63 - i].packed_new_a);
+            this->pb.val(unreduced_output[4 + i]) = this->pb.lc_val(round_functions[3 - i].packed_h) + this->pb.val(round_functions[63 - i].packed_new_e);
+        }
+
+        for (auto &reduce : reduce_output)
+        {
+            reduce.generate_r1cs_witness();
+        }
+    }
+
+    bool native_witness_supported() const
+    {
+        for (const auto &round_function : round_functions)
+        {
+            if (!sha256_round_layout_matches(round_function))
+            {
+                return false;
+            }
+        }
+        for (const auto &reduce : reduce_output)
+        {
+            if (!sha256_lastbits_layout_matches(reduce))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+    * The same witness from `trace`, the native compression of this block
+    * on the previous output's words (see `sha256_witness.hpp`)
+    */
+    void generate_r1cs_witness(const native::Sha256Trace &trace)
+    {
+        for (size_t i = 0; i < 64; i++)
+        {
+            sha256_round_witness(this->pb, round_functions[i], trace, i, uint64_t(native::SHA256_K[i]) + trace.W[i]);
+        }
+        sha256_output_witness(this->pb, reduce_output, trace);
+    }
+};
+
+} // namespace ethsnarks
+
+#endif // SHA256_CONSTANT_BLOCK_HPP_
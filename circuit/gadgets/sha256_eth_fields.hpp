@@ -2,12 +2,27 @@
 #define SHA256_ETH_FIELDS_HPP_
 
 #include "ethsnarks.hpp"
-#include "gadgets/sha256_full.hpp"
+#include "gadgets/sha256_constant_block.hpp"
+#include "gadgets/sha256_witness.hpp"
+#include "native/sha256.hpp"
 #include "utils.hpp"
 
+#include <libsnark/gadgetlib1/gadgets/hashes/sha256/sha256_gadget.hpp>
+
 namespace ethsnarks
 {
 
+/**
+* SHA256 of two field elements as 256 bit big-endian integers, with the
+* top 4 bits of the digest cleared, as `Mixer.makeLeafHash`.
+*
+* The message is exactly one block, so the second compression function
+* only processes the constant padding block (see `sha256_constant_block_gadget`).
+*
+* The witness is computed with native SHA256, writing every intermediate
+* bit straight into the protoboard (see `sha256_witness.hpp`), unless the
+* gadgets' variables aren't laid out the way that expects.
+*/
 class Sha256EthFields : public GadgetT
 {
 public:
@@ -24,13 +39,17 @@ public:
 
     const std::vector<VariableArrayT> input_block_slice;
     libsnark::block_variable<FieldT> input_block;
+    libsnark::digest_variable<FieldT> intermediate_digest;
+    libsnark::sha256_compression_function_gadget<FieldT> input_hasher;
     libsnark::digest_variable<FieldT> output_digest;
-    sha256_full_gadget_512 hasher;
+    sha256_constant_block_gadget padding_hasher;
 
     const VariableT output;
     libsnark::pb_variable_array<FieldT> output_bits_slice;
     libsnark::packing_gadget<FieldT> output_packer;
 
+    const bool native_witness;
+
     Sha256EthFields(
         ProtoboardT &in_pb,
         const VariableT &in_left,
@@ -52,13 +71,17 @@ public:
                                                    //input_block_slice({VariableArrayT(left_bits.bits.rbegin(), left_bits.bits.rend()), VariableArrayT(right_bits.bits.rbegin(), right_bits.bits.rend())}),
                                                    input_block_slice({left_bits_reversed, right_bits_reversed}),
                                                    input_block(in_pb, input_block_slice, FMT(in_annotation_prefix, ".input_block")),
+                                                   intermediate_digest(in_pb, libsnark::SHA256_digest_size, FMT(in_annotation_prefix, ".intermediate_digest")),
+                                                   input_hasher(in_pb, libsnark::SHA256_default_IV<FieldT>(in_pb), input_block.bits, intermediate_digest, FMT(in_annotation_prefix, ".input_hasher")),
                                                    output_digest(in_pb, libsnark::SHA256_digest_size, FMT(in_annotation_prefix, ".output_digest")),
-                                                   hasher(in_pb, input_block, output_digest, FMT(in_annotation_prefix, ".hasher")),
+                                                   padding_hasher(in_pb, intermediate_digest.bits, native::SHA256_PADDING_512, output_digest, FMT(in_annotation_prefix, ".padding_hasher")),
 
                                                    // Again, python uses big-endian bitwise representation, so reverse the output bits
                                                    output(make_variable(in_pb, FMT(annotation_prefix, ".output"))),
                                                    output_bits_slice(output_digest.bits.rbegin(), output_digest.bits.rend() - 4),
-                                                   output_packer(in_pb, output_bits_slice, output, FMT(in_annotation_prefix, ".output_packer"))
+                                                   output_packer(in_pb, output_bits_slice, output, FMT(in_annotation_prefix, ".output_packer")),
+
+                                                   native_witness(sha256_compression_layout_matches(input_hasher) && padding_hasher.native_witness_supported())
     {
         assert(right_bits_reversed.size() == libsnark::SHA256_digest_size);
     }
@@ -76,17 +99,48 @@ public:
         right_bits.generate_r1cs_constraints();
         right_packer.generate_r1cs_constraints(true);
 
-        hasher.generate_r1cs_constraints();
+        input_hasher.generate_r1cs_constraints();
+        padding_hasher.generate_r1cs_constraints();
 
         output_digest.generate_r1cs_constraints();
         output_packer.generate_r1cs_constraints(false); // Result comes from SHA256 function, no bitness checks required
     }
 
-    void generate_r1cs_witness()
+    void generate_r1cs_witness(native::Sha256Kernel kernel = native::SHA256_KERNEL_AUTO)
+    {
+        if (!native_witness)
+        {
+            generate_r1cs_witness_gadgets();
+            return;
+        }
+
+        left_packer.generate_r1cs_witness_from_packed();
+        right_packer.generate_r1cs_witness_from_packed();
+
+        uint8_t block[64];
+        sha256_witness_store_field(block, this->pb.val(left));
+        sha256_witness_store_field(block + 32, this->pb.val(right));
+
+        native::Sha256Trace input_trace;
+        native::sha256_compress_trace(native::SHA256_IV, block, input_trace, kernel);
+        sha256_compression_witness(this->pb, input_hasher, input_trace);
+
+        native::Sha256Trace padding_trace;
+        native::sha256_compress_trace(input_trace.H, native::SHA256_PADDING_512, padding_trace, kernel);
+        padding_hasher.generate_r1cs_witness(padding_trace);
+
+        output_packer.generate_r1cs_witness_from_bits();
+    }
+
+    /**
+    * The witness from libsnark's gadgets, evaluating every bit as a field element
+    */
+    void generate_r1cs_witness_gadgets()
     {
         left_packer.generate_r1cs_witness_from_packed();
         right_packer.generate_r1cs_witness_from_packed();
-        hasher.generate_r1cs_witness();
+        input_hasher.generate_r1cs_witness();
+        padding_hasher.generate_r1cs_witness();
         output_packer.generate_r1cs_witness_from_bits();
     }
 };
@@ -0,0 +1,243 @@
+#ifndef SHA256_WITNESS_HPP_
+#define SHA256_WITNESS_HPP_
+
+#include <cstdint>
+
+#include "ethsnarks.hpp"
+#include "native/sha256.hpp"
+
+#include <libsnark/gadgetlib1/gadgets/hashes/sha256/sha256_gadget.hpp>
+
+namespace ethsnarks
+{
+
+/*
+* Witness generation for libsnark's SHA256 gadgets from a native trace
+* (see `native::Sha256Trace`), instead of evaluating every bit of every
+* sub-gadget as field elements.
+*
+* The sigma, choice and majority gadgets keep their bits and XOR
+* temporaries private, so those are written by position: each one
+* allocates its 32 result bits followed by a temporary per XOR which has
+* a third input. The `*_layout_matches` functions check the positions of
+* the public variables around them, if they don't match the gadgets'
+* own `generate_r1cs_witness` must be used instead.
+*/
+
+static const size_t SHA256_WORD_BITS = 32;
+
+static const size_t SHA256_BIG_SIGMA_VARIABLES = 2 * SHA256_WORD_BITS;
+
+// Shifting by 3 and 10 leaves that many XORs of only two bits
+static const size_t SHA256_SMALL_SIGMA0_VARIABLES = (2 * SHA256_WORD_BITS) - 3;
+static const size_t SHA256_SMALL_SIGMA1_VARIABLES = (2 * SHA256_WORD_BITS) - 10;
+
+/**
+* The 32 byte big-endian representation of `value`, as the leaf hash's message
+*/
+inline void sha256_witness_store_field(uint8_t out[32], const FieldT &value)
+{
+    const auto bigint = value.as_bigint();
+    for (size_t i = 0; i < 4; i++)
+    {
+        const uint64_t limb = bigint.data[3 - i];
+        for (size_t j = 0; j < 8; j++)
+        {
+            out[(8 * i) + j] = uint8_t(limb >> (56 - (8 * j)));
+        }
+    }
+}
+
+inline void sha256_witness_bits(ProtoboardT &pb, size_t first_index, uint64_t value, size_t n_bits)
+{
+    for (size_t i = 0; i < n_bits; i++)
+    {
+        pb.val(VariableT(first_index + i)) = ((value >> i) & 1) ? FieldT::one() : FieldT::zero();
+    }
+}
+
+inline void sha256_witness_bits(ProtoboardT &pb, const libsnark::pb_linear_combination_array<FieldT> &bits, uint64_t value)
+{
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        assert(bits[i].is_variable);
+        pb.val(VariableT(bits[i].index)) = ((value >> i) & 1) ? FieldT::one() : FieldT::zero();
+    }
+}
+
+inline void sha256_witness_bits(ProtoboardT &pb, const VariableArrayT &bits, uint64_t value)
+{
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        pb.val(bits[i]) = ((value >> i) & 1) ? FieldT::one() : FieldT::zero();
+    }
+}
+
+inline bool sha256_lastbits_layout_matches(const libsnark::lastbits_gadget<FieldT> &gadget)
+{
+    for (const auto &bit : gadget.full_bits)
+    {
+        if (!bit.is_variable)
+        {
+            return false;
+        }
+    }
+    return gadget.full_bits.size() == gadget.X_bits;
+}
+
+/**
+* X, its bits and the result from its low bits
+*/
+inline void sha256_lastbits_witness(ProtoboardT &pb, const libsnark::lastbits_gadget<FieldT> &gadget, uint64_t value)
+{
+    pb.val(gadget.X) = FieldT(long(value));
+    sha256_witness_bits(pb, gadget.full_bits, value);
+    pb.val(gadget.result) = FieldT(long(value & 0xFFFFFFFF));
+}
+
+inline bool sha256_round_layout_matches(const libsnark::sha256_round_function_gadget<FieldT> &gadget)
+{
+    const size_t first = gadget.sigma0.index;
+    return gadget.sigma1.index == first + 1 &&
+           gadget.choice.index == first + 2 + (2 * SHA256_BIG_SIGMA_VARIABLES) &&
+           gadget.majority.index == gadget.choice.index + 1 + SHA256_WORD_BITS &&
+           gadget.unreduced_new_a.index == gadget.majority.index + 1 + SHA256_WORD_BITS &&
+           sha256_lastbits_layout_matches(*gadget.mod_reduce_new_a) &&
+           sha256_lastbits_layout_matches(*gadget.mod_reduce_new_e);
+}
+
+/**
+* Round `i` of `trace`, `K_plus_W` is the sum of the gadget's K and the value of its W
+*/
+inline void sha256_round_witness(ProtoboardT &pb, const libsnark::sha256_round_function_gadget<FieldT> &gadget, const native::Sha256Trace &trace, size_t i, uint64_t K_plus_W)
+{
+    using native::sha256_rotr;
+
+    const uint32_t a = trace.A[i + 3], b = trace.A[i + 2], c = trace.A[i + 1], d = trace.A[i];
+    const uint32_t e = trace.E[i + 3], f = trace.E[i + 2], g = trace.E[i + 1], h = trace.E[i];
+
+    const uint32_t S0_tmp = sha256_rotr(a, 2) ^ sha256_rotr(a, 13);
+    const uint32_t S0 = S0_tmp ^ sha256_rotr(a, 22);
+    const uint32_t S1_tmp = sha256_rotr(e, 6) ^ sha256_rotr(e, 11);
+    const uint32_t S1 = S1_tmp ^ sha256_rotr(e, 25);
+    const uint32_t ch = (e & f) ^ (~e & g);
+    const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+
+    // sigma0, sigma1, then each sigma's result bits and XOR temporaries
+    const size_t first = gadget.sigma0.index;
+    pb.val(gadget.sigma0) = FieldT(long(S0));
+    pb.val(gadget.sigma1) = FieldT(long(S1));
+    sha256_witness_bits(pb, first + 2, S0, SHA256_WORD_BITS);
+    sha256_witness_bits(pb, first + 2 + SHA256_WORD_BITS, S0_tmp, SHA256_WORD_BITS);
+    sha256_witness_bits(pb, first + 2 + SHA256_BIG_SIGMA_VARIABLES, S1, SHA256_WORD_BITS);
+    sha256_witness_bits(pb, first + 2 + SHA256_BIG_SIGMA_VARIABLES + SHA256_WORD_BITS, S1_tmp, SHA256_WORD_BITS);
+
+    pb.val(gadget.choice) = FieldT(long(ch));
+    sha256_witness_bits(pb, gadget.choice.index + 1, ch, SHA256_WORD_BITS);
+    pb.val(gadget.majority) = FieldT(long(maj));
+    sha256_witness_bits(pb, gadget.majority.index + 1, maj, SHA256_WORD_BITS);
+
+    const uint64_t temp1 = uint64_t(h) + S1 + ch + K_plus_W;
+    sha256_lastbits_witness(pb, *gadget.mod_reduce_new_a, temp1 + S0 + maj);
+    sha256_lastbits_witness(pb, *gadget.mod_reduce_new_e, temp1 + d);
+}
+
+inline bool sha256_message_schedule_layout_matches(const libsnark::sha256_message_schedule_gadget<FieldT> &gadget)
+{
+    for (size_t i = 16; i < 64; i++)
+    {
+        const size_t first = gadget.sigma0[i].index;
+        if (gadget.sigma1[i].index != first + 1 ||
+            gadget.unreduced_W[i].index != first + 2 + SHA256_SMALL_SIGMA0_VARIABLES + SHA256_SMALL_SIGMA1_VARIABLES ||
+            !sha256_lastbits_layout_matches(*gadget.mod_reduce_W[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* The words of the schedule, its first 16 words' bits are the message block which is already assigned
+*/
+inline void sha256_message_schedule_witness(ProtoboardT &pb, const libsnark::sha256_message_schedule_gadget<FieldT> &gadget, const native::Sha256Trace &trace)
+{
+    using native::sha256_rotr;
+
+    const uint32_t *W = trace.W;
+    for (size_t i = 0; i < 16; i++)
+    {
+        pb.val(gadget.packed_W[i]) = FieldT(long(W[i]));
+    }
+
+    for (size_t i = 16; i < 64; i++)
+    {
+        const uint32_t s0_tmp = sha256_rotr(W[i - 15], 7) ^ sha256_rotr(W[i - 15], 18);
+        const uint32_t s0 = s0_tmp ^ (W[i - 15] >> 3);
+        const uint32_t s1_tmp = sha256_rotr(W[i - 2], 17) ^ sha256_rotr(W[i - 2], 19);
+        const uint32_t s1 = s1_tmp ^ (W[i - 2] >> 10);
+
+        const size_t first = gadget.sigma0[i].index;
+        pb.val(gadget.sigma0[i]) = FieldT(long(s0));
+        pb.val(gadget.sigma1[i]) = FieldT(long(s1));
+        sha256_witness_bits(pb, first + 2, s0, SHA256_WORD_BITS);
+        sha256_witness_bits(pb, first + 2 + SHA256_WORD_BITS, s0_tmp, SHA256_SMALL_SIGMA0_VARIABLES - SHA256_WORD_BITS);
+        sha256_witness_bits(pb, first + 2 + SHA256_SMALL_SIGMA0_VARIABLES, s1, SHA256_WORD_BITS);
+        sha256_witness_bits(pb, first + 2 + SHA256_SMALL_SIGMA0_VARIABLES + SHA256_WORD_BITS, s1_tmp, SHA256_SMALL_SIGMA1_VARIABLES - SHA256_WORD_BITS);
+
+        sha256_lastbits_witness(pb, *gadget.mod_reduce_W[i], uint64_t(s0) + s1 + W[i - 16] + W[i - 7]);
+    }
+}
+
+/**
+* The previous output plus the last rounds' a and e words, and the output digest's bits
+*/
+inline void sha256_output_witness(ProtoboardT &pb, const std::vector<libsnark::lastbits_gadget<FieldT>> &reduce_output, const native::Sha256Trace &trace)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        sha256_lastbits_witness(pb, reduce_output[i], uint64_t(trace.A[3 - i]) + trace.A[67 - i]);
+        sha256_lastbits_witness(pb, reduce_output[4 + i], uint64_t(trace.E[3 - i]) + trace.E[67 - i]);
+    }
+}
+
+inline bool sha256_compression_layout_matches(const libsnark::sha256_compression_function_gadget<FieldT> &gadget)
+{
+    if (!sha256_message_schedule_layout_matches(*gadget.message_schedule))
+    {
+        return false;
+    }
+    for (const auto &round_function : gadget.round_functions)
+    {
+        if (!sha256_round_layout_matches(round_function))
+        {
+            return false;
+        }
+    }
+    for (const auto &reduce : gadget.reduce_output)
+    {
+        if (!sha256_lastbits_layout_matches(reduce))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* The full witness of a compression function gadget whose previous output
+* and block are already assigned, `trace` being that of the same state and block
+*/
+inline void sha256_compression_witness(ProtoboardT &pb, const libsnark::sha256_compression_function_gadget<FieldT> &gadget, const native::Sha256Trace &trace)
+{
+    sha256_message_schedule_witness(pb, *gadget.message_schedule, trace);
+    for (size_t i = 0; i < 64; i++)
+    {
+        sha256_round_witness(pb, gadget.round_functions[i], trace, i, uint64_t(native::SHA256_K[i]) + trace.W[i]);
+    }
+    sha256_output_witness(pb, gadget.reduce_output, trace);
+}
+
+} // namespace ethsnarks
+
+#endif // SHA256_WITNESS_HPP_
@@ -2,6 +2,13 @@
     Mixer library used to generate Proof of Deposit
 */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
 #include "mixer.hpp"
 #include "export.hpp"
 #include "import.hpp"
@@ -15,6 +22,17 @@
 #include "gadgets/mimc.hpp"
 #include "gadgets/merkle_tree.cpp"
 
+// native (out of circuit) implementations
+#include "native/leaf_batch.hpp"
+#include "native/mimc_batch.hpp"
+#include "native/merkle_tree.hpp"
+#include "native/merkle_tree_file.hpp"
+#include "native/merkle_tree_versioned.hpp"
+#include "native/merkle_tree_watch.hpp"
+
+// prover
+#include "prover/groth16.hpp"
+
 using ethsnarks::FieldT;
 using ethsnarks::ppT;
 using ethsnarks::ProtoboardT;
@@ -24,6 +42,10 @@ using libsnark::generate_r1cs_equals_const_constraint;
 
 const size_t MIXER_TREE_DEPTH = 15;
 
+// Header of the files saved by mixer_prover_prepare
+static const char MIXER_PREPARED_MAGIC[8] = {'M', 'I', 'X', 'P', 'R', 'E', 'P', '\0'};
+static const uint32_t MIXER_PREPARED_VERSION = 1;
+
 namespace ethsnarks
 {
 
@@ -37,7 +59,7 @@ public:
     // typedef LongsightL12p5_MP_gadget HashT;      // MiMC - for merkle tree and nullifier
     typedef Sha256EthFields Sha256HashT; // SHA256 - for commitment
     // typedef LongsightL12p5_MP_gadget Sha256HashT; // MiMC - for commitment
-    const size_t tree_depth = MIXER_TREE_DEPTH;
+    const size_t tree_depth;
 
     // public inputs
     const VariableT root_var;
@@ -60,11 +82,16 @@ public:
     HashT nullifier_hash;
     // HashT leaf_hash;
     Sha256HashT leaf_hash;
+
+    // Variables from here on depend on the merkle tree
+    const size_t authenticator_variables_begin;
     merkle_path_authenticator<HashT> m_authenticator;
 
     mod_mixer(
         ProtoboardT &in_pb,
-        const std::string &annotation_prefix) : GadgetT(in_pb, annotation_prefix),
+        const std::string &annotation_prefix,
+        size_t in_tree_depth = MIXER_TREE_DEPTH) : GadgetT(in_pb, annotation_prefix),
+                                                   tree_depth(in_tree_depth),
 
                                                 // public inputs
                                                 root_var(make_variable(in_pb, FMT(annotation_prefix, ".root_var"))),
@@ -89,6 +116,7 @@ public:
                                                 nullifier_hash(in_pb, nullifier_hash_IV, {nullifier_secret_var, nullifier_secret_var}, FMT(annotation_prefix, ".spend_hash")),
                                                 // leaf_hash(in_pb, leaf_hash_IV, {nullifier_secret_var, wallet_address_var}, FMT(annotation_prefix, ".leaf_hash")),
                                                 leaf_hash(in_pb, nullifier_secret_var, wallet_address_var, FMT(annotation_prefix, ".leaf_hash")),
+                                                authenticator_variables_begin(in_pb.num_variables() + 1),
                                                 m_authenticator(in_pb, tree_depth, address_bits, m_IVs, leaf_hash.result(), root_var, path_var, FMT(annotation_prefix, ".authenticator"))
     {
         in_pb.set_input_sizes(3);
@@ -104,21 +132,71 @@ public:
         this->pb.add_r1cs_constraint(libsnark::r1cs_constraint<FieldT>(nullifier_var, 1, nullifier_hash.result()));
     }
 
+    /**
+    * Whether each variable of the padded assignment, ONE first, is known
+    * when the deposit is made: everything but the root, the address bits,
+    * the path and the authenticator's variables
+    */
+    std::vector<bool> deposit_variables() const
+    {
+        std::vector<bool> known(this->pb.num_variables() + 1, true);
+        known[root_var.index] = false;
+        for (const auto &bit : address_bits)
+        {
+            known[bit.index] = false;
+        }
+        for (const auto &node : path_var)
+        {
+            known[node.index] = false;
+        }
+        std::fill(known.begin() + authenticator_variables_begin, known.end(), false);
+        return known;
+    }
+
+    /**
+    * The variables which only depend on the deposit, see `deposit_variables`
+    */
+    void generate_deposit_witness(
+        FieldT in_wallet_address,   // wallet address
+        FieldT in_nullifier,        // unique linkable tag
+        FieldT in_nullifier_secret) // nullifier preimage
+    {
+        // public inputs
+        this->pb.val(wallet_address_var) = in_wallet_address;
+        this->pb.val(nullifier_var) = in_nullifier;
+
+        // private inputs
+        this->pb.val(nullifier_secret_var) = in_nullifier_secret;
+
+        // gadgets
+        nullifier_hash.generate_r1cs_witness();
+        leaf_hash.generate_r1cs_witness();
+    }
+
     void generate_r1cs_witness(
         FieldT in_root,             // merkle tree root
         FieldT in_wallet_address,   // wallet address
         FieldT in_nullifier,        // unique linkable tag
         FieldT in_nullifier_secret, // nullifier preimage
-        libff::bit_vector in_address,
-        std::vector<FieldT> &in_path)
+        const libff::bit_vector &in_address,
+        const std::vector<FieldT> &in_path)
+    {
+        generate_deposit_witness(in_wallet_address, in_nullifier, in_nullifier_secret);
+        generate_tree_witness(in_root, in_address, in_path);
+    }
+
+    /**
+    * The variables which depend on the merkle tree, after those of the deposit
+    */
+    void generate_tree_witness(
+        FieldT in_root, // merkle tree root
+        const libff::bit_vector &in_address,
+        const std::vector<FieldT> &in_path)
     {
         // public inputs
         this->pb.val(root_var) = in_root;
-        this->pb.val(wallet_address_var) = in_wallet_address;
-        this->pb.val(nullifier_var) = in_nullifier;
 
         // private inputs
-        this->pb.val(nullifier_secret_var) = in_nullifier_secret;
         address_bits.fill_with_bits(this->pb, in_address);
 
         for (size_t i = 0; i < tree_depth; i++)
@@ -127,8 +205,6 @@ public:
         }
 
         // gadgets
-        nullifier_hash.generate_r1cs_witness();
-        leaf_hash.generate_r1cs_witness();
         m_authenticator.generate_r1cs_witness();
     }
 };
@@ -136,13 +212,717 @@ public:
 // namespace ethsnarks
 } // namespace ethsnarks
 
+/**
+* Fixed-base tables for the proving key are cached beside it
+*/
+static std::string mixer_tables_file(const char *pk_file)
+{
+    return std::string(pk_file) + ".tables";
+}
+
+/**
+* Window of the fixed-base tables to build when a prover is created without
+* a tables file, from the MIXER_FIXED_BASE_WINDOW environment variable.
+* 0 (the default) doesn't build any tables.
+*/
+static size_t mixer_fixed_base_window()
+{
+    const char *window = ::getenv("MIXER_FIXED_BASE_WINDOW");
+    return (window != nullptr) ? ::strtoul(window, nullptr, 10) : 0;
+}
+
+/**
+* A protoboard's assignment, read in place by the prover
+*/
+static ethsnarks::prover::PaddedAssignment mixer_padded_assignment(ProtoboardT &pb)
+{
+    return ethsnarks::prover::PaddedAssignment(&pb.val(ethsnarks::VariableT(1)), pb.num_variables());
+}
+
+/**
+* The mixer circuit's variables on a protoboard of their own, without its
+* constraints, where a batch generates the next proof's witness while the
+* context's protoboard is proved
+*/
+struct mixer_workspace
+{
+    ProtoboardT pb;
+    ethsnarks::mod_mixer mod;
+
+    mixer_workspace() : pb(),
+                        mod(pb, "module")
+    {
+    }
+};
+
+static bool mixer_parse_address(const char *in_address, libff::bit_vector &out_address_bits)
+{
+    // Fill address bits with 0s and 1s from str
+    out_address_bits.resize(MIXER_TREE_DEPTH);
+    if (strlen(in_address) != MIXER_TREE_DEPTH)
+    {
+        std::cerr << "Address length doesnt match depth" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+    {
+        if (in_address[i] != '0' and in_address[i] != '1')
+        {
+            std::cerr << "Address bit " << i << " invalid, unknown: " << in_address[i] << std::endl;
+            return false;
+        }
+        out_address_bits[i] = '0' - in_address[i];
+    }
+    return true;
+}
+
+static bool mixer_parse_path(const char **in_path, std::vector<FieldT> &out_path)
+{
+    // Fill path from field elements from in_path
+    out_path.resize(MIXER_TREE_DEPTH);
+    for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+    {
+        if (in_path[i] == nullptr)
+        {
+            std::cerr << "Path node " << i << " missing" << std::endl;
+            return false;
+        }
+        out_path[i] = FieldT(in_path[i]);
+    }
+    return true;
+}
+
+/**
+* The arguments of a proof, parsed
+*/
+struct mixer_proof_args
+{
+    FieldT root;
+    FieldT wallet_address;
+    FieldT nullifier;
+    FieldT nullifier_secret;
+    libff::bit_vector address_bits;
+    std::vector<FieldT> path;
+
+    bool parse(
+        const char *in_root,
+        const char *in_wallet_address,
+        const char *in_nullifier,
+        const char *in_nullifier_secret,
+        const char *in_address,
+        const char **in_path)
+    {
+        root = FieldT(in_root);
+        wallet_address = FieldT(in_wallet_address);
+        nullifier = FieldT(in_nullifier);
+        nullifier_secret = FieldT(in_nullifier_secret);
+
+        if (!mixer_parse_address(in_address, address_bits))
+        {
+            return false;
+        }
+
+        return mixer_parse_path(in_path, path);
+    }
+};
+
+/**
+* Everything needed to create proofs which doesn't change between them:
+* the deserialized proving key, whose constraint system witnesses are
+* checked against, the protoboard with the mixer circuit's variables and
+* the prover with any fixed-base tables for the key.
+*
+* Proving only overwrites the variable assignment, every variable that isn't
+* a constant set at construction time (e.g. the merkle tree IVs) is assigned
+* by `mod_mixer::generate_r1cs_witness`, so no reset is necessary.
+*
+* The prover's buffers and a proof's parsed arguments are kept too, once the
+* first proof has sized them, proving doesn't allocate them again.
+*/
+struct mixer_prover
+{
+    typedef libsnark::r1cs_constraint_system<FieldT> ConstraintSystemT;
+
+    ProvingKeyT proving_key;
+    ProtoboardT pb;
+    ethsnarks::mod_mixer mod;
+    const ConstraintSystemT &constraint_system;
+    ethsnarks::prover::Groth16Prover prover;
+    const std::vector<bool> deposit_variables;
+
+    // Assignment and sums of the last proof, for mixer_prover_reprove
+    ethsnarks::prover::ProvedAssignment last_proof;
+
+    // Created by the first batch of proofs
+    std::unique_ptr<mixer_workspace> batch_workspace;
+
+    ethsnarks::prover::ProverArena arena;
+    mixer_proof_args args;
+
+    mixer_prover(const char *pk_file) : proving_key(ethsnarks::loadFromFile<ProvingKeyT>(pk_file)),
+                                        pb(),
+                                        mod(pb, "module"),
+                                        constraint_system(proving_key.constraint_system),
+                                        prover(proving_key),
+                                        deposit_variables(mod.deposit_variables())
+    {
+        std::cout << "Number of constraints for Hopper: " << constraint_system.num_constraints() << std::endl;
+
+        if (!prover.load_tables(mixer_tables_file(pk_file)) && mixer_fixed_base_window() != 0)
+        {
+            prover.precompute(mixer_fixed_base_window());
+        }
+    }
+};
+
 size_t mixer_tree_depth(void)
 {
     return MIXER_TREE_DEPTH;
 }
 
-char *mixer_prove(
-    const char *pk_file,
+void mixer_free(void *ptr)
+{
+    ::free(ptr);
+}
+
+static void mixer_init_public_params()
+{
+    static std::once_flag initialised;
+    std::call_once(initialised, []() { ppT::init_public_params(); });
+}
+
+/**
+* Decimal representation of a field element, allocated with malloc
+*/
+static char *mixer_field_to_cstr(const FieldT &value)
+{
+    mpz_t value_mpz;
+    mpz_init(value_mpz);
+    value.as_bigint().to_mpz(value_mpz);
+
+    char *result = (char *)::malloc(mpz_sizeinbase(value_mpz, 10) + 2);
+    mpz_get_str(result, 10, value_mpz);
+    mpz_clear(value_mpz);
+
+    return result;
+}
+
+char *mixer_mimc(const char *in_x, const char *in_k)
+{
+    mixer_init_public_params();
+
+    return mixer_field_to_cstr(ethsnarks::mimc(FieldT(in_x), FieldT(in_k)));
+}
+
+char *mixer_mimc_hash(const char **in_msgs, size_t in_count, const char *in_key)
+{
+    mixer_init_public_params();
+
+    std::vector<FieldT> msgs;
+    msgs.reserve(in_count);
+    for (size_t i = 0; i < in_count; i++)
+    {
+        msgs.emplace_back(in_msgs[i]);
+    }
+
+    return mixer_field_to_cstr(ethsnarks::mimc_hash(msgs, FieldT(in_key)));
+}
+
+int mixer_mimc_hash_batch(const char **in_msgs, size_t in_msgs_per_hash, const char **in_keys, size_t in_count, char **out_hashes)
+{
+    mixer_init_public_params();
+
+    if (in_msgs_per_hash == 0)
+    {
+        return 1;
+    }
+
+    std::vector<FieldT> msgs;
+    msgs.reserve(in_count * in_msgs_per_hash);
+    for (size_t i = 0; i < (in_count * in_msgs_per_hash); i++)
+    {
+        msgs.emplace_back(in_msgs[i]);
+    }
+
+    std::vector<FieldT> keys;
+    if (in_keys != nullptr)
+    {
+        keys.reserve(in_count);
+        for (size_t i = 0; i < in_count; i++)
+        {
+            keys.emplace_back(in_keys[i]);
+        }
+    }
+    else
+    {
+        keys.push_back(FieldT::zero());
+    }
+
+    std::vector<FieldT> hashes(in_count);
+    const auto &batch = ethsnarks::native::MiMCe7_batch::default_instance();
+    batch.hash(msgs.data(), in_msgs_per_hash, keys.data(), (in_keys != nullptr ? 1 : 0), hashes.data(), in_count);
+
+    for (size_t i = 0; i < in_count; i++)
+    {
+        out_hashes[i] = mixer_field_to_cstr(hashes[i]);
+    }
+
+    return 0;
+}
+
+static std::vector<FieldT> mixer_parse_fields(const char **in_values, size_t in_count)
+{
+    std::vector<FieldT> values;
+    values.reserve(in_count);
+    for (size_t i = 0; i < in_count; i++)
+    {
+        values.emplace_back(in_values[i]);
+    }
+    return values;
+}
+
+int mixer_leaf_hash_batch(const char **in_secrets, const char **in_wallet_addresses, size_t in_count, char **out_leaves, char **out_nullifiers)
+{
+    mixer_init_public_params();
+
+    const auto secrets = mixer_parse_fields(in_secrets, in_count);
+    const auto wallet_addresses = mixer_parse_fields(in_wallet_addresses, in_count);
+
+    std::vector<FieldT> leaves(in_count);
+    ethsnarks::native::leaf_hash_batch(secrets.data(), wallet_addresses.data(), leaves.data(), in_count);
+    for (size_t i = 0; i < in_count; i++)
+    {
+        out_leaves[i] = mixer_field_to_cstr(leaves[i]);
+    }
+
+    if (out_nullifiers != nullptr)
+    {
+        std::vector<FieldT> nullifiers(in_count);
+        ethsnarks::native::nullifier_hash_batch(secrets.data(), nullifiers.data(), in_count);
+        for (size_t i = 0; i < in_count; i++)
+        {
+            out_nullifiers[i] = mixer_field_to_cstr(nullifiers[i]);
+        }
+    }
+
+    return 0;
+}
+
+size_t mixer_match_leaves(const char **in_leaves, size_t in_n_leaves, const char **in_secrets, const char **in_wallet_addresses, size_t in_count, long *out_offsets)
+{
+    mixer_init_public_params();
+
+    const auto leaves = mixer_parse_fields(in_leaves, in_n_leaves);
+    const ethsnarks::native::LeafOffsets offsets(leaves.data(), leaves.size());
+
+    const auto secrets = mixer_parse_fields(in_secrets, in_count);
+    const auto wallet_addresses = mixer_parse_fields(in_wallet_addresses, in_count);
+    std::vector<FieldT> deposits(in_count);
+    ethsnarks::native::leaf_hash_batch(secrets.data(), wallet_addresses.data(), deposits.data(), in_count);
+
+    size_t n_found = 0;
+    for (size_t i = 0; i < in_count; i++)
+    {
+        out_offsets[i] = offsets.find(deposits[i]);
+        if (out_offsets[i] >= 0)
+        {
+            n_found++;
+        }
+    }
+
+    return n_found;
+}
+
+/**
+* Either an in-memory tree, or one backed by a memory mapped file,
+* and the paths of the leaves being watched
+*/
+struct mixer_tree
+{
+    std::unique_ptr<ethsnarks::native::MerkleTree> tree;
+    bool writable;
+
+    // A read-only tree's watched paths are refreshed once it has grown past watched_size
+    mutable ethsnarks::native::MerkleTreeWatchSet watched;
+    mutable size_t watched_size;
+
+    mixer_tree(ethsnarks::native::MerkleTree *in_tree, bool in_writable) : tree(in_tree),
+                                                                           writable(in_writable),
+                                                                           watched_size(in_tree->size())
+    {
+    }
+};
+
+mixer_tree *mixer_tree_new(void)
+{
+    mixer_init_public_params();
+
+    return new mixer_tree(new ethsnarks::native::MerkleTree(MIXER_TREE_DEPTH), true);
+}
+
+mixer_tree *mixer_tree_open(const char *tree_file, bool writable)
+{
+    mixer_init_public_params();
+
+    auto tree = ethsnarks::native::MerkleTreeFile::open(tree_file, MIXER_TREE_DEPTH, writable);
+    if (tree == nullptr)
+    {
+        return nullptr;
+    }
+
+    return new mixer_tree(tree, writable);
+}
+
+void mixer_tree_free(mixer_tree *tree)
+{
+    delete tree;
+}
+
+long mixer_tree_append(mixer_tree *tree, const char *in_leaf)
+{
+    if (!tree->writable)
+    {
+        std::cerr << "Tree is read-only" << std::endl;
+        return -1;
+    }
+
+    FieldT leaf(in_leaf);
+    if (leaf.is_zero())
+    {
+        std::cerr << "Leaf is null" << std::endl;
+        return -1;
+    }
+    if (tree->tree->is_full())
+    {
+        std::cerr << "Tree is full" << std::endl;
+        return -1;
+    }
+
+    const size_t offset = tree->tree->size();
+    if (!tree->tree->append(leaf))
+    {
+        return -1;
+    }
+    tree->watched.update(*tree->tree, offset, 1);
+
+    return (long)offset;
+}
+
+int mixer_tree_append_many(mixer_tree *tree, const char **in_leaves, size_t in_count)
+{
+    if (!tree->writable)
+    {
+        std::cerr << "Tree is read-only" << std::endl;
+        return 1;
+    }
+    if (in_count > (tree->tree->capacity() - tree->tree->size()))
+    {
+        std::cerr << "Tree is full" << std::endl;
+        return 1;
+    }
+
+    std::vector<FieldT> leaves;
+    leaves.reserve(in_count);
+    for (size_t i = 0; i < in_count; i++)
+    {
+        leaves.emplace_back(in_leaves[i]);
+        if (leaves.back().is_zero())
+        {
+            std::cerr << "Leaf " << i << " is null" << std::endl;
+            return 1;
+        }
+    }
+
+    const size_t first = tree->tree->size();
+    if (!tree->tree->append_many(leaves.data(), leaves.size()))
+    {
+        return 1;
+    }
+    tree->watched.update(*tree->tree, first, in_count);
+
+    return 0;
+}
+
+size_t mixer_tree_size(const mixer_tree *tree)
+{
+    return tree->tree->size();
+}
+
+char *mixer_tree_root(const mixer_tree *tree)
+{
+    return mixer_field_to_cstr(tree->tree->root());
+}
+
+/**
+* Authentication path in the format of mixer_prove's arguments
+*/
+static void mixer_path_to_cstrs(const std::vector<FieldT> &path, const libff::bit_vector &address_bits, char **out_path, char *out_address)
+{
+    for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+    {
+        out_path[i] = mixer_field_to_cstr(path[i]);
+        out_address[i] = address_bits[i] ? '1' : '0';
+    }
+    out_address[MIXER_TREE_DEPTH] = 0;
+}
+
+int mixer_tree_path(const mixer_tree *tree, size_t in_offset, char **out_path, char *out_address)
+{
+    if (in_offset >= tree->tree->capacity())
+    {
+        std::cerr << "Offset " << in_offset << " outside of tree" << std::endl;
+        return 1;
+    }
+
+    std::vector<FieldT> path;
+    libff::bit_vector address_bits;
+    tree->tree->path(in_offset, path, address_bits);
+    mixer_path_to_cstrs(path, address_bits, out_path, out_address);
+
+    return 0;
+}
+
+/**
+* The leaves of a read-only tree are appended by its file's writer, in
+* another process, so its watched paths are read again when it has grown
+*/
+static void mixer_tree_sync_watched(const mixer_tree *tree)
+{
+    if (tree->writable)
+    {
+        return;
+    }
+
+    const size_t size = tree->tree->size();
+    if (size != tree->watched_size)
+    {
+        tree->watched_size = size;
+        tree->watched.refresh(*tree->tree);
+    }
+}
+
+int mixer_tree_watch(mixer_tree *tree, size_t in_offset)
+{
+    if (in_offset >= tree->tree->capacity())
+    {
+        std::cerr << "Offset " << in_offset << " outside of tree" << std::endl;
+        return 1;
+    }
+
+    mixer_tree_sync_watched(tree);
+    tree->watched.watch(*tree->tree, in_offset);
+
+    return 0;
+}
+
+int mixer_tree_unwatch(mixer_tree *tree, size_t in_offset)
+{
+    return tree->watched.unwatch(in_offset) ? 0 : 1;
+}
+
+int mixer_tree_watched_path(const mixer_tree *tree, size_t in_offset, char **out_path, char *out_address)
+{
+    mixer_tree_sync_watched(tree);
+
+    std::vector<FieldT> path;
+    libff::bit_vector address_bits;
+    if (!tree->watched.path(in_offset, path, address_bits))
+    {
+        std::cerr << "Offset " << in_offset << " isn't watched" << std::endl;
+        return 1;
+    }
+    mixer_path_to_cstrs(path, address_bits, out_path, out_address);
+
+    return 0;
+}
+
+struct mixer_versioned_tree : public ethsnarks::native::VersionedMerkleTree
+{
+    mixer_versioned_tree() : VersionedMerkleTree(MIXER_TREE_DEPTH)
+    {
+    }
+};
+
+mixer_versioned_tree *mixer_versioned_tree_new(void)
+{
+    mixer_init_public_params();
+
+    return new mixer_versioned_tree();
+}
+
+void mixer_versioned_tree_free(mixer_versioned_tree *tree)
+{
+    delete tree;
+}
+
+long mixer_versioned_tree_append(mixer_versioned_tree *tree, const char *in_leaf)
+{
+    FieldT leaf(in_leaf);
+    if (leaf.is_zero())
+    {
+        std::cerr << "Leaf is null" << std::endl;
+        return -1;
+    }
+    if (tree->is_full())
+    {
+        std::cerr << "Tree is full" << std::endl;
+        return -1;
+    }
+
+    tree->append(leaf);
+
+    return (long)tree->size() - 1;
+}
+
+size_t mixer_versioned_tree_size(const mixer_versioned_tree *tree)
+{
+    return tree->size();
+}
+
+char *mixer_versioned_tree_root(const mixer_versioned_tree *tree, size_t in_version)
+{
+    if (in_version > tree->size())
+    {
+        std::cerr << "Unknown tree version " << in_version << std::endl;
+        return nullptr;
+    }
+
+    return mixer_field_to_cstr(tree->root(in_version));
+}
+
+long mixer_versioned_tree_find_root(const mixer_versioned_tree *tree, const char *in_root)
+{
+    size_t version;
+    if (!tree->find_version(FieldT(in_root), version))
+    {
+        return -1;
+    }
+
+    return (long)version;
+}
+
+int mixer_versioned_tree_path(const mixer_versioned_tree *tree, size_t in_version, size_t in_offset, char **out_path, char *out_address)
+{
+    if (in_version > tree->size())
+    {
+        std::cerr << "Unknown tree version " << in_version << std::endl;
+        return 1;
+    }
+    if (in_offset >= tree->capacity())
+    {
+        std::cerr << "Offset " << in_offset << " outside of tree" << std::endl;
+        return 1;
+    }
+
+    std::vector<FieldT> path;
+    libff::bit_vector address_bits;
+    tree->path(in_version, in_offset, path, address_bits);
+    mixer_path_to_cstrs(path, address_bits, out_path, out_address);
+
+    return 0;
+}
+
+mixer_prover *mixer_prover_new(const char *pk_file)
+{
+    mixer_init_public_params();
+
+    std::ifstream pk_stream(pk_file, std::ios::binary);
+    if (!pk_stream.is_open())
+    {
+        std::cerr << "Cannot open proving key: " << pk_file << std::endl;
+        return nullptr;
+    }
+    pk_stream.close();
+
+    return new mixer_prover(pk_file);
+}
+
+void mixer_prover_free(mixer_prover *ctx)
+{
+    delete ctx;
+}
+
+/**
+* Whether the constraints are satisfied, reading the assignment in place
+*/
+static bool mixer_prover_satisfied(const mixer_prover *ctx, ProtoboardT &pb)
+{
+    if (!ethsnarks::prover::constraints_satisfied(ctx->constraint_system, mixer_padded_assignment(pb), ctx->prover.n_threads()))
+    {
+        std::cerr << "Not Satisfied!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+* Assigns the witness of a proof, false if the arguments aren't valid or don't satisfy the circuit
+*/
+static bool mixer_prover_witness(
+    mixer_prover *ctx,
+    const char *in_root,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret,
+    const char *in_address,
+    const char **in_path)
+{
+    auto &args = ctx->args;
+    if (!args.parse(in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path))
+    {
+        return false;
+    }
+
+    ctx->mod.generate_r1cs_witness(args.root, args.wallet_address, args.nullifier, args.nullifier_secret, args.address_bits, args.path);
+
+    return mixer_prover_satisfied(ctx, ctx->pb);
+}
+
+/**
+* A proof in stages: the sums over the deposit's variables are computed
+* while the tree's are generated, unless they're given in deposit_sums,
+* then H and the other sums while the constraints are checked
+*/
+static char *mixer_prover_prove_pipelined(
+    mixer_prover *ctx,
+    const ethsnarks::prover::PartialSums *deposit_sums,
+    const char *in_root,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret,
+    const char *in_address,
+    const char **in_path)
+{
+    auto &args = ctx->args;
+    if (!args.parse(in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path))
+    {
+        return nullptr;
+    }
+
+    auto &mod = ctx->mod;
+    mod.generate_deposit_witness(args.wallet_address, args.nullifier, args.nullifier_secret);
+
+    ethsnarks::prover::Groth16Prover::ProofT proof;
+    const bool proved = ctx->prover.prove_pipelined(
+        mixer_padded_assignment(ctx->pb), ctx->pb.num_inputs(), ctx->deposit_variables,
+        [&mod, &args]() -> bool {
+            mod.generate_tree_witness(args.root, args.address_bits, args.path);
+            return true;
+        },
+        [ctx]() -> bool { return mixer_prover_satisfied(ctx, ctx->pb); },
+        proof, &ctx->last_proof, &ctx->arena, deposit_sums);
+    if (!proved)
+    {
+        return nullptr;
+    }
+
+    auto json = ethsnarks::proof_to_json(proof, ctx->pb.primary_input());
+
+    return ::strdup(json.c_str());
+}
+
+char *mixer_prover_prove(
+    mixer_prover *ctx,
     const char *in_root,
     const char *in_wallet_address,
     const char *in_nullifier,
@@ -150,78 +930,260 @@ char *mixer_prove(
     const char *in_address, // [LSB...MSB] with regard to bits of index
     const char **in_path)
 {
-    // std::cout << "ENTERING mixer_prove" << std::endl;
-    // std::cout << "pk_file: " << pk_file << std::endl;
-    // std::cout << "in_root: " << in_root << std::endl;
-    // std::cout << "in_wallet_address: " << in_wallet_address << std::endl;
-    // std::cout << "in_nullifier: " << in_nullifier << std::endl;
-    // std::cout << "in_nullifier_secret: " << in_nullifier_secret << std::endl;
-    // std::cout << "in_address: " << in_address << std::endl;
-    // std::cout << "in_path: " << std::endl
-    //           << "[";
-    // for (size_t j = 0; in_path[j] != nullptr; j++)
-    // {
-    //     std::cout << " \"" << in_path[j];
-    //     if (in_path[j + 1] == nullptr)
-    //     {
-    //         std::cout << "\"]" << std::endl;
-    //     }
-    //     else
-    //     {
-    //         std::cout << "\"," << std::endl;
-    //     }
-    // }
-
-    ppT::init_public_params();
-
-    FieldT arg_root(in_root);
+    return mixer_prover_prove_prepared(ctx, nullptr, in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path);
+}
+
+int mixer_prover_prepare(
+    mixer_prover *ctx,
+    const char *prepared_file,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret)
+{
     FieldT arg_wallet_address(in_wallet_address);
     FieldT arg_nullifier(in_nullifier);
     FieldT arg_nullifier_secret(in_nullifier_secret);
 
-    // Fill address bits with 0s and 1s from str
-    libff::bit_vector address_bits;
-    address_bits.resize(MIXER_TREE_DEPTH);
-    if (strlen(in_address) != MIXER_TREE_DEPTH)
+    auto &pb = ctx->pb;
+    ctx->mod.generate_deposit_witness(arg_wallet_address, arg_nullifier, arg_nullifier_secret);
+    if (!(pb.val(ctx->mod.nullifier_hash.result()) == arg_nullifier))
     {
-        std::cerr << "Address length doesnt match depth" << std::endl;
-        return nullptr;
+        std::cerr << "Nullifier doesn't match its secret" << std::endl;
+        return 1;
     }
-    for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+
+    // Everything but the deposit's variables is left out of the sums
+    const auto sums = ctx->prover.evaluate_sums(mixer_padded_assignment(ctx->pb), pb.num_inputs(), ctx->deposit_variables, true);
+
+    // Saved with the public inputs they're for, which must match when proving
+    const auto wallet_address_limbs = arg_wallet_address.as_bigint();
+    const auto nullifier_limbs = arg_nullifier.as_bigint();
+    std::ofstream out(prepared_file, std::ios::binary);
+    if (out.is_open())
     {
-        if (in_address[i] != '0' and in_address[i] != '1')
+        out.write(MIXER_PREPARED_MAGIC, sizeof(MIXER_PREPARED_MAGIC));
+        out.write(reinterpret_cast<const char *>(&MIXER_PREPARED_VERSION), sizeof(MIXER_PREPARED_VERSION));
+        out.write(reinterpret_cast<const char *>(wallet_address_limbs.data), sizeof(wallet_address_limbs.data));
+        out.write(reinterpret_cast<const char *>(nullifier_limbs.data), sizeof(nullifier_limbs.data));
+    }
+    if (!out.is_open() || !ctx->prover.save_sums(out, sums))
+    {
+        std::cerr << "Cannot save prepared deposit: " << prepared_file << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+char *mixer_prover_prove_prepared(
+    mixer_prover *ctx,
+    const char *prepared_file,
+    const char *in_root,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret,
+    const char *in_address, // [LSB...MSB] with regard to bits of index
+    const char **in_path)
+{
+    if (prepared_file == nullptr)
+    {
+        return mixer_prover_prove_pipelined(ctx, nullptr, in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path);
+    }
+
+    auto deposit_sums = ethsnarks::prover::PartialSums::zero();
+    {
+        std::ifstream in(prepared_file, std::ios::binary);
+        char magic[sizeof(MIXER_PREPARED_MAGIC)];
+        uint32_t version = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char *>(&version), sizeof(version));
+        if (!in || 0 != ::memcmp(magic, MIXER_PREPARED_MAGIC, sizeof(magic)) || version != MIXER_PREPARED_VERSION)
         {
-            std::cerr << "Address bit " << i << " invalid, unknown: " << in_address[i] << std::endl;
+            std::cerr << "Not a prepared deposit, or of another version: " << prepared_file << std::endl;
+            return nullptr;
+        }
+
+        auto wallet_address_limbs = FieldT::zero().as_bigint();
+        auto nullifier_limbs = wallet_address_limbs;
+        in.read(reinterpret_cast<char *>(wallet_address_limbs.data), sizeof(wallet_address_limbs.data));
+        in.read(reinterpret_cast<char *>(nullifier_limbs.data), sizeof(nullifier_limbs.data));
+        if (!in || !(wallet_address_limbs == FieldT(in_wallet_address).as_bigint()) || !(nullifier_limbs == FieldT(in_nullifier).as_bigint()))
+        {
+            std::cerr << "Not a prepared deposit for this wallet and nullifier: " << prepared_file << std::endl;
+            return nullptr;
+        }
+        if (!ctx->prover.load_sums(in, deposit_sums))
+        {
+            std::cerr << "Cannot load prepared deposit: " << prepared_file << std::endl;
             return nullptr;
         }
-        address_bits[i] = '0' - in_address[i];
     }
 
-    // Fill path from field elements from in_path
-    std::vector<FieldT> arg_path;
-    arg_path.resize(MIXER_TREE_DEPTH);
-    for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+    // The deposit's witness is still generated, H and the constraints need it
+    return mixer_prover_prove_pipelined(ctx, &deposit_sums, in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path);
+}
+
+char *mixer_prover_reprove(
+    mixer_prover *ctx,
+    const char *in_root,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret,
+    const char *in_address, // [LSB...MSB] with regard to bits of index
+    const char **in_path)
+{
+    if (!mixer_prover_witness(ctx, in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path))
     {
-        assert(in_path[i] != nullptr);
-        arg_path[i] = FieldT(in_path[i]);
+        return nullptr;
     }
 
-    ProtoboardT pb;
-    ethsnarks::mod_mixer mod(pb, "module");
-    mod.generate_r1cs_constraints();
-    std::cout << "Number of constraints for Hopper: " << pb.num_constraints() << std::endl;
+    auto proof = ctx->prover.reprove(ctx->last_proof, mixer_padded_assignment(ctx->pb), ctx->pb.num_inputs(), nullptr, &ctx->last_proof, &ctx->arena);
+    auto json = ethsnarks::proof_to_json(proof, ctx->pb.primary_input());
 
-    mod.generate_r1cs_witness(arg_root, arg_wallet_address, arg_nullifier, arg_nullifier_secret, address_bits, arg_path);
+    return ::strdup(json.c_str());
+}
 
-    if (!pb.is_satisfied())
+size_t mixer_prover_prove_batch(
+    mixer_prover *ctx,
+    size_t in_count,
+    const char **in_roots,
+    const char **in_wallet_addresses,
+    const char **in_nullifiers,
+    const char **in_nullifier_secrets,
+    const char **in_addresses,
+    const char **in_paths,
+    char **out_proofs)
+{
+    std::vector<mixer_proof_args> args(in_count);
+    std::vector<size_t> provable;
+    for (size_t i = 0; i < in_count; i++)
+    {
+        out_proofs[i] = nullptr;
+        if (args[i].parse(in_roots[i], in_wallet_addresses[i], in_nullifiers[i], in_nullifier_secrets[i], in_addresses[i], &in_paths[i * MIXER_TREE_DEPTH]))
+        {
+            provable.push_back(i);
+        }
+        else
+        {
+            std::cerr << "Batch input " << i << " is invalid" << std::endl;
+        }
+    }
+
+    // Two protoboards: the next proof's witness is generated on one while the other is proved
+    if (!ctx->batch_workspace)
+    {
+        ctx->batch_workspace.reset(new mixer_workspace());
+    }
+    ProtoboardT *pbs[2] = {&ctx->pb, &ctx->batch_workspace->pb};
+    ethsnarks::mod_mixer *mods[2] = {&ctx->mod, &ctx->batch_workspace->mod};
+
+    std::vector<uint8_t> satisfied(provable.size());
+    auto generate = [ctx, &args, &provable, &pbs, &mods, &satisfied](size_t k) {
+        auto &arg = args[provable[k]];
+        mods[k % 2]->generate_r1cs_witness(arg.root, arg.wallet_address, arg.nullifier, arg.nullifier_secret, arg.address_bits, arg.path);
+        satisfied[k] = mixer_prover_satisfied(ctx, *pbs[k % 2]);
+    };
+
+    size_t n_proofs = 0;
+    if (!provable.empty())
+    {
+        generate(0);
+    }
+    auto &pool = ethsnarks::prover::ThreadPool::instance();
+    for (size_t k = 0; k < provable.size(); k++)
+    {
+        // On one of the prover's pool workers, or after the proof if none is free
+        auto generate_next = [&generate, k](size_t) {
+            generate(k + 1);
+        };
+        ethsnarks::prover::ParallelJob next_witness((k + 1 < provable.size()) ? 1 : 0, generate_next);
+        pool.submit(next_witness, 1);
+
+        ethsnarks::prover::Groth16Prover::ProofT proof;
+        if (satisfied[k] && ctx->prover.prove_pipelined(
+                                mixer_padded_assignment(*pbs[k % 2]), pbs[k % 2]->num_inputs(), ctx->deposit_variables,
+                                []() -> bool { return true; },
+                                []() -> bool { return true; },
+                                proof, &ctx->last_proof, &ctx->arena))
+        {
+            auto json = ethsnarks::proof_to_json(proof, pbs[k % 2]->primary_input());
+            out_proofs[provable[k]] = ::strdup(json.c_str());
+            n_proofs++;
+        }
+
+        pool.wait(next_witness);
+    }
+
+    return n_proofs;
+}
+
+size_t mixer_prover_precompute(mixer_prover *ctx, size_t window, size_t max_rows)
+{
+    if (window < 2 || window > 24)
+    {
+        std::cerr << "Fixed-base window must be between 2 and 24 bits" << std::endl;
+        return 0;
+    }
+
+    ctx->prover.precompute(window, max_rows);
+
+    return ctx->prover.tables_memory_size();
+}
+
+void mixer_prover_buffer_growth(const mixer_prover *ctx, size_t *out_growths, size_t *out_bytes, size_t *out_threads)
+{
+    if (out_growths != nullptr)
+    {
+        *out_growths = ctx->arena.counters.allocations.load();
+    }
+    if (out_bytes != nullptr)
+    {
+        *out_bytes = ctx->arena.counters.bytes.load();
+    }
+    if (out_threads != nullptr)
+    {
+        *out_threads = ethsnarks::prover::ThreadPool::instance().threads_started();
+    }
+}
+
+int mixer_precompute(const char *pk_file, size_t window, size_t max_rows)
+{
+    auto ctx = mixer_prover_new(pk_file);
+    if (ctx == nullptr)
+    {
+        return 1;
+    }
+
+    int result = 0;
+    if (0 == mixer_prover_precompute(ctx, window, max_rows) || !ctx->prover.save_tables(mixer_tables_file(pk_file)))
+    {
+        std::cerr << "Cannot save fixed-base tables: " << mixer_tables_file(pk_file) << std::endl;
+        result = 1;
+    }
+    mixer_prover_free(ctx);
+
+    return result;
+}
+
+char *mixer_prove(
+    const char *pk_file,
+    const char *in_root,
+    const char *in_wallet_address,
+    const char *in_nullifier,
+    const char *in_nullifier_secret,
+    const char *in_address, // [LSB...MSB] with regard to bits of index
+    const char **in_path)
+{
+    auto ctx = mixer_prover_new(pk_file);
+    if (ctx == nullptr)
     {
-        std::cerr << "Not Satisfied!" << std::endl;
         return nullptr;
     }
 
-    auto json = ethsnarks::stub_prove_from_pb(pb, pk_file);
+    auto json = mixer_prover_prove(ctx, in_root, in_wallet_address, in_nullifier, in_nullifier_secret, in_address, in_path);
+    mixer_prover_free(ctx);
 
-    return ::strdup(json.c_str());
+    return json;
 }
 
 int mixer_genkeys(const char *pk_file, const char *vk_file)
@@ -13,6 +13,8 @@ extern "C"
 
     const extern size_t MIXER_TREE_DEPTH;
 
+    typedef struct mixer_prover mixer_prover;
+
     char *mixer_prove(
         const char *pk_file,
         const char *in_root,
@@ -22,12 +24,248 @@ extern "C"
         const char *in_address,
         const char **in_path);
 
+    /**
+    * Persistent proving context, loads the proving key and builds the
+    * circuit once so that it can be re-used for many proofs.
+    * A context must not be used by more than one thread at a time.
+    */
+    mixer_prover *mixer_prover_new(const char *pk_file);
+
+    char *mixer_prover_prove(
+        mixer_prover *ctx,
+        const char *in_root,
+        const char *in_wallet_address,
+        const char *in_nullifier,
+        const char *in_nullifier_secret,
+        const char *in_address,
+        const char **in_path);
+
+    /**
+    * Pre-proves a deposit when it's made, before its leaf is in the tree.
+    * Saves to prepared_file the parts of the proof's multi-scalar
+    * multiplications over the variables which only depend on the deposit,
+    * i.e. the nullifier and leaf hashes, for mixer_prover_prove_prepared.
+    * They're derived from the secret, keep the file as safe as it.
+    * Returns 0 on success.
+    */
+    int mixer_prover_prepare(
+        mixer_prover *ctx,
+        const char *prepared_file,
+        const char *in_wallet_address,
+        const char *in_nullifier,
+        const char *in_nullifier_secret);
+
+    /**
+    * Like mixer_prover_prove, for a deposit prepared by mixer_prover_prepare
+    * with the same proving key, so only the variables which depend on the
+    * tree and H are left to multiply.
+    */
+    char *mixer_prover_prove_prepared(
+        mixer_prover *ctx,
+        const char *prepared_file,
+        const char *in_root,
+        const char *in_wallet_address,
+        const char *in_nullifier,
+        const char *in_nullifier_secret,
+        const char *in_address,
+        const char **in_path);
+
+    /**
+    * Like mixer_prover_prove, from the last proof made with ctx, e.g. when
+    * the root changed before it was used. The last proof's multi-scalar
+    * multiplications are kept, so only the variables which changed since,
+    * such as the root and the path above the new leaf, and H are left to
+    * multiply. The proof is randomised anew, as any other.
+    */
+    char *mixer_prover_reprove(
+        mixer_prover *ctx,
+        const char *in_root,
+        const char *in_wallet_address,
+        const char *in_nullifier,
+        const char *in_nullifier_secret,
+        const char *in_address,
+        const char **in_path);
+
+    /**
+    * Proves in_count withdrawals, each input being an array of in_count
+    * arguments of mixer_prover_prove, except in_paths which holds
+    * MIXER_TREE_DEPTH nodes per withdrawal, consecutively. Each proof's
+    * witness is generated and checked while the previous one is proved.
+    * out_proofs[i] is NULL if withdrawal i can't be proved, returns the
+    * number of proofs.
+    */
+    size_t mixer_prover_prove_batch(
+        mixer_prover *ctx,
+        size_t in_count,
+        const char **in_roots,
+        const char **in_wallet_addresses,
+        const char **in_nullifiers,
+        const char **in_nullifier_secrets,
+        const char **in_addresses,
+        const char **in_paths,
+        char **out_proofs);
+
+    void mixer_prover_free(mixer_prover *ctx);
+
+    /**
+    * Precomputes fixed-base tables of the proving key's bases, so proofs use
+    * table lookups and additions instead of doublings. Scalars are split in
+    * digits of `window` bits (2 to 24), each base is stored once for every
+    * digit or, to use less memory, at most `max_rows` times (0 for no limit).
+    * Returns the memory used by the tables in bytes, 0 on failure.
+    */
+    size_t mixer_prover_precompute(mixer_prover *ctx, size_t window, size_t max_rows);
+
+    /**
+    * How ctx's prover buffers, which are kept between proofs, have grown:
+    * out_growths is the number of times one was enlarged and out_bytes the
+    * memory they hold. Both stop increasing once the first proof has sized
+    * them. Other heap allocations, e.g. those of the circuit's gadgets as
+    * the witness is generated, aren't counted. out_threads is the number
+    * of worker threads started by the process, which are never stopped.
+    * Any of the outputs may be NULL.
+    */
+    void mixer_prover_buffer_growth(const mixer_prover *ctx, size_t *out_growths, size_t *out_bytes, size_t *out_threads);
+
+    /**
+    * Precomputes the fixed-base tables once and saves them beside the proving
+    * key, mixer_prover_new then loads them. Returns 0 on success.
+    */
+    int mixer_precompute(const char *pk_file, size_t window, size_t max_rows);
+
     int mixer_genkeys(const char *pk_file, const char *vk_file);
 
     bool mixer_verify(const char *vk_json, const char *proof_json);
 
     size_t mixer_tree_depth(void);
 
+    /**
+    * Releases a string allocated with malloc by this library, e.g. a proof,
+    * a hash or a path node, for callers which can't use the same free()
+    */
+    void mixer_free(void *ptr);
+
+    /**
+    * Native MiMC, arguments and results are decimal strings.
+    * Results are allocated with malloc and must be released with free()
+    */
+    char *mixer_mimc(const char *in_x, const char *in_k);
+
+    char *mixer_mimc_hash(const char **in_msgs, size_t in_count, const char *in_key);
+
+    /**
+    * Computes in_count independent MiMC hashes of in_msgs_per_hash elements
+    * each, stored consecutively in in_msgs, in parallel SIMD lanes.
+    * in_keys holds one key per hash, or is NULL to use a zero key.
+    * Each out_hashes[i] is allocated with malloc, returns 0 on success.
+    */
+    int mixer_mimc_hash_batch(const char **in_msgs, size_t in_msgs_per_hash, const char **in_keys, size_t in_count, char **out_hashes);
+
+    /**
+    * Leaf hashes, as Mixer.makeLeafHash, and nullifiers, as Mixer.makeNullifierHash,
+    * of in_count deposits, hashing many at once in parallel SIMD lanes.
+    * out_nullifiers may be NULL if they aren't needed.
+    * Results are allocated with malloc, returns 0 on success.
+    */
+    int mixer_leaf_hash_batch(const char **in_secrets, const char **in_wallet_addresses, size_t in_count, char **out_leaves, char **out_nullifiers);
+
+    /**
+    * Finds in_count deposits among in_n_leaves leaves, e.g. those of the
+    * LeafAdded events in order. out_offsets[i] is set to the offset of the
+    * leaf of in_secrets[i] and in_wallet_addresses[i], or -1 if it isn't
+    * there. Returns the number of deposits found.
+    */
+    size_t mixer_match_leaves(const char **in_leaves, size_t in_n_leaves, const char **in_secrets, const char **in_wallet_addresses, size_t in_count, long *out_offsets);
+
+    /**
+    * Native incremental merkle tree of MIXER_TREE_DEPTH levels, computes the
+    * same roots and paths as MerkleTree.sol. Leaves are decimal strings.
+    */
+    typedef struct mixer_tree mixer_tree;
+
+    mixer_tree *mixer_tree_new(void);
+
+    /**
+    * Opens or creates a tree persisted in a memory mapped file, every append
+    * is synced to disk before it returns. Read-only trees can't be appended to,
+    * their size, root and paths follow the appends of the file's writer, of
+    * which there can only be one. Returns NULL if the file isn't a valid tree.
+    */
+    mixer_tree *mixer_tree_open(const char *tree_file, bool writable);
+
+    void mixer_tree_free(mixer_tree *tree);
+
+    /**
+    * Returns the offset of the new leaf, or -1 if the leaf is zero or the tree is full
+    */
+    long mixer_tree_append(mixer_tree *tree, const char *in_leaf);
+
+    /**
+    * Appends in_count leaves at once, hashing each level in parallel.
+    * Nothing is appended if a leaf is zero or they don't fit, returns 0 on success.
+    */
+    int mixer_tree_append_many(mixer_tree *tree, const char **in_leaves, size_t in_count);
+
+    size_t mixer_tree_size(const mixer_tree *tree);
+
+    char *mixer_tree_root(const mixer_tree *tree);
+
+    /**
+    * Fills out_path with MIXER_TREE_DEPTH malloc'd decimal strings and
+    * out_address (MIXER_TREE_DEPTH + 1 chars) with the address bits in the
+    * format expected by mixer_prove. Returns 0 on success.
+    */
+    int mixer_tree_path(const mixer_tree *tree, size_t in_offset, char **out_path, char *out_address);
+
+    /**
+    * Keeps the path of a leaf, which may not have been appended yet, up to
+    * date in memory as leaves are appended. Each append only updates the
+    * siblings which changed, O(depth) per watched leaf. A read-only tree's
+    * leaves are appended by another process, its watched paths are read
+    * again, in full, when one is asked for after the tree has grown.
+    */
+    int mixer_tree_watch(mixer_tree *tree, size_t in_offset);
+
+    int mixer_tree_unwatch(mixer_tree *tree, size_t in_offset);
+
+    /**
+    * Like mixer_tree_path for a watched leaf, returns non-zero if it isn't watched
+    */
+    int mixer_tree_watched_path(const mixer_tree *tree, size_t in_offset, char **out_path, char *out_address);
+
+    /**
+    * Native merkle tree which keeps every version, so paths can be served
+    * against any previous root. Version N is the tree with N leaves.
+    * One thread may append while others query it, without locking.
+    */
+    typedef struct mixer_versioned_tree mixer_versioned_tree;
+
+    mixer_versioned_tree *mixer_versioned_tree_new(void);
+
+    void mixer_versioned_tree_free(mixer_versioned_tree *tree);
+
+    /**
+    * Returns the offset of the new leaf, or -1 if the leaf is zero or the tree is full
+    */
+    long mixer_versioned_tree_append(mixer_versioned_tree *tree, const char *in_leaf);
+
+    /**
+    * Number of leaves, which is also the latest version
+    */
+    size_t mixer_versioned_tree_size(const mixer_versioned_tree *tree);
+
+    char *mixer_versioned_tree_root(const mixer_versioned_tree *tree, size_t in_version);
+
+    /**
+    * Most recent version with the given root, or -1 if there is none
+    */
+    long mixer_versioned_tree_find_root(const mixer_versioned_tree *tree, const char *in_root);
+
+    /**
+    * Like mixer_tree_path, for the root of the given version
+    */
+    int mixer_versioned_tree_path(const mixer_versioned_tree *tree, size_t in_version, size_t in_offset, char **out_path, char *out_address);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,9 +1,15 @@
 // Copyright (c) 2018 HarryR
 // License: GPL-3.0+
 
+#include <atomic>
+#include <chrono>
 #include <cstring>
 #include <iostream> // cerr
 #include <fstream>  // ofstream
+#include <new>
+#include <sstream>  // istringstream
+#include <string>
+#include <vector>
 
 #include "mixer.cpp"
 #include "stubs.hpp"
@@ -12,12 +18,70 @@
 using std::cerr;
 using std::cout;
 using std::endl;
+using std::ifstream;
 using std::ofstream;
 
 using ethsnarks::mod_mixer;
 using ethsnarks::stub_main_genkeys;
 using ethsnarks::stub_main_verify;
 
+// Every allocation made with operator new, or by GMP once bench-prove hooks it
+static std::atomic<size_t> g_heap_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_heap_allocations++;
+    void *ptr = ::malloc((size != 0) ? size : 1);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    g_heap_allocations++;
+    return ::malloc((size != 0) ? size : 1);
+}
+
+void *operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    ::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    ::free(ptr);
+}
+
+static void *gmp_counted_alloc(size_t size)
+{
+    g_heap_allocations++;
+    return ::malloc(size);
+}
+
+static void *gmp_counted_realloc(void *ptr, size_t /* old_size */, size_t new_size)
+{
+    g_heap_allocations++;
+    return ::realloc(ptr, new_size);
+}
+
+static void gmp_counted_free(void *ptr, size_t /* size */)
+{
+    ::free(ptr);
+}
+
 static int main_prove(int argc, char **argv)
 {
     if (argc < (9 + (int)MIXER_TREE_DEPTH))
@@ -60,11 +124,961 @@ static int main_prove(int argc, char **argv)
     return 0;
 }
 
+/**
+* Loads the proving key once, then creates one proof per line of the jobs file.
+* Each line holds the same arguments as the 'prove' command, minus <pk.raw>
+*/
+static int main_prove_many(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " prove-many <pk.raw> [jobs.txt]" << endl;
+        cerr << "Args: " << endl;
+        cerr << "\t<pk.raw>           Path to proving key" << endl;
+        cerr << "\t[jobs.txt]         One job per line, defaults to stdin:" << endl;
+        cerr << "\t                   <proof.json> <root> <wallet> <nullifier> <nullifier-secret> <merkle-address> <merkle-path...>" << endl;
+        return 1;
+    }
+
+    ifstream jobs_file;
+    if (argc > 3)
+    {
+        jobs_file.open(argv[3]);
+        if (!jobs_file.is_open())
+        {
+            cerr << "Error: cannot open " << argv[3] << endl;
+            return 1;
+        }
+    }
+    std::istream &jobs = (argc > 3) ? jobs_file : std::cin;
+
+    auto ctx = mixer_prover_new(argv[2]);
+    if (ctx == nullptr)
+    {
+        return 1;
+    }
+
+    int result = 0;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(jobs, line))
+    {
+        line_no++;
+
+        std::istringstream fields(line);
+        std::vector<std::string> args;
+        std::string field;
+        while (fields >> field)
+        {
+            args.push_back(field);
+        }
+
+        if (args.empty())
+        {
+            continue;
+        }
+
+        if (args.size() != (6 + MIXER_TREE_DEPTH))
+        {
+            cerr << "Error: line " << line_no << " has " << args.size() << " arguments, expected " << (6 + MIXER_TREE_DEPTH) << endl;
+            result = 1;
+            continue;
+        }
+
+        const char *arg_path[MIXER_TREE_DEPTH];
+        for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+        {
+            arg_path[i] = args[6 + i].c_str();
+        }
+
+        auto json = mixer_prover_prove(ctx, args[1].c_str(), args[2].c_str(), args[3].c_str(), args[4].c_str(), args[5].c_str(), arg_path);
+        if (json == nullptr)
+        {
+            cerr << "Error: could not prove line " << line_no << endl;
+            result = 1;
+            continue;
+        }
+
+        ofstream fh;
+        fh.open(args[0], std::ios::binary);
+        fh << json;
+        fh.flush();
+        fh.close();
+        ::free(json);
+    }
+
+    mixer_prover_free(ctx);
+
+    return result;
+}
+
+/**
+* Checks the precomputed MiMC round constants and merkle tree IVs against
+* the ones derived from their seeds and decimal strings, then every batch
+* MiMC kernel supported by this CPU against the witness computed by
+* MiMC_hash_gadget for the same inputs
+*/
+static int main_test_mimc(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using ethsnarks::MiMC_gadget;
+    using ethsnarks::MiMC_hash_gadget;
+    using ethsnarks::ProtoboardT;
+    using ethsnarks::VariableArrayT;
+    using namespace ethsnarks::native;
+
+    const size_t n_hashes = (argc > 2) ? ::atoi(argv[2]) : 37;
+
+    ethsnarks::ppT::init_public_params();
+
+    int result = 0;
+
+    const bool constants_ok = (MiMC_gadget::static_constants() == MiMC_gadget::constants());
+    cout << "constants: " << (constants_ok ? "OK" : "FAIL") << endl;
+
+    ProtoboardT IVs_pb;
+    const auto IVs_vars = ethsnarks::merkle_tree_IVs(IVs_pb);
+    const auto &IVs = merkle_tree_level_IVs();
+    bool IVs_ok = (IVs.size() <= IVs_vars.size());
+    for (size_t i = 0; IVs_ok && i < IVs.size(); i++)
+    {
+        IVs_ok = (IVs[i] == IVs_pb.val(IVs_vars[i]));
+    }
+    cout << "IVs: " << (IVs_ok ? "OK" : "FAIL") << endl;
+
+    if (!constants_ok || !IVs_ok)
+    {
+        result = 1;
+    }
+
+    std::vector<FieldT> msgs(n_hashes * 2);
+    std::vector<FieldT> keys(n_hashes);
+    std::vector<FieldT> expected(n_hashes);
+    for (size_t i = 0; i < n_hashes; i++)
+    {
+        msgs[2 * i] = FieldT::random_element();
+        msgs[(2 * i) + 1] = FieldT::random_element();
+        keys[i] = FieldT::random_element();
+
+        ProtoboardT pb;
+        VariableArrayT in_msgs;
+        in_msgs.push_back(ethsnarks::make_variable(pb, msgs[2 * i], "m0"));
+        in_msgs.push_back(ethsnarks::make_variable(pb, msgs[(2 * i) + 1], "m1"));
+        const auto in_key = ethsnarks::make_variable(pb, keys[i], "k");
+        MiMC_hash_gadget the_gadget(pb, in_key, in_msgs, "the_gadget");
+        the_gadget.generate_r1cs_witness();
+        expected[i] = pb.val(the_gadget.result());
+    }
+
+    for (auto kernel : {MIMC_KERNEL_SCALAR, MIMC_KERNEL_AVX2, MIMC_KERNEL_AVX512_IFMA})
+    {
+        if (!mimc_batch_kernel_supported(kernel))
+        {
+            cout << mimc_batch_kernel_name(kernel) << ": not supported" << endl;
+            continue;
+        }
+
+        MiMCe7_batch batch(MiMC_gadget::static_constants(), kernel);
+        std::vector<FieldT> hashes(n_hashes);
+        batch.hash(msgs.data(), 2, keys.data(), 1, hashes.data(), n_hashes);
+
+        const bool ok = (hashes == expected);
+        cout << mimc_batch_kernel_name(kernel) << ": " << (ok ? "OK" : "FAIL") << endl;
+        if (!ok)
+        {
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+/**
+* Checks the native witness of the leaf hash, with every SHA256 kernel
+* supported by this CPU, against the witness from libsnark's gadgets, and
+* the multi-buffer leaf hashes against the gadget's result
+*/
+static int main_test_sha256(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using ethsnarks::ProtoboardT;
+    using ethsnarks::Sha256EthFields;
+    using namespace ethsnarks::native;
+
+    const size_t n_hashes = (argc > 2) ? ::atoi(argv[2]) : 10;
+
+    ethsnarks::ppT::init_public_params();
+
+    ProtoboardT native_pb;
+    const auto native_left = ethsnarks::make_variable(native_pb, "left");
+    const auto native_right = ethsnarks::make_variable(native_pb, "right");
+    Sha256EthFields native_gadget(native_pb, native_left, native_right, "native_gadget");
+    native_gadget.generate_r1cs_constraints();
+
+    ProtoboardT expected_pb;
+    const auto expected_left = ethsnarks::make_variable(expected_pb, "left");
+    const auto expected_right = ethsnarks::make_variable(expected_pb, "right");
+    Sha256EthFields expected_gadget(expected_pb, expected_left, expected_right, "expected_gadget");
+
+    if (!native_gadget.native_witness)
+    {
+        cerr << "Error: the SHA256 gadgets' variables aren't laid out as the native witness expects" << endl;
+        return 1;
+    }
+
+    int result = 0;
+    for (auto kernel : {SHA256_KERNEL_SCALAR, SHA256_KERNEL_SHANI})
+    {
+        if (!sha256_kernel_supported(kernel))
+        {
+            cout << sha256_kernel_name(kernel) << ": not supported" << endl;
+            continue;
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < n_hashes; i++)
+        {
+            const FieldT left = FieldT::random_element();
+            const FieldT right = FieldT::random_element();
+
+            native_pb.val(native_left) = left;
+            native_pb.val(native_right) = right;
+            native_gadget.generate_r1cs_witness(kernel);
+
+            expected_pb.val(expected_left) = left;
+            expected_pb.val(expected_right) = right;
+            expected_gadget.generate_r1cs_witness_gadgets();
+
+            ok = ok && native_pb.full_variable_assignment() == expected_pb.full_variable_assignment() && native_pb.is_satisfied();
+        }
+
+        cout << sha256_kernel_name(kernel) << ": " << (ok ? "OK" : "FAIL") << endl;
+        if (!ok)
+        {
+            result = 1;
+        }
+    }
+
+    std::vector<FieldT> secrets(n_hashes);
+    std::vector<FieldT> wallet_addresses(n_hashes);
+    std::vector<FieldT> expected(n_hashes);
+    for (size_t i = 0; i < n_hashes; i++)
+    {
+        secrets[i] = FieldT::random_element();
+        wallet_addresses[i] = FieldT::random_element();
+        expected_pb.val(expected_left) = secrets[i];
+        expected_pb.val(expected_right) = wallet_addresses[i];
+        expected_gadget.generate_r1cs_witness_gadgets();
+        expected[i] = expected_pb.val(expected_gadget.result());
+    }
+
+    for (auto kernel : {SHA256_BATCH_KERNEL_SINGLE, SHA256_BATCH_KERNEL_AVX2, SHA256_BATCH_KERNEL_AVX512})
+    {
+        if (!sha256_batch_kernel_supported(kernel))
+        {
+            cout << "batch " << sha256_batch_kernel_name(kernel) << ": not supported" << endl;
+            continue;
+        }
+
+        std::vector<FieldT> leaves(n_hashes);
+        leaf_hash_batch(secrets.data(), wallet_addresses.data(), leaves.data(), n_hashes, kernel);
+
+        const bool ok = (leaves == expected);
+        cout << "batch " << sha256_batch_kernel_name(kernel) << ": " << (ok ? "OK" : "FAIL") << endl;
+        if (!ok)
+        {
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+/**
+* Operations on a merkle tree persisted to a file, which is created if it doesn't exist
+*/
+static int main_tree(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        cerr << "Usage: " << argv[0] << " tree <tree.bin> <append|root|size|path> [...]" << endl;
+        cerr << "Commands: " << endl;
+        cerr << "\tappend <leaf...>   Append leaves, prints the offset of each" << endl;
+        cerr << "\troot               Print the merkle root" << endl;
+        cerr << "\tsize               Print the number of leaves" << endl;
+        cerr << "\tpath <offset>      Print the <merkle-address> <merkle-path...> arguments for 'prove'" << endl;
+        return 1;
+    }
+
+    const auto tree_filename = argv[2];
+    const auto command = argv[3];
+    const bool writable = (0 == ::strcmp(command, "append"));
+
+    auto tree = mixer_tree_open(tree_filename, writable);
+    if (tree == nullptr)
+    {
+        return 2;
+    }
+
+    int result = 0;
+    if (0 == ::strcmp(command, "append"))
+    {
+        std::vector<const char *> leaves(argv + 4, argv + argc);
+        const size_t first = mixer_tree_size(tree);
+        if (0 != mixer_tree_append_many(tree, leaves.data(), leaves.size()))
+        {
+            result = 3;
+        }
+        else
+        {
+            for (size_t i = 0; i < leaves.size(); i++)
+            {
+                cout << (first + i) << endl;
+            }
+        }
+    }
+    else if (0 == ::strcmp(command, "root"))
+    {
+        auto root = mixer_tree_root(tree);
+        cout << root << endl;
+        ::free(root);
+    }
+    else if (0 == ::strcmp(command, "size"))
+    {
+        cout << mixer_tree_size(tree) << endl;
+    }
+    else if (0 == ::strcmp(command, "path") && argc > 4)
+    {
+        char *path[MIXER_TREE_DEPTH];
+        char address[MIXER_TREE_DEPTH + 1];
+        if (0 != mixer_tree_path(tree, ::strtoul(argv[4], nullptr, 10), path, address))
+        {
+            result = 3;
+        }
+        else
+        {
+            cout << address;
+            for (size_t i = 0; i < MIXER_TREE_DEPTH; i++)
+            {
+                cout << " " << path[i];
+                ::free(path[i]);
+            }
+            cout << endl;
+        }
+    }
+    else
+    {
+        cerr << "Error: unknown tree command " << command << endl;
+        result = 1;
+    }
+
+    mixer_tree_free(tree);
+    return result;
+}
+
+/**
+* Rebuilds a tree from scratch with the bulk append, and compares the root
+* with one built a leaf at a time
+*/
+static int main_bench_tree(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using ethsnarks::native::MerkleTree;
+
+    const size_t n_leaves = (argc > 2) ? ::atoi(argv[2]) : (size_t(1) << MIXER_TREE_DEPTH);
+    const size_t n_threads = (argc > 3) ? ::atoi(argv[3]) : 0;
+    if (n_leaves == 0 || n_leaves > (size_t(1) << MIXER_TREE_DEPTH))
+    {
+        cerr << "Usage: " << argv[0] << " bench-tree [n-leaves] [n-threads]" << endl;
+        return 1;
+    }
+
+    ethsnarks::ppT::init_public_params();
+
+    std::vector<FieldT> leaves(n_leaves);
+    for (auto &leaf : leaves)
+    {
+        leaf = FieldT::random_element();
+    }
+
+    MerkleTree bulk_tree(MIXER_TREE_DEPTH);
+    std::vector<double> level_seconds;
+    const auto bulk_start = std::chrono::steady_clock::now();
+    bulk_tree.append_many(leaves.data(), leaves.size(), n_threads, &level_seconds);
+    const std::chrono::duration<double> bulk_elapsed = std::chrono::steady_clock::now() - bulk_start;
+
+    for (size_t level = 0; level < level_seconds.size(); level++)
+    {
+        cout << "level " << level << ": " << (level_seconds[level] * 1000) << " ms" << endl;
+    }
+    cout << "bulk: " << (bulk_elapsed.count() * 1000) << " ms (" << ethsnarks::native::mimc_batch_kernel_name(ethsnarks::native::MiMCe7_batch::default_instance().kernel()) << ")" << endl;
+
+    MerkleTree tree(MIXER_TREE_DEPTH);
+    const auto append_start = std::chrono::steady_clock::now();
+    for (const auto &leaf : leaves)
+    {
+        tree.append(leaf);
+    }
+    const std::chrono::duration<double> append_elapsed = std::chrono::steady_clock::now() - append_start;
+    cout << "append: " << (append_elapsed.count() * 1000) << " ms" << endl;
+
+    if (!(tree.root() == bulk_tree.root()))
+    {
+        cerr << "Error: roots differ" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Builds the fixed-base tables for a proving key and saves them beside it
+*/
+static int main_precompute(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " precompute <pk.raw> [window] [max-rows]" << endl;
+        cerr << "Args: " << endl;
+        cerr << "\t<pk.raw>           Path to proving key, tables are saved to <pk.raw>.tables" << endl;
+        cerr << "\t[window]           Bits per scalar digit, defaults to 16" << endl;
+        cerr << "\t[max-rows]         Multiples stored per base, defaults to one per digit" << endl;
+        return 1;
+    }
+
+    const size_t window = (argc > 3) ? ::atoi(argv[3]) : 16;
+    const size_t max_rows = (argc > 4) ? ::atoi(argv[4]) : 0;
+
+    return mixer_precompute(argv[2], window, max_rows);
+}
+
+/**
+* Witness for a withdrawal of a random leaf from a tree of random leaves,
+* which satisfies the circuit
+*/
+static void bench_witness(mixer_prover *ctx, size_t n_leaves)
+{
+    using ethsnarks::FieldT;
+
+    const FieldT wallet_address = FieldT::random_element();
+    const FieldT nullifier_secret = FieldT::random_element();
+    libff::bit_vector address(MIXER_TREE_DEPTH);
+    std::vector<FieldT> path(MIXER_TREE_DEPTH);
+
+    // The leaf and nullifier only depend on the secret and wallet
+    ctx->mod.generate_r1cs_witness(FieldT::zero(), wallet_address, FieldT::zero(), nullifier_secret, address, path);
+    const FieldT leaf = ctx->pb.val(ctx->mod.leaf_hash.result());
+    const FieldT nullifier = ctx->pb.val(ctx->mod.nullifier_hash.result());
+
+    ethsnarks::native::MerkleTree tree(MIXER_TREE_DEPTH);
+    std::vector<FieldT> leaves(n_leaves);
+    for (auto &other_leaf : leaves)
+    {
+        other_leaf = FieldT::random_element();
+    }
+    tree.append_many(leaves.data(), leaves.size());
+    tree.append(leaf);
+    tree.path(n_leaves, path, address);
+
+    ctx->mod.generate_r1cs_witness(tree.root(), wallet_address, nullifier, nullifier_secret, address, path);
+}
+
+/**
+* Times the prover's multi-scalar multiplications for a mixer witness with
+* libff's multi-exponentiation, the batch-affine bucket method without and
+* with the endomorphism and, unless the window is 0, fixed-base tables.
+* Checks they all give the same points.
+*/
+static int main_bench_msm(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using ethsnarks::prover::Groth16Prover;
+
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " bench-msm <pk.raw> [window] [max-rows]" << endl;
+        cerr << "Args: " << endl;
+        cerr << "\t<pk.raw>           Path to proving key" << endl;
+        cerr << "\t[window]           Window of the fixed-base tables, defaults to 16, 0 to skip them" << endl;
+        cerr << "\t[max-rows]         Multiples stored per base, defaults to one per digit" << endl;
+        return 1;
+    }
+
+    const size_t window = (argc > 3) ? ::atoi(argv[3]) : 16;
+    const size_t max_rows = (argc > 4) ? ::atoi(argv[4]) : 0;
+
+    auto ctx = mixer_prover_new(argv[2]);
+    if (ctx == nullptr)
+    {
+        return 2;
+    }
+    auto &prover = ctx->prover;
+
+    bench_witness(ctx, 1000);
+    const auto primary_input = ctx->pb.primary_input();
+    const auto auxiliary_input = ctx->pb.auxiliary_input();
+    const auto qap_wit = libsnark::r1cs_to_qap_witness_map(ctx->proving_key.constraint_system, primary_input, auxiliary_input, FieldT::zero(), FieldT::zero(), FieldT::zero());
+    std::vector<FieldT> padded_assignment(1, FieldT::one());
+    padded_assignment.insert(padded_assignment.end(), qap_wit.coefficients_for_ABCs.begin(), qap_wit.coefficients_for_ABCs.end());
+
+    ethsnarks::prover::Witness padded_witness;
+    padded_witness.assign(padded_assignment);
+    cout << "Assignment: " << padded_witness.size() << " scalars, " << padded_witness.ones().size() << " ones, " << padded_witness.others().size() << " others" << endl;
+    cout << "A: " << ctx->proving_key.A_query.size() << ", B: " << ctx->proving_key.B_query.values.size() << ", H: " << ctx->proving_key.H_query.size() << ", L: " << ctx->proving_key.L_query.size() << " bases, " << prover.n_threads() << " threads" << endl;
+
+    std::vector<ethsnarks::prover::G1T> results;
+    Groth16Prover::KnowledgeCommitmentT B_result;
+    auto run = [&](const char *label, bool check) -> bool {
+        std::vector<ethsnarks::prover::G1T> points;
+        std::vector<double> seconds;
+        auto start = std::chrono::steady_clock::now();
+        auto lap = [&start, &seconds]() {
+            const auto now = std::chrono::steady_clock::now();
+            seconds.push_back(std::chrono::duration<double>(now - start).count());
+            start = now;
+        };
+
+        points.push_back(prover.evaluate_A(padded_assignment));
+        lap();
+        const auto B = prover.evaluate_B(padded_assignment);
+        lap();
+        points.push_back(prover.evaluate_H(qap_wit.coefficients_for_H, qap_wit.degree()));
+        lap();
+        points.push_back(prover.evaluate_L(padded_assignment, qap_wit.num_inputs()));
+        lap();
+
+        cout << label << ": A " << (seconds[0] * 1000) << " ms, B " << (seconds[1] * 1000) << " ms, H " << (seconds[2] * 1000) << " ms, L " << (seconds[3] * 1000) << " ms" << endl;
+
+        if (!check)
+        {
+            results = points;
+            B_result = B;
+            return true;
+        }
+        return points == results && B.g == B_result.g && B.h == B_result.h;
+    };
+
+    prover.use_method(ethsnarks::prover::MULTI_EXP_LIBFF);
+    run("libff", false);
+
+    prover.use_method(ethsnarks::prover::MULTI_EXP_PIPPENGER);
+    prover.use_endomorphism(false);
+    bool ok = run("pippenger", true);
+    prover.use_endomorphism(true);
+    ok = run("pippenger+glv", true) && ok;
+
+    {
+        ethsnarks::prover::G1T A;
+        Groth16Prover::KnowledgeCommitmentT B;
+        const auto fused_start = std::chrono::steady_clock::now();
+        prover.evaluate_AB(padded_witness, A, B);
+        const std::chrono::duration<double> fused_elapsed = std::chrono::steady_clock::now() - fused_start;
+        cout << "fused A and B: " << (fused_elapsed.count() * 1000) << " ms" << endl;
+        ok = ok && A == results[0] && B.g == B_result.g && B.h == B_result.h;
+    }
+
+    if (window != 0)
+    {
+        const auto precompute_start = std::chrono::steady_clock::now();
+        const size_t memory_size = mixer_prover_precompute(ctx, window, max_rows);
+        const std::chrono::duration<double> precompute_elapsed = std::chrono::steady_clock::now() - precompute_start;
+        cout << "precompute: " << (precompute_elapsed.count() * 1000) << " ms, " << (memory_size >> 20) << " MiB (window " << window << ")" << endl;
+
+        prover.use_method(ethsnarks::prover::MULTI_EXP_AUTO);
+        ok = run("tables", true) && ok;
+    }
+    mixer_prover_free(ctx);
+
+    if (!ok)
+    {
+        cerr << "Error: results differ" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Times libsnark's QAP witness map against the prover's, which transforms
+* with tables made when the proving key is loaded, and checks they give
+* the same coefficients of H
+*/
+static int main_bench_fft(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " bench-fft <pk.raw>" << endl;
+        cerr << "Args: " << endl;
+        cerr << "\t<pk.raw>           Path to proving key" << endl;
+        return 1;
+    }
+
+    auto ctx = mixer_prover_new(argv[2]);
+    if (ctx == nullptr)
+    {
+        return 2;
+    }
+
+    const auto &qap = ctx->prover.qap();
+    if (!qap.supported())
+    {
+        cerr << "Error: the prover uses libsnark's witness map for this evaluation domain" << endl;
+        mixer_prover_free(ctx);
+        return 1;
+    }
+    cout << "Domain: " << qap.degree() << " points (" << qap.big_size() << " + " << qap.small_size() << "), " << ctx->prover.n_threads() << " threads" << endl;
+
+    bench_witness(ctx, 1000);
+    const auto primary_input = ctx->pb.primary_input();
+    const auto auxiliary_input = ctx->pb.auxiliary_input();
+
+    auto start = std::chrono::steady_clock::now();
+    const auto qap_wit = libsnark::r1cs_to_qap_witness_map(ctx->proving_key.constraint_system, primary_input, auxiliary_input, FieldT::zero(), FieldT::zero(), FieldT::zero());
+    const std::chrono::duration<double> libsnark_elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<FieldT> padded_assignment(1, FieldT::one());
+    padded_assignment.insert(padded_assignment.end(), primary_input.begin(), primary_input.end());
+    padded_assignment.insert(padded_assignment.end(), auxiliary_input.begin(), auxiliary_input.end());
+    std::vector<FieldT> coefficients_for_H;
+    double fft_seconds = 0;
+    start = std::chrono::steady_clock::now();
+    qap.coefficients_for_H(padded_assignment, coefficients_for_H, &fft_seconds);
+    const std::chrono::duration<double> prover_elapsed = std::chrono::steady_clock::now() - start;
+
+    cout << "libsnark: " << (libsnark_elapsed.count() * 1000) << " ms" << endl;
+    cout << "prover: " << (prover_elapsed.count() * 1000) << " ms, " << (fft_seconds * 1000) << " ms in transforms" << endl;
+
+    const bool ok = qap_wit.degree() == qap.degree() && qap_wit.coefficients_for_H == coefficients_for_H;
+    mixer_prover_free(ctx);
+
+    if (!ok)
+    {
+        cerr << "Error: results differ" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Times proofs whose phases run one after the other, as they used to,
+* pipelined proofs, whose multi-scalar multiplications start while the
+* witness is generated, and a batch of proofs. Checks they all give the
+* same sums, and that once the context's buffers are sized the prover
+* itself makes no heap allocations. Those of a whole proof, which include
+* the witness generated by the circuit's gadgets, are reported.
+*/
+static int main_bench_prove(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " bench-prove <pk.raw> [n-proofs]" << endl;
+        cerr << "Args: " << endl;
+        cerr << "\t<pk.raw>           Path to proving key" << endl;
+        cerr << "\t[n-proofs]         Proofs of each kind, defaults to 5" << endl;
+        return 1;
+    }
+
+    const size_t n_proofs = std::max(1, (argc > 3) ? ::atoi(argv[3]) : 5);
+
+    // GMP's default functions are malloc's, which these call
+    ::mp_set_memory_functions(gmp_counted_alloc, gmp_counted_realloc, gmp_counted_free);
+
+    auto ctx = mixer_prover_new(argv[2]);
+    if (ctx == nullptr)
+    {
+        return 2;
+    }
+    cout << ctx->prover.n_threads() << " threads" << endl;
+
+    // The arguments of a valid proof, as they're given to mixer_prover_prove
+    bench_witness(ctx, 1000);
+    const auto &mod = ctx->mod;
+    char *root = mixer_field_to_cstr(ctx->pb.val(mod.root_var));
+    char *wallet_address = mixer_field_to_cstr(ctx->pb.val(mod.wallet_address_var));
+    char *nullifier = mixer_field_to_cstr(ctx->pb.val(mod.nullifier_var));
+    char *nullifier_secret = mixer_field_to_cstr(ctx->pb.val(mod.nullifier_secret_var));
+    std::vector<char *> path(MIXER_TREE_DEPTH);
+    std::vector<char> address(MIXER_TREE_DEPTH + 1);
+    mixer_path_to_cstrs(mod.path_var.get_vals(ctx->pb), mod.address_bits.get_bits(ctx->pb), path.data(), address.data());
+
+    bool ok = true;
+    ethsnarks::prover::ProvedAssignment sequential;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_proofs; i++)
+    {
+        ok = ok && mixer_prover_witness(ctx, root, wallet_address, nullifier, nullifier_secret, address.data(), (const char **)path.data());
+        ctx->prover.prove(ctx->pb.primary_input(), ctx->pb.auxiliary_input(), ethsnarks::prover::PartialSums::zero(), std::vector<bool>(), nullptr, &sequential);
+    }
+    const std::chrono::duration<double> sequential_elapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_proofs; i++)
+    {
+        char *json = mixer_prover_prove(ctx, root, wallet_address, nullifier, nullifier_secret, address.data(), (const char **)path.data());
+        ok = ok && json != nullptr;
+        ::free(json);
+    }
+    const std::chrono::duration<double> pipelined_elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto same_sums = [&sequential](const ethsnarks::prover::ProvedAssignment &proved) {
+        return proved.padded_assignment == sequential.padded_assignment && proved.sums.A == sequential.sums.A && proved.sums.B.g == sequential.sums.B.g && proved.sums.B.h == sequential.sums.B.h && proved.sums.L == sequential.sums.L;
+    };
+    ok = ok && same_sums(ctx->last_proof);
+
+    // The pipelined proofs sized the context's buffers, the batch shouldn't grow them
+    size_t growths = 0;
+    size_t bytes = 0;
+    mixer_prover_buffer_growth(ctx, &growths, &bytes, nullptr);
+
+    // A whole proof, then the prover alone on the witness it left
+    size_t heap_before = g_heap_allocations.load();
+    char *json = mixer_prover_prove(ctx, root, wallet_address, nullifier, nullifier_secret, address.data(), (const char **)path.data());
+    const size_t proof_heap = g_heap_allocations.load() - heap_before;
+    ok = ok && json != nullptr;
+    ::free(json);
+
+    ethsnarks::prover::Groth16Prover::ProofT prover_proof;
+    heap_before = g_heap_allocations.load();
+    const bool proved = ctx->prover.prove_pipelined(
+        mixer_padded_assignment(ctx->pb), ctx->pb.num_inputs(), ctx->deposit_variables,
+        []() -> bool { return true; },
+        []() -> bool { return true; },
+        prover_proof, &ctx->last_proof, &ctx->arena);
+    const size_t prover_heap = g_heap_allocations.load() - heap_before;
+    ok = ok && proved;
+
+    ctx->prover.reprove(ctx->last_proof, mixer_padded_assignment(ctx->pb), ctx->pb.num_inputs(), nullptr, &ctx->last_proof, &ctx->arena);
+    heap_before = g_heap_allocations.load();
+    ctx->prover.reprove(ctx->last_proof, mixer_padded_assignment(ctx->pb), ctx->pb.num_inputs(), nullptr, &ctx->last_proof, &ctx->arena);
+    const size_t reprove_heap = g_heap_allocations.load() - heap_before;
+
+    // The same withdrawal n_proofs times
+    std::vector<const char *> roots(n_proofs, root);
+    std::vector<const char *> wallet_addresses(n_proofs, wallet_address);
+    std::vector<const char *> nullifiers(n_proofs, nullifier);
+    std::vector<const char *> nullifier_secrets(n_proofs, nullifier_secret);
+    std::vector<const char *> addresses(n_proofs, address.data());
+    std::vector<const char *> paths;
+    for (size_t i = 0; i < n_proofs; i++)
+    {
+        paths.insert(paths.end(), path.begin(), path.end());
+    }
+    std::vector<char *> proofs(n_proofs);
+
+    start = std::chrono::steady_clock::now();
+    const size_t n_batch_proofs = mixer_prover_prove_batch(ctx, n_proofs, roots.data(), wallet_addresses.data(), nullifiers.data(),
+                                                           nullifier_secrets.data(), addresses.data(), paths.data(), proofs.data());
+    const std::chrono::duration<double> batch_elapsed = std::chrono::steady_clock::now() - start;
+    ok = ok && n_batch_proofs == n_proofs && same_sums(ctx->last_proof);
+    for (auto proof : proofs)
+    {
+        ::free(proof);
+    }
+
+    size_t batch_growths = 0;
+    size_t threads = 0;
+    mixer_prover_buffer_growth(ctx, &batch_growths, nullptr, &threads);
+
+    cout << "sequential: " << (sequential_elapsed.count() * 1000 / n_proofs) << " ms per proof, " << (n_proofs / sequential_elapsed.count()) << " proofs/s" << endl;
+    cout << "pipelined: " << (pipelined_elapsed.count() * 1000 / n_proofs) << " ms per proof, " << (n_proofs / pipelined_elapsed.count()) << " proofs/s" << endl;
+    cout << "batch: " << (batch_elapsed.count() * 1000 / n_proofs) << " ms per proof, " << (n_proofs / batch_elapsed.count()) << " proofs/s" << endl;
+    cout << "buffers: grown " << growths << " times to " << bytes << " bytes, " << (batch_growths - growths) << " times during the batch, " << threads << " worker threads" << endl;
+    cout << "heap: " << proof_heap << " allocations per proof, " << prover_heap << " by the prover, " << reprove_heap << " by reprove" << endl;
+
+    ::free(root);
+    ::free(wallet_address);
+    ::free(nullifier);
+    ::free(nullifier_secret);
+    for (auto node : path)
+    {
+        ::free(node);
+    }
+    mixer_prover_free(ctx);
+
+    if (!ok)
+    {
+        cerr << "Error: results differ" << endl;
+        return 1;
+    }
+    if (prover_heap != 0 || reprove_heap != 0 || batch_growths != growths)
+    {
+        cerr << "Error: the prover allocated once its buffers were sized" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+* Reports the mixer circuit's size at each tree depth: its constraints and
+* variables, and the evaluation domain libsnark's key generator picks for
+* them, which the prover's witness map also uses
+*/
+static int main_constraints(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using ethsnarks::ProtoboardT;
+
+    ethsnarks::ppT::init_public_params();
+
+    ProtoboardT IVs_pb;
+    const size_t max_depth = ethsnarks::merkle_tree_IVs(IVs_pb).size();
+
+    std::vector<size_t> depths;
+    for (int i = 2; i < argc; i++)
+    {
+        depths.push_back(::atoi(argv[i]));
+        if (depths.back() == 0 || depths.back() > max_depth)
+        {
+            cerr << "Usage: " << argv[0] << " constraints [depth...]" << endl;
+            cerr << "Args: " << endl;
+            cerr << "\t[depth...]         Merkle tree depths from 1 to " << max_depth << ", defaults to " << MIXER_TREE_DEPTH << endl;
+            return 1;
+        }
+    }
+    if (depths.empty())
+    {
+        depths.push_back(MIXER_TREE_DEPTH);
+    }
+
+    for (const size_t depth : depths)
+    {
+        ProtoboardT pb;
+        mod_mixer mod(pb, "module", depth);
+        mod.generate_r1cs_constraints();
+
+        // libsnark adds a constraint per input, and one for the constant
+        const size_t min_size = pb.num_constraints() + pb.num_inputs() + 1;
+        const auto domain = libfqfft::get_evaluation_domain<FieldT>(min_size);
+        const auto step = std::dynamic_pointer_cast<libfqfft::step_radix2_domain<FieldT>>(domain);
+        size_t power_of_two = 1;
+        while (power_of_two < min_size)
+        {
+            power_of_two <<= 1;
+        }
+
+        cout << "Depth " << depth << ": " << pb.num_constraints() << " constraints, " << pb.num_variables() << " variables, " << pb.num_inputs() << " inputs" << endl;
+        cout << "\tdomain: " << domain->m << " points";
+        if (step)
+        {
+            cout << " (step radix-2, " << step->big_m << " + " << step->small_m << ")";
+        }
+        else if (std::dynamic_pointer_cast<libfqfft::basic_radix2_domain<FieldT>>(domain))
+        {
+            cout << " (radix-2)";
+        }
+        cout << " for " << min_size << ", " << (100.0 * (domain->m - min_size) / min_size) << "% padding, " << power_of_two << " if a power of two" << endl;
+    }
+
+    return 0;
+}
+
+/**
+* Times the prover's curve arithmetic over random G1 points, with and
+* without the GLV endomorphism: the bucket method, fixed-base tables and
+* the constant time scalar multiplication against libff's
+*/
+static int main_bench_curve(int argc, char **argv)
+{
+    using ethsnarks::FieldT;
+    using namespace ethsnarks::prover;
+
+    const size_t n = (argc > 2) ? ::atoi(argv[2]) : 65536;
+    const size_t window = (argc > 3) ? ::atoi(argv[3]) : 12;
+    if (n == 0 || window < 2 || window > 24)
+    {
+        cerr << "Usage: " << argv[0] << " bench-curve [n-points] [table-window]" << endl;
+        return 1;
+    }
+
+    ethsnarks::ppT::init_public_params();
+
+    // Consecutive multiples of a random point, much cheaper than a scalar multiplication each
+    std::vector<G1T> points(n);
+    const G1T step = FieldT::random_element() * G1T::one();
+    points[0] = step;
+    for (size_t i = 1; i < n; i++)
+    {
+        points[i] = points[i - 1] + step;
+    }
+    std::vector<AffinePoint<FqT>> bases;
+    to_affine(points, bases);
+
+    std::vector<FieldT> values(n);
+    for (auto &value : values)
+    {
+        value = FieldT::random_element();
+    }
+    Witness witness;
+    witness.assign(values);
+    const auto &others = witness.others();
+
+    const size_t n_threads = default_threads();
+    auto milliseconds_since = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    bool ok = true;
+    G1T expected;
+    for (int use_endomorphism = 0; use_endomorphism < 2; use_endomorphism++)
+    {
+        const char *label = use_endomorphism ? "glv" : "plain";
+
+        auto start = std::chrono::steady_clock::now();
+        const G1T msm = to_libff(pippenger_msm(bases.data(), witness.scalars(), others.data(), others.size(), n_threads, use_endomorphism != 0));
+        cout << label << " pippenger: " << milliseconds_since(start) << " ms" << endl;
+
+        start = std::chrono::steady_clock::now();
+        FixedBaseTable<FqT> table;
+        table.build(bases, window, 0, n_threads, use_endomorphism != 0);
+        cout << label << " table build: " << milliseconds_since(start) << " ms, " << (table.memory_size() >> 20) << " MiB" << endl;
+
+        start = std::chrono::steady_clock::now();
+        const G1T fixed_base = to_libff(table.multi_exp(witness.scalars(), others.data(), others.size(), n_threads));
+        cout << label << " table msm: " << milliseconds_since(start) << " ms" << endl;
+
+        if (!use_endomorphism)
+        {
+            expected = msm;
+        }
+        ok = ok && msm == expected && fixed_base == expected;
+    }
+
+    const size_t n_multiplications = std::min(n, size_t(256));
+    std::vector<G1T> libff_products(n_multiplications);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_multiplications; i++)
+    {
+        libff_products[i] = values[i] * points[i];
+    }
+    cout << "libff mul: " << (milliseconds_since(start) * 1000 / n_multiplications) << " us" << endl;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_multiplications; i++)
+    {
+        ok = ok && to_libff(ct_mul(from_libff(points[i]), witness.scalars()[i])) == libff_products[i];
+    }
+    cout << "ct_mul: " << (milliseconds_since(start) * 1000 / n_multiplications) << " us" << endl;
+
+    if (!ok)
+    {
+        cerr << "Error: results differ" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     if (argc < 2)
     {
-        cerr << "Usage: " << argv[0] << " <genkeys|prove|verify> [...]" << endl;
+        cerr << "Usage: " << argv[0] << " <genkeys|precompute|prove|prove-many|verify|tree|test-mimc|test-sha256|constraints|bench-tree|bench-msm|bench-fft|bench-prove|bench-curve> [...]" << endl;
         return 1;
     }
 
@@ -72,9 +1086,58 @@ int main(int argc, char **argv)
     {
         return main_prove(argc, argv);
     }
+    else if (0 == ::strcmp(argv[1], "prove-many"))
+    {
+        return main_prove_many(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "test-mimc"))
+    {
+        return main_test_mimc(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "test-sha256"))
+    {
+        return main_test_sha256(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "tree"))
+    {
+        return main_tree(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "constraints"))
+    {
+        return main_constraints(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "bench-tree"))
+    {
+        return main_bench_tree(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "precompute"))
+    {
+        return main_precompute(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "bench-msm"))
+    {
+        return main_bench_msm(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "bench-fft"))
+    {
+        return main_bench_fft(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "bench-prove"))
+    {
+        return main_bench_prove(argc, argv);
+    }
+    else if (0 == ::strcmp(argv[1], "bench-curve"))
+    {
+        return main_bench_curve(argc, argv);
+    }
     else if (0 == ::strcmp(argv[1], "genkeys"))
     {
-        return stub_main_genkeys<mod_mixer>(argv[0], argc - 1, &argv[1]);
+        if (argc < 4)
+        {
+            // Prints usage
+            return stub_main_genkeys<mod_mixer>(argv[0], argc - 1, &argv[1]);
+        }
+        return mixer_genkeys(argv[2], argv[3]);
     }
     else if (0 == ::strcmp(argv[1], "verify"))
     {
@@ -0,0 +1,132 @@
+#ifndef MIXER_NATIVE_LEAF_BATCH_HPP_
+#define MIXER_NATIVE_LEAF_BATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+#include "native/mimc_batch.hpp"
+#include "native/sha256_batch.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* The leaves and nullifiers of many deposits at once, as a wallet which
+* restores its state from the `LeafAdded` events needs them:
+*
+*   leaf      = sha256(secret, wallet_address) & (2^252 - 1), as `Mixer.makeLeafHash`
+*   nullifier = MiMC_hash([secret, secret], 0), as `Mixer.makeNullifierHash`
+*
+* The SHA256s use the multi-buffer kernels, the MiMCs the batch kernels.
+*/
+
+/**
+* The 8 big-endian words of a field element as a 256 bit integer
+*/
+inline void leaf_field_to_words(const FieldT &value, uint32_t out[8])
+{
+    const auto bigint = value.as_bigint();
+    for (size_t i = 0; i < 4; i++)
+    {
+        const uint64_t limb = bigint.data[3 - i];
+        out[2 * i] = uint32_t(limb >> 32);
+        out[(2 * i) + 1] = uint32_t(limb);
+    }
+}
+
+/**
+* A digest with its top 4 bits cleared, so it's below the field's modulus
+*/
+inline FieldT leaf_from_digest(const uint32_t digest[8])
+{
+    libff::bigint<FieldT::num_limbs> bigint;
+    for (size_t i = 0; i < 4; i++)
+    {
+        const uint32_t high = (i == 0) ? (digest[0] & 0x0FFFFFFF) : digest[2 * i];
+        bigint.data[3 - i] = (uint64_t(high) << 32) | digest[(2 * i) + 1];
+    }
+    return FieldT(bigint);
+}
+
+inline void leaf_hash_batch(const FieldT *in_secrets, const FieldT *in_wallet_addresses, FieldT *out_leaves, size_t n, Sha256BatchKernel kernel = SHA256_BATCH_KERNEL_AUTO)
+{
+    std::vector<uint32_t> words(16 * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        leaf_field_to_words(in_secrets[i], &words[16 * i]);
+        leaf_field_to_words(in_wallet_addresses[i], &words[(16 * i) + 8]);
+    }
+
+    std::vector<uint32_t> digests(8 * n);
+    sha256_batch_512(words.data(), digests.data(), n, kernel);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        out_leaves[i] = leaf_from_digest(&digests[8 * i]);
+    }
+}
+
+inline void nullifier_hash_batch(const FieldT *in_secrets, FieldT *out_nullifiers, size_t n)
+{
+    std::vector<FieldT> msgs;
+    msgs.reserve(2 * n);
+    for (size_t i = 0; i < n; i++)
+    {
+        msgs.push_back(in_secrets[i]);
+        msgs.push_back(in_secrets[i]);
+    }
+
+    const FieldT key = FieldT::zero();
+    MiMCe7_batch::default_instance().hash(msgs.data(), 2, &key, 0, out_nullifiers, n);
+}
+
+/**
+* Offsets of a list of leaves, such as those of the `LeafAdded` events in
+* order, by value. A leaf which appears more than once has its first offset.
+*/
+class LeafOffsets
+{
+protected:
+    // The low limb of the Montgomery form is as good as random
+    struct Hash
+    {
+        size_t operator()(const FieldT &leaf) const
+        {
+            return size_t(leaf.mont_repr.data[0]);
+        }
+    };
+
+    std::unordered_map<FieldT, size_t, Hash> m_offsets;
+
+public:
+    LeafOffsets(const FieldT *in_leaves, size_t n)
+    {
+        m_offsets.reserve(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            m_offsets.emplace(in_leaves[i], i);
+        }
+    }
+
+    /**
+    * Offset of `leaf`, -1 if it isn't in the list
+    */
+    long find(const FieldT &leaf) const
+    {
+        const auto it = m_offsets.find(leaf);
+        return (it == m_offsets.end()) ? -1 : long(it->second);
+    }
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_LEAF_BATCH_HPP_
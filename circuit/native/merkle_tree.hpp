@@ -0,0 +1,430 @@
+#ifndef MIXER_NATIVE_MERKLE_TREE_HPP_
+#define MIXER_NATIVE_MERKLE_TREE_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "ethsnarks.hpp"
+#include "gadgets/mimc.hpp"
+
+#include "native/mimc_batch.hpp"
+#include "native/sha256.hpp"
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Incremental merkle tree which mirrors `MerkleTree.sol`, so that the
+* root and authentication paths match what the contract computes:
+*
+*  - nodes are `MiMC.Hash([left, right], IVs[level])`
+*  - a node which was never written defaults to the unique leaf
+*      sha256(uint16(level) || uint240(offset)) % q
+*  - the root of an empty tree is zero
+*
+* Appending a leaf only recomputes the nodes on its path, O(depth) hashes.
+* Appending many leaves at once recomputes each affected node exactly once,
+* level by level, with each level split across SIMD lanes and the prover's
+* pool of worker threads.
+*/
+
+/**
+* Per-level IVs of `MerkleTree.fillLevelIVs`, in Montgomery form
+*/
+static const uint64_t MERKLE_TREE_LEVEL_IVS_MONTGOMERY[][4] = {
+    {0x6cf014c65ef249e8, 0xa5e70ec5b4b69094, 0xb6ef3b68246f88c2, 0x281d028dcc351ffb}, // 149674538925118052205057075966660054952481571156186698930522557832224430770
+    {0x232ed584fec9d401, 0x9043f0c13f83b864, 0x9efb049027052203, 0x2f15b6ceb5717120}, // 9670701465464311903249220692483401938888498641874948577387207195814981706974
+    {0x0aa176dc15df1228, 0xc190c86b4863a224, 0x37daf2882c31e1e2, 0x0228714ad00ddd83}, // 18318710344500308168304415114839554107298291987930233567781901093928276468271
+    {0x5bcd747e8f6fec1b, 0x8751227c229457cb, 0x93805cd6f006e31f, 0x0c8554ea9ba15153}, // 6597209388525824933845812104623007130464197923269180086306970975123437805179
+    {0x8d5b2fbbea802312, 0x5594c63e6538c0d4, 0x2fa7618ac69f07f0, 0x0a53b2ccc19981a7}, // 21720956803147356712695575768577036859892220417043839172295094119877855004262
+    {0xbf5729bd5a9ed536, 0x32e6e0a129276473, 0xf26173abbc0c182e, 0x1fa7ce77a23f2f09}, // 10330261616520855230513677034606076056972336573153777401182178891807369896722
+    {0x29553d255bd024ea, 0x81008a58ed26046d, 0x0682af620ee24d6f, 0x06dc458093b715dc}, // 17466547730316258748333298168566143799241073466140136663575045164199607937939
+    {0x8b277a5331d9f79a, 0xc41f6b01f48862ab, 0x7155ee0dc78e913a, 0x0be31646e96704c5}, // 18881017304615283094648494495339883533502299318365959655029893746755475886610
+    {0x67607438c50bf03f, 0x1f4c124c04fbf146, 0xbfd45b0d511f4bbf, 0x1f1fdfb5dfc1020c}, // 21580915712563378725413940003372103925756594604076607277692074507345076595494
+    {0xa8113c8d5d19c88c, 0xd14658687e821d82, 0x15ca828b4721da22, 0x01475388f2065cf3}, // 12316305934357579015754723412431647910012873427291630993042374701002287130550
+    {0xda4da70d2dd36408, 0xbeeac66d13d3d0f0, 0xd2716224a94adbed, 0x212cb4772e288b89}, // 18905410889238873726515380969411495891004493295170115920825550288019118582494
+    {0x0196193113356480, 0x0982dfa882083ca2, 0xb22fa726baf06015, 0x0bedad874a1fbdaf}, // 12819107342879320352602391015489840916114959026915005817918724958237245903353
+    {0xcc2cfbf6672af54c, 0x34447107842304f4, 0xc0657731567bbb5f, 0x1cf8ce9662e4600d}, // 8245796392944118634696709403074300923517437202166861682117022548371601758802
+    {0x60215cd67956aee2, 0x410432f35e817e94, 0x8e40daf53e212b1d, 0x269e8e41f74d982e}, // 16953062784314687781686527153155644849196472783922227794465158787843281909585
+    {0xd47a8eb7f0241c7f, 0x989153b0a1440fb9, 0xfa50e6b07da350ef, 0x17b9dc8e50791e35}  // 19346880451250915556764413197424554385509847473349107460608536657852472800734
+};
+
+/**
+* Per-level IVs, identical to `MerkleTree.fillLevelIVs`
+*/
+inline const std::vector<FieldT> &merkle_tree_level_IVs()
+{
+    static std::vector<FieldT> IVs;
+    static std::once_flag filled;
+
+    std::call_once(filled, []() {
+        IVs = field_table(MERKLE_TREE_LEVEL_IVS_MONTGOMERY);
+    });
+
+    return IVs;
+}
+
+class MerkleTree
+{
+public:
+    MerkleTree(size_t in_depth) : m_depth(in_depth),
+                                  m_size(0),
+                                  m_IVs(merkle_tree_level_IVs()),
+                                  m_storage(storage_size(in_depth), FieldT::zero()),
+                                  m_root(FieldT::zero())
+    {
+        assert(in_depth <= m_IVs.size());
+        set_storage(m_storage.data());
+    }
+
+    virtual ~MerkleTree()
+    {
+    }
+
+    /**
+    * Number of nodes in all levels, from the leaves up to and including the root
+    */
+    static size_t storage_size(size_t depth)
+    {
+        return (size_t(2) << depth) - 1;
+    }
+
+    size_t depth() const
+    {
+        return m_depth;
+    }
+
+    // Number of leaves appended so far, also the offset of the next leaf
+    virtual size_t size() const
+    {
+        return m_size;
+    }
+
+    size_t capacity() const
+    {
+        return size_t(1) << m_depth;
+    }
+
+    bool is_full() const
+    {
+        return m_size >= capacity();
+    }
+
+    virtual FieldT root() const
+    {
+        return m_root;
+    }
+
+    /**
+    * Like `MerkleTree.getUniqueLeaf`, the value to use for a node which hasn't been set
+    */
+    static FieldT unique_leaf(size_t level, size_t offset)
+    {
+        // abi.encodePacked(uint16(level), uint240(offset))
+        uint8_t packed[32] = {0};
+        packed[0] = (uint8_t)(level >> 8);
+        packed[1] = (uint8_t)level;
+        for (size_t i = 0; i < sizeof(size_t); i++)
+        {
+            packed[31 - i] = (uint8_t)(offset >> (8 * i));
+        }
+
+        uint8_t digest[32];
+        sha256(packed, sizeof(packed), digest);
+
+        // Big-endian digest to little-endian limbs, converting to FieldT reduces it mod q
+        libff::bigint<FieldT::num_limbs> digest_bigint;
+        for (size_t i = 0; i < FieldT::num_limbs; i++)
+        {
+            uint64_t limb = 0;
+            for (size_t j = 0; j < 8; j++)
+            {
+                limb = (limb << 8) | digest[(8 * i) + j];
+            }
+            digest_bigint.data[FieldT::num_limbs - 1 - i] = limb;
+        }
+
+        return FieldT(digest_bigint);
+    }
+
+    FieldT hash_pair(size_t level, const FieldT &left, const FieldT &right) const
+    {
+        return mimc_hash({left, right}, m_IVs[level]);
+    }
+
+    /**
+    * Number of nodes which have been set at `level`
+    */
+    size_t level_size(size_t level) const
+    {
+        return level_size(m_size, level);
+    }
+
+    static size_t level_size(size_t tree_size, size_t level)
+    {
+        return (tree_size == 0) ? 0 : (((tree_size - 1) >> level) + 1);
+    }
+
+    /**
+    * Like `MerkleTree.getLeaf`, node at `level` with unset nodes replaced by their unique leaf
+    */
+    FieldT node(size_t level, size_t offset) const
+    {
+        if (offset < level_size(level) && !m_levels[level][offset].is_zero())
+        {
+            return m_levels[level][offset];
+        }
+        return unique_leaf(level, offset);
+    }
+
+    /**
+    * Insert a leaf at the next free offset and update the nodes along its path,
+    * the leaf must be non-zero and the tree must not be full.
+    * Returns false, leaving the tree as it was, if the updated tree couldn't
+    * be committed.
+    */
+    virtual bool append(const FieldT &leaf)
+    {
+        assert(!leaf.is_zero());
+        assert(!is_full());
+
+        const size_t leaf_offset = m_size;
+        m_levels[0][leaf_offset] = leaf;
+        const FieldT root = update_path(leaf_offset);
+
+        return publish(m_size + 1, root);
+    }
+
+    /**
+    * Insert `n` non-zero leaves at the next free offsets, e.g. to rebuild the
+    * tree from the full deposit history. Each level is hashed in `n_threads`
+    * chunks (0 for one per core), run by the calling thread and the process'
+    * worker pool, once the level below is done.
+    * When `out_level_seconds` is given it receives the wall time of each level.
+    * Returns false, leaving the tree as it was, if the updated tree couldn't
+    * be committed.
+    */
+    virtual bool append_many(const FieldT *leaves, size_t n, size_t n_threads = 0, std::vector<double> *out_level_seconds = nullptr)
+    {
+        assert((m_size + n) <= capacity());
+        if (n == 0)
+        {
+            return true;
+        }
+
+        if (n_threads == 0)
+        {
+            n_threads = prover::default_threads();
+        }
+        if (out_level_seconds != nullptr)
+        {
+            out_level_seconds->assign(m_depth, 0);
+        }
+
+        const auto &batch = MiMCe7_batch::default_instance();
+
+        std::copy(leaves, leaves + n, m_levels[0] + m_size);
+
+        // Nodes [lo, hi) of the current level have changed, the level holds `hi` nodes
+        size_t lo = m_size;
+        size_t hi = m_size + n;
+        for (size_t level = 0; level < m_depth; level++)
+        {
+            const auto start_time = std::chrono::steady_clock::now();
+
+            const size_t parent_lo = lo / 2;
+            const size_t parent_hi = ((hi - 1) / 2) + 1;
+
+            const FieldT *nodes = m_levels[level];
+            FieldT *parents = m_levels[level + 1];
+
+            // Pairs of set nodes are contiguous, a trailing odd node is paired with its unique leaf
+            const size_t n_pairs = (hi / 2) - parent_lo;
+            const FieldT *pairs = nodes + (2 * parent_lo);
+            FieldT *out = parents + parent_lo;
+
+            const size_t lanes = batch.lanes();
+            const size_t per_chunk = ((n_pairs / n_threads) + lanes) / lanes * lanes;
+            const size_t n_chunks = (n_pairs + per_chunk - 1) / per_chunk;
+            prover::parallel_tasks(n_chunks, [&batch, pairs, out, per_chunk, n_pairs, level, this](size_t chunk) {
+                const size_t offset = chunk * per_chunk;
+                batch.hash(pairs + (2 * offset), 2, &m_IVs[level], 0, out + offset, std::min(per_chunk, n_pairs - offset));
+            });
+
+            if (hi % 2 != 0)
+            {
+                parents[parent_hi - 1] = hash_pair(level, nodes[hi - 1], unique_leaf(level, hi));
+            }
+
+            lo = parent_lo;
+            hi = parent_hi;
+
+            if (out_level_seconds != nullptr)
+            {
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+                (*out_level_seconds)[level] = elapsed.count();
+            }
+        }
+
+        return publish(m_size + n, m_levels[m_depth][0]);
+    }
+
+    /**
+    * Like `MerkleTree.getMerkleProof`, the sibling at each level from the leaf
+    * upwards and the address bits of the offset [LSB...MSB]
+    */
+    virtual void path(size_t offset, std::vector<FieldT> &out_path, libff::bit_vector &out_address) const
+    {
+        assert(offset < capacity());
+
+        out_path.resize(m_depth);
+        out_address.resize(m_depth);
+        for (size_t level = 0; level < m_depth; level++)
+        {
+            out_address[level] = (offset % 2) != 0;
+            out_path[level] = node(level, offset ^ 1);
+            offset /= 2;
+        }
+    }
+
+    /**
+    * Like `MerkleTree.verifyPath`, the root implied by a leaf and its authentication path
+    */
+    FieldT compute_root(const FieldT &leaf, const std::vector<FieldT> &in_path, const libff::bit_vector &in_address) const
+    {
+        FieldT current = leaf;
+        for (size_t level = 0; level < m_depth; level++)
+        {
+            if (in_address[level])
+            {
+                current = hash_pair(level, in_path[level], current);
+            }
+            else
+            {
+                current = hash_pair(level, current, in_path[level]);
+            }
+        }
+        return current;
+    }
+
+protected:
+    /**
+    * For trees whose nodes live elsewhere, e.g. in a memory mapped file.
+    * `in_storage` holds `storage_size(in_depth)` nodes, level by level.
+    */
+    MerkleTree(size_t in_depth, FieldT *in_storage, size_t in_size, const FieldT &in_root) : m_depth(in_depth),
+                                                                                             m_size(in_size),
+                                                                                             m_IVs(merkle_tree_level_IVs()),
+                                                                                             m_root(in_root)
+    {
+        assert(in_depth <= m_IVs.size());
+        set_storage(in_storage);
+    }
+
+    /**
+    * Called once the nodes for newly appended leaves have been written,
+    * before the tree's size and root are updated to `in_size` and `in_root`
+    */
+    virtual bool commit(size_t /* in_size */, const FieldT & /* in_root */)
+    {
+        return true;
+    }
+
+    /**
+    * Commits the nodes written for leaves up to `in_size`, then makes them
+    * part of the tree. If they can't be committed the tree keeps its size
+    * and root, and the path of its last leaf, which the new nodes may have
+    * overwritten, is rehashed. Other new nodes are past the size, unset.
+    */
+    bool publish(size_t in_size, const FieldT &in_root)
+    {
+        if (!commit(in_size, in_root))
+        {
+            if (m_size != 0)
+            {
+                update_path(m_size - 1);
+            }
+            return false;
+        }
+
+        m_size = in_size;
+        m_root = in_root;
+        return true;
+    }
+
+    void set_storage(FieldT *in_storage)
+    {
+        m_levels.resize(m_depth + 1);
+        for (size_t level = 0; level <= m_depth; level++)
+        {
+            m_levels[level] = in_storage;
+            in_storage += (capacity() >> level);
+        }
+    }
+
+    /**
+    * The nodes on the path of the leaf at `leaf_offset`, which must be the
+    * last leaf of the tree, from the leaf up to the root, hashed from the
+    * leaf and its left siblings only. Nodes after it count as unset.
+    */
+    void last_path_nodes(size_t leaf_offset, std::vector<FieldT> &out_nodes) const
+    {
+        out_nodes.resize(m_depth + 1);
+        out_nodes[0] = m_levels[0][leaf_offset];
+        size_t offset = leaf_offset;
+        for (size_t level = 0; level < m_depth; level++)
+        {
+            if (offset % 2 == 0)
+            {
+                out_nodes[level + 1] = hash_pair(level, out_nodes[level], unique_leaf(level, offset + 1));
+            }
+            else
+            {
+                const FieldT &left = m_levels[level][offset - 1];
+                out_nodes[level + 1] = hash_pair(level, left.is_zero() ? unique_leaf(level, offset - 1) : left, out_nodes[level]);
+            }
+            offset /= 2;
+        }
+    }
+
+    /**
+    * Rehash the nodes on the path of the leaf at `leaf_offset`, which must be
+    * the last leaf of the tree, even before `m_size` includes it.
+    * Returns the new root.
+    */
+    FieldT update_path(size_t leaf_offset)
+    {
+        std::vector<FieldT> nodes;
+        last_path_nodes(leaf_offset, nodes);
+        for (size_t level = 1; level <= m_depth; level++)
+        {
+            m_levels[level][leaf_offset >> level] = nodes[level];
+        }
+        return nodes[m_depth];
+    }
+
+    const size_t m_depth;
+    size_t m_size;
+    const std::vector<FieldT> &m_IVs;
+
+    // Owned nodes, unless the tree was constructed with external storage
+    std::vector<FieldT> m_storage;
+
+    // m_levels[0] are the leaves, m_levels[m_depth][0] is the root
+    std::vector<FieldT *> m_levels;
+    FieldT m_root;
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_MERKLE_TREE_HPP_
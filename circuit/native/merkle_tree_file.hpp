@@ -0,0 +1,461 @@
+#ifndef MIXER_NATIVE_MERKLE_TREE_FILE_HPP_
+#define MIXER_NATIVE_MERKLE_TREE_FILE_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "native/merkle_tree.hpp"
+#include "native/sha256.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Persistent merkle tree, a fixed layout file which is memory mapped so the
+* nodes are read in place without any parsing:
+*
+*   [0, 4096)    two header slots, see `MerkleTreeFileHeader`
+*   [4096, ...)  all levels of the tree, leaves first, each node stored as
+*                its `FieldT` in-memory representation (Montgomery form,
+*                little-endian 64-bit limbs), zero for unset nodes
+*
+* Appending writes the new nodes, syncs them to disk, then writes the new
+* leaf count and root into the older of the two header slots and syncs it.
+* A torn header write fails its checksum and the other slot is used, nodes
+* of leaves which were never committed are past the leaf count and ignored.
+* The only committed nodes an append overwrites are on the path of the last
+* committed leaf, which is rehashed when the file is opened for writing.
+*
+* Other processes may read the file while one appends to it. Readers don't
+* read the nodes on the last committed leaf's path, they hash them from the
+* leaf and its left siblings, which appends never overwrite. Every read uses
+* the newest valid header, and is retried if another one was committed
+* before it finished, so a path always hashes to the root it was read with.
+*
+* Writers hold an exclusive `flock` while they open the file and while they
+* append, readers a shared one while they open it. A writer only appends if
+* the newest header is its own last commit, so a second writer of the same
+* file fails to append instead of overwriting the first one's leaves.
+*/
+
+static const char MERKLE_TREE_FILE_MAGIC[8] = {'M', 'I', 'X', 'T', 'R', 'E', 'E', '\0'};
+static const uint32_t MERKLE_TREE_FILE_VERSION = 1;
+static const size_t MERKLE_TREE_FILE_PAGE = 4096;
+
+static_assert(sizeof(FieldT) == 32, "Merkle tree file stores nodes as 32 byte field elements");
+
+struct MerkleTreeFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t depth;
+    uint64_t sequence; // incremented on every commit, the highest valid slot wins
+    uint64_t size;     // number of committed leaves
+    uint8_t root[32];
+    uint8_t checksum[32]; // sha256 of all the preceding fields
+
+    void compute_checksum(uint8_t out_checksum[32]) const
+    {
+        sha256(reinterpret_cast<const uint8_t *>(this), offsetof(MerkleTreeFileHeader, checksum), out_checksum);
+    }
+
+    bool is_valid(size_t in_depth) const
+    {
+        uint8_t expected[32];
+        compute_checksum(expected);
+        return 0 == ::memcmp(expected, checksum, sizeof(checksum)) && 0 == ::memcmp(magic, MERKLE_TREE_FILE_MAGIC, sizeof(magic)) && version == MERKLE_TREE_FILE_VERSION && depth == in_depth && size <= (uint64_t(1) << in_depth);
+    }
+
+    /**
+    * The newest valid header slot of a mapped file. Slots are copied before
+    * they're checked, so one which is being written fails its checksum
+    * rather than changing after it was checked.
+    */
+    static bool read_newest(const void *mapping, size_t in_depth, MerkleTreeFileHeader &out_header)
+    {
+        bool found = false;
+        for (size_t i = 0; i < 2; i++)
+        {
+            MerkleTreeFileHeader slot;
+            ::memcpy(&slot, static_cast<const MerkleTreeFileHeader *>(mapping) + i, sizeof(slot));
+            if (slot.is_valid(in_depth) && (!found || slot.sequence > out_header.sequence))
+            {
+                out_header = slot;
+                found = true;
+            }
+        }
+        // Nodes are read after the header which committed them
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return found;
+    }
+};
+
+/**
+* Holds a `flock` on a tree file until it goes out of scope
+*/
+class MerkleTreeFileLock
+{
+public:
+    MerkleTreeFileLock(int in_fd, int in_operation) : m_fd(in_fd),
+                                                      m_locked(lock(in_fd, in_operation))
+    {
+    }
+
+    ~MerkleTreeFileLock()
+    {
+        if (m_locked)
+        {
+            ::flock(m_fd, LOCK_UN);
+        }
+    }
+
+    MerkleTreeFileLock(const MerkleTreeFileLock &) = delete;
+    MerkleTreeFileLock &operator=(const MerkleTreeFileLock &) = delete;
+
+    bool locked() const
+    {
+        return m_locked;
+    }
+
+    static bool lock(int fd, int operation)
+    {
+        while (0 != ::flock(fd, operation))
+        {
+            if (errno != EINTR)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    const int m_fd;
+    const bool m_locked;
+};
+
+class MerkleTreeFile : public MerkleTree
+{
+public:
+    /**
+    * Opens or creates the tree file. Read-only files can't be appended to.
+    * Returns nullptr if the file can't be mapped or isn't a valid tree.
+    */
+    static MerkleTreeFile *open(const char *in_path, size_t in_depth, bool in_writable)
+    {
+        const int fd = ::open(in_path, in_writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "Cannot open merkle tree file: " << in_path << std::endl;
+            return nullptr;
+        }
+
+        // Closing the file on failure releases the lock
+        if (!MerkleTreeFileLock::lock(fd, in_writable ? LOCK_EX : LOCK_SH))
+        {
+            std::cerr << "Cannot lock merkle tree file: " << in_path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+
+        const size_t file_size = mapping_size(in_depth);
+        struct stat st;
+        if (0 != ::fstat(fd, &st))
+        {
+            ::close(fd);
+            return nullptr;
+        }
+        if (st.st_size == 0 && in_writable)
+        {
+            // New file, zero filled (sparse) so every node starts out unset
+            if (0 != ::ftruncate(fd, file_size) || !write_header(fd, initial_header(in_depth)))
+            {
+                std::cerr << "Cannot create merkle tree file: " << in_path << std::endl;
+                ::close(fd);
+                return nullptr;
+            }
+        }
+        else if ((size_t)st.st_size != file_size)
+        {
+            std::cerr << "Merkle tree file has the wrong size: " << in_path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *mapping = ::mmap(nullptr, file_size, in_writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            std::cerr << "Cannot map merkle tree file: " << in_path << std::endl;
+            ::close(fd);
+            return nullptr;
+        }
+
+        MerkleTreeFileHeader header;
+        if (!MerkleTreeFileHeader::read_newest(mapping, in_depth, header))
+        {
+            std::cerr << "No valid header in merkle tree file: " << in_path << std::endl;
+            ::munmap(mapping, file_size);
+            ::close(fd);
+            return nullptr;
+        }
+
+        FieldT root;
+        ::memcpy(&root, header.root, sizeof(root));
+
+        auto tree = new MerkleTreeFile(in_depth, fd, mapping, in_writable, header, root);
+        if (!tree->recover())
+        {
+            std::cerr << "Merkle tree file is corrupt: " << in_path << std::endl;
+            delete tree;
+            return nullptr;
+        }
+
+        ::flock(fd, LOCK_UN);
+        return tree;
+    }
+
+    ~MerkleTreeFile()
+    {
+        ::munmap(m_mapping, mapping_size(m_depth));
+        ::close(m_fd);
+    }
+
+    bool is_writable() const
+    {
+        return m_writable;
+    }
+
+    /**
+    * Readers see the newest commit of the file, writers their own
+    */
+    size_t size() const override
+    {
+        MerkleTreeFileHeader header;
+        return (!m_writable && read_header(header)) ? size_t(header.size) : m_size;
+    }
+
+    FieldT root() const override
+    {
+        MerkleTreeFileHeader header;
+        if (m_writable || !read_header(header))
+        {
+            return m_root;
+        }
+        FieldT root;
+        ::memcpy(&root, header.root, sizeof(root));
+        return root;
+    }
+
+    void path(size_t offset, std::vector<FieldT> &out_path, libff::bit_vector &out_address) const override
+    {
+        if (m_writable)
+        {
+            MerkleTree::path(offset, out_path, out_address);
+            return;
+        }
+        assert(offset < capacity());
+
+        out_path.resize(m_depth);
+        out_address.resize(m_depth);
+        std::vector<FieldT> last_path;
+        MerkleTreeFileHeader header;
+        MerkleTreeFileHeader after;
+        do
+        {
+            if (!read_header(header))
+            {
+                MerkleTree::path(offset, out_path, out_address);
+                return;
+            }
+            if (header.size != 0)
+            {
+                last_path_nodes(header.size - 1, last_path);
+            }
+
+            size_t node_offset = offset;
+            for (size_t level = 0; level < m_depth; level++)
+            {
+                out_address[level] = (node_offset % 2) != 0;
+                out_path[level] = committed_node(header.size, last_path, level, node_offset ^ 1);
+                node_offset /= 2;
+            }
+        } while (read_header(after) && after.sequence != header.sequence);
+    }
+
+    bool append(const FieldT &leaf) override
+    {
+        MerkleTreeFileLock lock(m_fd, LOCK_EX);
+        return can_append(lock) && MerkleTree::append(leaf);
+    }
+
+    bool append_many(const FieldT *leaves, size_t n, size_t n_threads = 0, std::vector<double> *out_level_seconds = nullptr) override
+    {
+        MerkleTreeFileLock lock(m_fd, LOCK_EX);
+        return can_append(lock) && MerkleTree::append_many(leaves, n, n_threads, out_level_seconds);
+    }
+
+protected:
+    MerkleTreeFile(size_t in_depth, int in_fd, void *in_mapping, bool in_writable, const MerkleTreeFileHeader &in_header, const FieldT &in_root) : MerkleTree(in_depth, reinterpret_cast<FieldT *>(static_cast<uint8_t *>(in_mapping) + MERKLE_TREE_FILE_PAGE), in_header.size, in_root),
+                                                                                                                                                   m_fd(in_fd),
+                                                                                                                                                   m_mapping(in_mapping),
+                                                                                                                                                   m_writable(in_writable),
+                                                                                                                                                   m_sequence(in_header.sequence)
+    {
+    }
+
+    static size_t mapping_size(size_t depth)
+    {
+        const size_t nodes_size = storage_size(depth) * sizeof(FieldT);
+        return MERKLE_TREE_FILE_PAGE + (((nodes_size + MERKLE_TREE_FILE_PAGE - 1) / MERKLE_TREE_FILE_PAGE) * MERKLE_TREE_FILE_PAGE);
+    }
+
+    static MerkleTreeFileHeader initial_header(size_t depth)
+    {
+        MerkleTreeFileHeader header;
+        ::memset(&header, 0, sizeof(header));
+        ::memcpy(header.magic, MERKLE_TREE_FILE_MAGIC, sizeof(header.magic));
+        header.version = MERKLE_TREE_FILE_VERSION;
+        header.depth = depth;
+        const FieldT zero = FieldT::zero();
+        ::memcpy(header.root, &zero, sizeof(header.root));
+        header.compute_checksum(header.checksum);
+        return header;
+    }
+
+    static bool write_header(int fd, const MerkleTreeFileHeader &header)
+    {
+        return (ssize_t)sizeof(header) == ::pwrite(fd, &header, sizeof(header), 0) && 0 == ::fsync(fd);
+    }
+
+    bool read_header(MerkleTreeFileHeader &out_header) const
+    {
+        return MerkleTreeFileHeader::read_newest(m_mapping, m_depth, out_header);
+    }
+
+    /**
+    * A node of the tree when it had `tree_size` leaves, those on the path of
+    * its last leaf are taken from `last_path` (see `last_path_nodes`)
+    */
+    FieldT committed_node(size_t tree_size, const std::vector<FieldT> &last_path, size_t level, size_t offset) const
+    {
+        if (offset >= level_size(tree_size, level))
+        {
+            return unique_leaf(level, offset);
+        }
+        if (offset == ((tree_size - 1) >> level))
+        {
+            return last_path[level];
+        }
+        const FieldT value = m_levels[level][offset];
+        return value.is_zero() ? unique_leaf(level, offset) : value;
+    }
+
+    /**
+    * Whether this tree may append, holding the exclusive lock: it must be
+    * writable and no other writer may have committed since it last did
+    */
+    bool can_append(const MerkleTreeFileLock &lock) const
+    {
+        if (!m_writable)
+        {
+            std::cerr << "Merkle tree file is read-only" << std::endl;
+            return false;
+        }
+        if (!lock.locked())
+        {
+            std::cerr << "Cannot lock merkle tree file" << std::endl;
+            return false;
+        }
+
+        MerkleTreeFileHeader header;
+        if (!read_header(header) || header.sequence != m_sequence)
+        {
+            std::cerr << "Merkle tree file was appended to by another writer" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+    * Nodes on the path of the last committed leaf may have been overwritten
+    * by an append which crashed, or is still running, before its header was
+    * written. Writers rehash them, readers never read them (see `path`) and
+    * only check that they hash to the root.
+    */
+    bool recover()
+    {
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        if (m_writable)
+        {
+            return update_path(m_size - 1) == m_root;
+        }
+
+        std::vector<FieldT> last_path;
+        last_path_nodes(m_size - 1, last_path);
+        return last_path[m_depth] == m_root;
+    }
+
+    /**
+    * Sync the nodes, then publish them by writing the older header slot
+    */
+    bool commit(size_t in_size, const FieldT &in_root) override
+    {
+        assert(m_writable);
+
+        uint8_t *nodes_begin = static_cast<uint8_t *>(m_mapping) + MERKLE_TREE_FILE_PAGE;
+        if (0 != ::msync(nodes_begin, mapping_size(m_depth) - MERKLE_TREE_FILE_PAGE, MS_SYNC))
+        {
+            std::cerr << "Cannot sync merkle tree nodes" << std::endl;
+            return false;
+        }
+
+        auto &header = static_cast<MerkleTreeFileHeader *>(m_mapping)[(m_sequence + 1) % 2];
+        const MerkleTreeFileHeader previous = header;
+        MerkleTreeFileHeader updated = initial_header(m_depth);
+        updated.sequence = m_sequence + 1;
+        updated.size = in_size;
+        ::memcpy(updated.root, &in_root, sizeof(updated.root));
+        updated.compute_checksum(updated.checksum);
+        std::atomic_thread_fence(std::memory_order_release);
+        header = updated;
+
+        if (0 != ::msync(m_mapping, MERKLE_TREE_FILE_PAGE, MS_SYNC))
+        {
+            // The tree keeps its old root, so must the file
+            std::cerr << "Cannot sync merkle tree header" << std::endl;
+            header = previous;
+            return false;
+        }
+
+        m_sequence++;
+        return true;
+    }
+
+    const int m_fd;
+    void *const m_mapping;
+    const bool m_writable;
+    uint64_t m_sequence;
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_MERKLE_TREE_FILE_HPP_
@@ -0,0 +1,277 @@
+#ifndef MIXER_NATIVE_MERKLE_TREE_VERSIONED_HPP_
+#define MIXER_NATIVE_MERKLE_TREE_VERSIONED_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "native/merkle_tree.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Persistent (path-copying) variant of `MerkleTree`, every version of the
+* tree stays readable after further leaves are appended.
+*
+* Version `v` is the tree after `v` leaves were appended, and its root is
+* what `MerkleTree.getRoot()` returned at that point. Appending creates the
+* `depth + 1` nodes on the new leaf's path, all other nodes are shared with
+* the previous version. Paths at any version are found in O(depth) by
+* walking down from that version's root.
+*
+* Nodes are never moved or freed, they live in fixed size chunks which are
+* allocated before the version referencing them is published, so one
+* writer can append while any number of readers query paths without locks.
+* Memory is bounded by the capacity of the tree, so every version is kept.
+*/
+class VersionedMerkleTree
+{
+public:
+    typedef uint32_t NodeIndexT;
+
+    static const NodeIndexT NULL_NODE = UINT32_MAX;
+
+    struct Node
+    {
+        FieldT hash;
+        NodeIndexT left;  // NULL_NODE for unset children, which default to their unique leaf
+        NodeIndexT right;
+    };
+
+    /**
+    * One version of the tree, remains valid while more leaves are appended
+    */
+    class Snapshot
+    {
+    public:
+        Snapshot(const VersionedMerkleTree &in_tree, size_t in_version) : m_tree(in_tree),
+                                                                          m_version(in_version)
+        {
+        }
+
+        // Number of leaves in this version
+        size_t size() const
+        {
+            return m_version;
+        }
+
+        FieldT root() const
+        {
+            return m_tree.root(m_version);
+        }
+
+        void path(size_t offset, std::vector<FieldT> &out_path, libff::bit_vector &out_address) const
+        {
+            m_tree.path(m_version, offset, out_path, out_address);
+        }
+
+    protected:
+        const VersionedMerkleTree &m_tree;
+        const size_t m_version;
+    };
+
+    VersionedMerkleTree(size_t in_depth) : m_depth(in_depth),
+                                           m_IVs(merkle_tree_level_IVs()),
+                                           m_chunks(((size_t(1) << in_depth) * (in_depth + 1) + CHUNK_SIZE - 1) / CHUNK_SIZE),
+                                           m_n_nodes(0),
+                                           m_version_roots((size_t(1) << in_depth) + 1, NodeIndexT(NULL_NODE)),
+                                           m_size(0)
+    {
+        assert(in_depth <= m_IVs.size());
+    }
+
+    size_t depth() const
+    {
+        return m_depth;
+    }
+
+    size_t capacity() const
+    {
+        return size_t(1) << m_depth;
+    }
+
+    /**
+    * Number of leaves in the latest version, which is also the latest version
+    */
+    size_t size() const
+    {
+        return m_size.load(std::memory_order_acquire);
+    }
+
+    bool is_full() const
+    {
+        return size() >= capacity();
+    }
+
+    Snapshot snapshot() const
+    {
+        return Snapshot(*this, size());
+    }
+
+    Snapshot snapshot(size_t version) const
+    {
+        assert(version <= size());
+        return Snapshot(*this, version);
+    }
+
+    /**
+    * Root of a version, zero for the empty tree like `MerkleTree.getRoot`
+    */
+    FieldT root(size_t version) const
+    {
+        assert(version <= size());
+        const NodeIndexT root_index = m_version_roots[version];
+        return (root_index == NULL_NODE) ? FieldT::zero() : node(root_index).hash;
+    }
+
+    /**
+    * The roots of up to `count` of the most recent versions, newest first
+    */
+    void root_history(size_t count, std::vector<FieldT> &out_roots) const
+    {
+        const size_t latest = size();
+        out_roots.clear();
+        for (size_t i = 0; i < count && i <= latest; i++)
+        {
+            out_roots.push_back(root(latest - i));
+        }
+    }
+
+    /**
+    * Finds the most recent version with the given root
+    */
+    bool find_version(const FieldT &in_root, size_t &out_version) const
+    {
+        for (size_t version = size() + 1; version-- > 0;)
+        {
+            if (root(version) == in_root)
+            {
+                out_version = version;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+    * Authentication path of the leaf at `offset` for the root of `version`,
+    * same format as `MerkleTree::path`
+    */
+    void path(size_t version, size_t offset, std::vector<FieldT> &out_path, libff::bit_vector &out_address) const
+    {
+        assert(version <= size());
+        assert(offset < capacity());
+
+        out_path.resize(m_depth);
+        out_address.resize(m_depth);
+
+        NodeIndexT current = m_version_roots[version];
+        for (size_t level = m_depth; level-- > 0;)
+        {
+            const bool is_right = ((offset >> level) & 1) != 0;
+            const size_t sibling_offset = (offset >> level) ^ 1;
+
+            NodeIndexT sibling = NULL_NODE;
+            if (current != NULL_NODE)
+            {
+                const Node &parent = node(current);
+                sibling = is_right ? parent.left : parent.right;
+                current = is_right ? parent.right : parent.left;
+            }
+
+            out_address[level] = is_right;
+            out_path[level] = (sibling == NULL_NODE) ? MerkleTree::unique_leaf(level, sibling_offset) : node(sibling).hash;
+        }
+    }
+
+    /**
+    * Append a non-zero leaf, creating a new version. Only one thread may append.
+    */
+    void append(const FieldT &leaf)
+    {
+        assert(!leaf.is_zero());
+        assert(!is_full());
+
+        const size_t version = m_size.load(std::memory_order_relaxed);
+        const size_t offset = version;
+
+        // Siblings of the new leaf's path in the previous version, from the root down
+        std::vector<NodeIndexT> siblings(m_depth, NodeIndexT(NULL_NODE));
+        NodeIndexT current = m_version_roots[version];
+        for (size_t level = m_depth; level-- > 0 && current != NULL_NODE;)
+        {
+            const Node &parent = node(current);
+            const bool is_right = ((offset >> level) & 1) != 0;
+            siblings[level] = is_right ? parent.left : parent.right;
+            current = is_right ? parent.right : parent.left;
+        }
+
+        // New nodes from the leaf up, the sibling to the right of the path is always unset
+        NodeIndexT child = new_node(leaf, NULL_NODE, NULL_NODE);
+        FieldT hash = leaf;
+        for (size_t level = 0; level < m_depth; level++)
+        {
+            const size_t level_offset = offset >> level;
+            if (level_offset % 2 == 0)
+            {
+                hash = mimc_hash({hash, MerkleTree::unique_leaf(level, level_offset + 1)}, m_IVs[level]);
+                child = new_node(hash, child, NULL_NODE);
+            }
+            else
+            {
+                const NodeIndexT left = siblings[level];
+                const FieldT left_hash = (left == NULL_NODE) ? MerkleTree::unique_leaf(level, level_offset - 1) : node(left).hash;
+                hash = mimc_hash({left_hash, hash}, m_IVs[level]);
+                child = new_node(hash, left, child);
+            }
+        }
+
+        // Publish the new version, readers acquire it through m_size
+        m_version_roots[version + 1] = child;
+        m_size.store(version + 1, std::memory_order_release);
+    }
+
+protected:
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+    const Node &node(NodeIndexT index) const
+    {
+        return m_chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+    }
+
+    NodeIndexT new_node(const FieldT &hash, NodeIndexT left, NodeIndexT right)
+    {
+        const NodeIndexT index = m_n_nodes++;
+        auto &chunk = m_chunks[index >> CHUNK_BITS];
+        if (!chunk)
+        {
+            chunk.reset(new Node[CHUNK_SIZE]);
+        }
+        chunk[index & (CHUNK_SIZE - 1)] = Node{hash, left, right};
+        return index;
+    }
+
+    const size_t m_depth;
+    const std::vector<FieldT> &m_IVs;
+
+    // Sized for a full tree up front, so readers never see it reallocated
+    std::vector<std::unique_ptr<Node[]>> m_chunks;
+    NodeIndexT m_n_nodes;
+
+    // Root node of every version, m_version_roots[0] is the empty tree
+    std::vector<NodeIndexT> m_version_roots;
+    std::atomic<size_t> m_size;
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_MERKLE_TREE_VERSIONED_HPP_
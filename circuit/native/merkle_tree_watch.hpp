@@ -0,0 +1,124 @@
+#ifndef MIXER_NATIVE_MERKLE_TREE_WATCH_HPP_
+#define MIXER_NATIVE_MERKLE_TREE_WATCH_HPP_
+
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+#include "native/merkle_tree.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Keeps the authentication paths of a set of tracked leaves up to date as
+* leaves are appended to a `MerkleTree`, so they're ready to prove with.
+*
+* When leaves [first, first + count) are appended, the sibling of a tracked
+* leaf `t` at `level` changes only if that sibling's subtree contains one of
+* the new leaves, i.e. if ((t >> level) ^ 1) is within
+* [first >> level, (first + count - 1) >> level]. Each update is O(depth)
+* per tracked leaf, and for a single new leaf only one sibling changes: at
+* the level of the highest bit in which both offsets differ.
+*/
+class MerkleTreeWatchSet
+{
+public:
+    /**
+    * Start tracking the leaf at `offset`, which may not have been appended yet
+    */
+    void watch(const MerkleTree &tree, size_t offset)
+    {
+        assert(offset < tree.capacity());
+
+        libff::bit_vector address;
+        tree.path(offset, m_paths[offset], address);
+    }
+
+    bool unwatch(size_t offset)
+    {
+        return m_paths.erase(offset) != 0;
+    }
+
+    bool is_watched(size_t offset) const
+    {
+        return m_paths.count(offset) != 0;
+    }
+
+    size_t size() const
+    {
+        return m_paths.size();
+    }
+
+    /**
+    * Path of a tracked leaf against the current root, same format as `MerkleTree::path`
+    */
+    bool path(size_t offset, std::vector<FieldT> &out_path, libff::bit_vector &out_address) const
+    {
+        const auto it = m_paths.find(offset);
+        if (it == m_paths.end())
+        {
+            return false;
+        }
+
+        out_path = it->second;
+        out_address.resize(out_path.size());
+        for (size_t level = 0; level < out_path.size(); level++)
+        {
+            out_address[level] = ((offset >> level) & 1) != 0;
+        }
+        return true;
+    }
+
+    /**
+    * Call after appending `count` leaves starting at offset `first` to `tree`
+    */
+    void update(const MerkleTree &tree, size_t first, size_t count)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        const size_t last = first + count - 1;
+        for (auto &item : m_paths)
+        {
+            const size_t offset = item.first;
+            auto &path = item.second;
+            for (size_t level = 0; level < path.size(); level++)
+            {
+                const size_t sibling = (offset >> level) ^ 1;
+                if (sibling >= (first >> level) && sibling <= (last >> level))
+                {
+                    path[level] = tree.node(level, sibling);
+                }
+            }
+        }
+    }
+
+    /**
+    * Reads every tracked path from `tree` again, when its leaves are
+    * appended by another process and `update` can't be called for them
+    */
+    void refresh(const MerkleTree &tree)
+    {
+        libff::bit_vector address;
+        for (auto &item : m_paths)
+        {
+            tree.path(item.first, item.second, address);
+        }
+    }
+
+protected:
+    // Siblings from the leaf upwards, for each tracked leaf offset
+    std::unordered_map<size_t, std::vector<FieldT>> m_paths;
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_MERKLE_TREE_WATCH_HPP_
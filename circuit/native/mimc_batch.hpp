@@ -0,0 +1,725 @@
+#ifndef MIXER_NATIVE_MIMC_BATCH_HPP_
+#define MIXER_NATIVE_MIMC_BATCH_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "ethsnarks.hpp"
+#include "gadgets/mimc.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MIXER_MIMC_BATCH_X86 1
+#endif
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Batch evaluation of many independent MiMCe7 ciphers or Miyaguchi-Preneel
+* hashes, one per SIMD lane, over a structure-of-arrays layout.
+*
+* Every kernel computes exactly what `MiMCe7_round::generate_r1cs_witness`
+* does for each round:
+*
+*   t = x + k + C[i]
+*   a = t^2, b = a^2, c = a*b
+*   x = c*t             (+ k after the last round)
+*
+*  - AVX-512 IFMA: 8 lanes, 5x52-bit limbs, Montgomery form with R = 2^260
+*  - AVX2:         4 lanes, 8x32-bit limbs, Montgomery form with R = 2^256
+*  - scalar:       1 lane, libff field arithmetic
+*
+* The AVX2 lanes use the same Montgomery representation as libff's
+* `mont_repr`, the IFMA lanes use `(x * 16).mont_repr` (i.e. x * 2^260).
+*/
+
+enum MiMCBatchKernel
+{
+    MIMC_KERNEL_AUTO = 0,
+    MIMC_KERNEL_SCALAR,
+    MIMC_KERNEL_AVX2,
+    MIMC_KERNEL_AVX512_IFMA
+};
+
+static_assert(sizeof(FieldT) == 4 * sizeof(uint64_t), "Batch MiMC kernels assume a 4x64-bit limb scalar field");
+
+// BN254 scalar field modulus, little-endian 64-bit limbs
+static const uint64_t MIMC_BATCH_MODULUS[4] = {
+    0x43e1f593f0000001ULL, 0x2833e84879b97091ULL,
+    0xb85045b68181585dULL, 0x30644e72e131a029ULL};
+
+inline const uint64_t *mimc_batch_limbs(const FieldT &x)
+{
+    return reinterpret_cast<const uint64_t *>(x.mont_repr.data);
+}
+
+inline uint64_t *mimc_batch_limbs(FieldT &x)
+{
+    return reinterpret_cast<uint64_t *>(x.mont_repr.data);
+}
+
+#if defined(MIXER_MIMC_BATCH_X86)
+
+namespace avx2
+{
+
+static const size_t LANES = 4;
+static const size_t LIMBS = 8;
+static const uint64_t MASK32 = 0xFFFFFFFFULL;
+static const uint64_t N_INV32 = 0xEFFFFFFFULL; // -p^-1 mod 2^32
+
+struct lanes_t
+{
+    __m256i v[LIMBS];
+};
+
+struct consts_t
+{
+    __m256i p[LIMBS];
+    __m256i mask;
+    __m256i n_inv;
+};
+
+__attribute__((target("avx2"))) inline void load_consts(consts_t &out)
+{
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        out.p[i] = _mm256_set1_epi64x((long long)((MIMC_BATCH_MODULUS[i / 2] >> (32 * (i % 2))) & MASK32));
+    }
+    out.mask = _mm256_set1_epi64x((long long)MASK32);
+    out.n_inv = _mm256_set1_epi64x((long long)N_INV32);
+}
+
+/**
+* r = s - p if s >= p, otherwise s
+*/
+__attribute__((target("avx2"))) inline void reduce_once(lanes_t &r, const lanes_t &s, const consts_t &c)
+{
+    __m256i borrow = _mm256_setzero_si256();
+    lanes_t d;
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        const __m256i t = _mm256_sub_epi64(_mm256_sub_epi64(s.v[i], c.p[i]), borrow);
+        borrow = _mm256_srli_epi64(t, 63);
+        d.v[i] = _mm256_and_si256(t, c.mask);
+    }
+    // A remaining borrow means s < p
+    const __m256i keep_s = _mm256_cmpeq_epi64(borrow, _mm256_set1_epi64x(1));
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm256_blendv_epi8(d.v[i], s.v[i], keep_s);
+    }
+}
+
+__attribute__((target("avx2"))) inline void add(lanes_t &r, const lanes_t &a, const lanes_t &b, const consts_t &c)
+{
+    lanes_t s;
+    __m256i carry = _mm256_setzero_si256();
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        const __m256i t = _mm256_add_epi64(_mm256_add_epi64(a.v[i], b.v[i]), carry);
+        s.v[i] = _mm256_and_si256(t, c.mask);
+        carry = _mm256_srli_epi64(t, 32);
+    }
+    // a + b < 2p < 2^255, there is no carry out of the top limb
+    reduce_once(r, s, c);
+}
+
+/**
+* Montgomery multiplication, CIOS with 32-bit words.
+* Each step computes t[j] + a[j]*b[i] + carry, which fits in 64 bits.
+*/
+__attribute__((target("avx2"))) inline void mul(lanes_t &r, const lanes_t &a, const lanes_t &b, const consts_t &c)
+{
+    __m256i t[LIMBS + 2];
+    for (size_t j = 0; j < LIMBS + 2; j++)
+    {
+        t[j] = _mm256_setzero_si256();
+    }
+
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        __m256i carry = _mm256_setzero_si256();
+        for (size_t j = 0; j < LIMBS; j++)
+        {
+            const __m256i s = _mm256_add_epi64(_mm256_add_epi64(t[j], _mm256_mul_epu32(a.v[j], b.v[i])), carry);
+            t[j] = _mm256_and_si256(s, c.mask);
+            carry = _mm256_srli_epi64(s, 32);
+        }
+        __m256i s = _mm256_add_epi64(t[LIMBS], carry);
+        t[LIMBS] = _mm256_and_si256(s, c.mask);
+        t[LIMBS + 1] = _mm256_srli_epi64(s, 32);
+
+        const __m256i m = _mm256_and_si256(_mm256_mul_epu32(t[0], c.n_inv), c.mask);
+        s = _mm256_add_epi64(t[0], _mm256_mul_epu32(m, c.p[0]));
+        carry = _mm256_srli_epi64(s, 32);
+        for (size_t j = 1; j < LIMBS; j++)
+        {
+            s = _mm256_add_epi64(_mm256_add_epi64(t[j], _mm256_mul_epu32(m, c.p[j])), carry);
+            t[j - 1] = _mm256_and_si256(s, c.mask);
+            carry = _mm256_srli_epi64(s, 32);
+        }
+        s = _mm256_add_epi64(t[LIMBS], carry);
+        t[LIMBS - 1] = _mm256_and_si256(s, c.mask);
+        t[LIMBS] = _mm256_add_epi64(t[LIMBS + 1], _mm256_srli_epi64(s, 32));
+    }
+
+    // Inputs are below p, so the result is below 2p and t[LIMBS] is zero
+    lanes_t s;
+    for (size_t j = 0; j < LIMBS; j++)
+    {
+        s.v[j] = t[j];
+    }
+    reduce_once(r, s, c);
+}
+
+__attribute__((target("avx2"))) inline void broadcast(lanes_t &r, const uint64_t limbs[4])
+{
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm256_set1_epi64x((long long)((limbs[i / 2] >> (32 * (i % 2))) & MASK32));
+    }
+}
+
+/**
+* Transpose up to 4 field elements, stride apart, into lanes
+*/
+__attribute__((target("avx2"))) inline void load(lanes_t &r, const FieldT *in, size_t stride, size_t count)
+{
+    alignas(32) uint64_t soa[LIMBS][LANES];
+    std::memset(soa, 0, sizeof(soa));
+    for (size_t l = 0; l < count; l++)
+    {
+        const uint64_t *x = mimc_batch_limbs(in[l * stride]);
+        for (size_t i = 0; i < LIMBS; i++)
+        {
+            soa[i][l] = (x[i / 2] >> (32 * (i % 2))) & MASK32;
+        }
+    }
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm256_load_si256((const __m256i *)soa[i]);
+    }
+}
+
+__attribute__((target("avx2"))) inline void store(FieldT *out, const lanes_t &x, size_t count)
+{
+    alignas(32) uint64_t soa[LIMBS][LANES];
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        _mm256_store_si256((__m256i *)soa[i], x.v[i]);
+    }
+    for (size_t l = 0; l < count; l++)
+    {
+        uint64_t *r = mimc_batch_limbs(out[l]);
+        for (size_t i = 0; i < 4; i++)
+        {
+            r[i] = soa[2 * i][l] | (soa[2 * i + 1][l] << 32);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) inline void encrypt(lanes_t &x, const lanes_t &k, const std::vector<uint64_t> &round_constants, const consts_t &c)
+{
+    lanes_t t, a, b, C;
+    for (size_t i = 0; i < round_constants.size(); i += 4)
+    {
+        broadcast(C, &round_constants[i]);
+        add(t, x, k, c);
+        add(t, t, C, c);
+        mul(a, t, t, c); // t^2
+        mul(b, a, a, c); // t^4
+        mul(a, a, b, c); // t^6
+        mul(x, a, t, c); // t^7
+    }
+    add(x, x, k, c);
+}
+
+/**
+* Up to 4 Miyaguchi-Preneel hashes (or plain ciphers, when `is_hash` is false)
+*/
+__attribute__((target("avx2"))) inline void chunk(
+    const std::vector<uint64_t> &round_constants,
+    bool is_hash,
+    const FieldT *in_msgs, size_t msgs_per_hash,
+    const FieldT *in_keys, size_t key_stride,
+    FieldT *out, size_t count)
+{
+    consts_t c;
+    load_consts(c);
+
+    lanes_t h, m, e;
+    load(h, in_keys, key_stride, count);
+
+    for (size_t j = 0; j < msgs_per_hash; j++)
+    {
+        load(m, in_msgs + j, msgs_per_hash, count);
+        e = m;
+        encrypt(e, h, round_constants, c);
+        if (is_hash)
+        {
+            // H_i = E(H_{i-1}, m_i) + H_{i-1} + m_i
+            add(h, h, m, c);
+            add(h, h, e, c);
+        }
+        else
+        {
+            h = e;
+        }
+    }
+
+    store(out, h, count);
+}
+
+} // namespace avx2
+
+namespace ifma
+{
+
+static const size_t LANES = 8;
+static const size_t LIMBS = 5;
+static const uint64_t MASK52 = 0xFFFFFFFFFFFFFULL;
+static const uint64_t N_INV52 = 0x1F593EFFFFFFFULL; // -p^-1 mod 2^52
+
+struct lanes_t
+{
+    __m512i v[LIMBS];
+};
+
+struct consts_t
+{
+    __m512i p[LIMBS];
+    __m512i mask;
+    __m512i n_inv;
+};
+
+inline void to_radix52(uint64_t r[LIMBS], const uint64_t x[4])
+{
+    r[0] = x[0] & MASK52;
+    r[1] = ((x[0] >> 52) | (x[1] << 12)) & MASK52;
+    r[2] = ((x[1] >> 40) | (x[2] << 24)) & MASK52;
+    r[3] = ((x[2] >> 28) | (x[3] << 36)) & MASK52;
+    r[4] = x[3] >> 16;
+}
+
+inline void from_radix52(uint64_t r[4], const uint64_t x[LIMBS])
+{
+    r[0] = x[0] | (x[1] << 52);
+    r[1] = (x[1] >> 12) | (x[2] << 40);
+    r[2] = (x[2] >> 24) | (x[3] << 28);
+    r[3] = (x[3] >> 36) | (x[4] << 16);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void load_consts(consts_t &out)
+{
+    uint64_t p52[LIMBS];
+    to_radix52(p52, MIMC_BATCH_MODULUS);
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        out.p[i] = _mm512_set1_epi64((long long)p52[i]);
+    }
+    out.mask = _mm512_set1_epi64((long long)MASK52);
+    out.n_inv = _mm512_set1_epi64((long long)N_INV52);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void reduce_once(lanes_t &r, const lanes_t &s, const consts_t &c)
+{
+    __m512i borrow = _mm512_setzero_si512();
+    lanes_t d;
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        const __m512i t = _mm512_sub_epi64(_mm512_sub_epi64(s.v[i], c.p[i]), borrow);
+        borrow = _mm512_srli_epi64(t, 63);
+        d.v[i] = _mm512_and_si512(t, c.mask);
+    }
+    const __mmask8 keep_s = _mm512_cmpeq_epi64_mask(borrow, _mm512_set1_epi64(1));
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm512_mask_blend_epi64(keep_s, d.v[i], s.v[i]);
+    }
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void add(lanes_t &r, const lanes_t &a, const lanes_t &b, const consts_t &c)
+{
+    lanes_t s;
+    __m512i carry = _mm512_setzero_si512();
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        const __m512i t = _mm512_add_epi64(_mm512_add_epi64(a.v[i], b.v[i]), carry);
+        s.v[i] = _mm512_and_si512(t, c.mask);
+        carry = _mm512_srli_epi64(t, 52);
+    }
+    reduce_once(r, s, c);
+}
+
+/**
+* Montgomery multiplication with 52-bit words using vpmadd52{l,h}uq.
+* Accumulators are only normalised to 52 bits at the end.
+*/
+__attribute__((target("avx512f,avx512ifma"))) inline void mul(lanes_t &r, const lanes_t &a, const lanes_t &b, const consts_t &c)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i t[LIMBS + 1];
+    for (size_t j = 0; j <= LIMBS; j++)
+    {
+        t[j] = zero;
+    }
+
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        for (size_t j = 0; j < LIMBS; j++)
+        {
+            t[j] = _mm512_madd52lo_epu64(t[j], a.v[j], b.v[i]);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], a.v[j], b.v[i]);
+        }
+
+        const __m512i m = _mm512_madd52lo_epu64(zero, t[0], c.n_inv);
+        for (size_t j = 0; j < LIMBS; j++)
+        {
+            t[j] = _mm512_madd52lo_epu64(t[j], m, c.p[j]);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], m, c.p[j]);
+        }
+
+        // Lowest word is now a multiple of 2^52, shift everything down one word
+        t[0] = _mm512_add_epi64(t[1], _mm512_srli_epi64(t[0], 52));
+        for (size_t j = 1; j < LIMBS; j++)
+        {
+            t[j] = t[j + 1];
+        }
+        t[LIMBS] = zero;
+    }
+
+    lanes_t s;
+    __m512i carry = zero;
+    for (size_t j = 0; j < LIMBS; j++)
+    {
+        const __m512i u = _mm512_add_epi64(t[j], carry);
+        s.v[j] = _mm512_and_si512(u, c.mask);
+        carry = _mm512_srli_epi64(u, 52);
+    }
+    reduce_once(r, s, c);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void broadcast(lanes_t &r, const uint64_t limbs[LIMBS])
+{
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm512_set1_epi64((long long)limbs[i]);
+    }
+}
+
+/**
+* Transpose up to 8 field elements into lanes, converting to R = 2^260
+*/
+__attribute__((target("avx512f,avx512ifma"))) inline void load(lanes_t &r, const FieldT *in, size_t stride, size_t count)
+{
+    static const FieldT sixteen(16);
+
+    alignas(64) uint64_t soa[LIMBS][LANES];
+    std::memset(soa, 0, sizeof(soa));
+    for (size_t l = 0; l < count; l++)
+    {
+        const FieldT x = in[l * stride] * sixteen;
+        uint64_t limbs[LIMBS];
+        to_radix52(limbs, mimc_batch_limbs(x));
+        for (size_t i = 0; i < LIMBS; i++)
+        {
+            soa[i][l] = limbs[i];
+        }
+    }
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        r.v[i] = _mm512_load_si512((const void *)soa[i]);
+    }
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void store(FieldT *out, const lanes_t &x, size_t count)
+{
+    static const FieldT sixteen_inverse = FieldT(16).inverse();
+
+    alignas(64) uint64_t soa[LIMBS][LANES];
+    for (size_t i = 0; i < LIMBS; i++)
+    {
+        _mm512_store_si512((void *)soa[i], x.v[i]);
+    }
+    for (size_t l = 0; l < count; l++)
+    {
+        uint64_t limbs[LIMBS];
+        for (size_t i = 0; i < LIMBS; i++)
+        {
+            limbs[i] = soa[i][l];
+        }
+        FieldT y;
+        from_radix52(mimc_batch_limbs(y), limbs);
+        out[l] = y * sixteen_inverse;
+    }
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void encrypt(lanes_t &x, const lanes_t &k, const std::vector<uint64_t> &round_constants, const consts_t &c)
+{
+    lanes_t t, a, b, C;
+    for (size_t i = 0; i < round_constants.size(); i += LIMBS)
+    {
+        broadcast(C, &round_constants[i]);
+        add(t, x, k, c);
+        add(t, t, C, c);
+        mul(a, t, t, c); // t^2
+        mul(b, a, a, c); // t^4
+        mul(a, a, b, c); // t^6
+        mul(x, a, t, c); // t^7
+    }
+    add(x, x, k, c);
+}
+
+__attribute__((target("avx512f,avx512ifma"))) inline void chunk(
+    const std::vector<uint64_t> &round_constants,
+    bool is_hash,
+    const FieldT *in_msgs, size_t msgs_per_hash,
+    const FieldT *in_keys, size_t key_stride,
+    FieldT *out, size_t count)
+{
+    consts_t c;
+    load_consts(c);
+
+    lanes_t h, m, e;
+    load(h, in_keys, key_stride, count);
+
+    for (size_t j = 0; j < msgs_per_hash; j++)
+    {
+        load(m, in_msgs + j, msgs_per_hash, count);
+        e = m;
+        encrypt(e, h, round_constants, c);
+        if (is_hash)
+        {
+            add(h, h, m, c);
+            add(h, h, e, c);
+        }
+        else
+        {
+            h = e;
+        }
+    }
+
+    store(out, h, count);
+}
+
+} // namespace ifma
+
+#endif // MIXER_MIMC_BATCH_X86
+
+inline bool mimc_batch_kernel_supported(MiMCBatchKernel kernel)
+{
+    switch (kernel)
+    {
+    case MIMC_KERNEL_AUTO:
+    case MIMC_KERNEL_SCALAR:
+        return true;
+#if defined(MIXER_MIMC_BATCH_X86)
+    case MIMC_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case MIMC_KERNEL_AVX512_IFMA:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+#endif
+    default:
+        return false;
+    }
+}
+
+inline const char *mimc_batch_kernel_name(MiMCBatchKernel kernel)
+{
+    switch (kernel)
+    {
+    case MIMC_KERNEL_SCALAR:
+        return "scalar";
+    case MIMC_KERNEL_AVX2:
+        return "avx2";
+    case MIMC_KERNEL_AVX512_IFMA:
+        return "avx512ifma";
+    default:
+        return "auto";
+    }
+}
+
+/**
+* Picks the widest kernel supported by the CPU, can be overridden with
+* the MIXER_MIMC_KERNEL environment variable (scalar, avx2, avx512ifma)
+*/
+inline MiMCBatchKernel mimc_batch_detect_kernel()
+{
+    const char *forced = ::getenv("MIXER_MIMC_KERNEL");
+    if (forced != nullptr)
+    {
+        for (auto kernel : {MIMC_KERNEL_SCALAR, MIMC_KERNEL_AVX2, MIMC_KERNEL_AVX512_IFMA})
+        {
+            if (0 == ::strcmp(forced, mimc_batch_kernel_name(kernel)) && mimc_batch_kernel_supported(kernel))
+            {
+                return kernel;
+            }
+        }
+    }
+
+    if (mimc_batch_kernel_supported(MIMC_KERNEL_AVX512_IFMA))
+    {
+        return MIMC_KERNEL_AVX512_IFMA;
+    }
+    if (mimc_batch_kernel_supported(MIMC_KERNEL_AVX2))
+    {
+        return MIMC_KERNEL_AVX2;
+    }
+
+    return MIMC_KERNEL_SCALAR;
+}
+
+class MiMCe7_batch
+{
+protected:
+    const std::vector<FieldT> m_round_constants;
+    const MiMCBatchKernel m_kernel;
+
+    // Round constants in the kernel's limb representation
+    std::vector<uint64_t> m_kernel_constants;
+
+    void _run(
+        bool is_hash,
+        const FieldT *in_msgs, size_t msgs_per_hash,
+        const FieldT *in_keys, size_t key_stride,
+        FieldT *out, size_t n) const
+    {
+        const size_t lanes = this->lanes();
+
+        for (size_t offset = 0; offset < n; offset += lanes)
+        {
+            const size_t count = std::min(lanes, n - offset);
+            const FieldT *msgs = in_msgs + (offset * msgs_per_hash);
+            const FieldT *keys = in_keys + (offset * key_stride);
+
+            switch (m_kernel)
+            {
+#if defined(MIXER_MIMC_BATCH_X86)
+            case MIMC_KERNEL_AVX2:
+                avx2::chunk(m_kernel_constants, is_hash, msgs, msgs_per_hash, keys, key_stride, out + offset, count);
+                break;
+            case MIMC_KERNEL_AVX512_IFMA:
+                ifma::chunk(m_kernel_constants, is_hash, msgs, msgs_per_hash, keys, key_stride, out + offset, count);
+                break;
+#endif
+            default:
+                for (size_t l = 0; l < count; l++)
+                {
+                    const FieldT *m = msgs + (l * msgs_per_hash);
+                    const FieldT &k = keys[l * key_stride];
+                    if (is_hash)
+                    {
+                        out[offset + l] = mimc_hash(m_round_constants, std::vector<FieldT>(m, m + msgs_per_hash), k);
+                    }
+                    else
+                    {
+                        out[offset + l] = mimc(m_round_constants, m[0], k);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+public:
+    MiMCe7_batch(
+        const std::vector<FieldT> &in_round_constants,
+        MiMCBatchKernel in_kernel = MIMC_KERNEL_AUTO) : m_round_constants(in_round_constants),
+                                                        m_kernel(in_kernel == MIMC_KERNEL_AUTO ? mimc_batch_detect_kernel() : in_kernel)
+    {
+        assert(mimc_batch_kernel_supported(m_kernel));
+
+        if (m_kernel == MIMC_KERNEL_AVX2)
+        {
+            for (const auto &C_i : m_round_constants)
+            {
+                const uint64_t *limbs = mimc_batch_limbs(C_i);
+                m_kernel_constants.insert(m_kernel_constants.end(), limbs, limbs + 4);
+            }
+        }
+#if defined(MIXER_MIMC_BATCH_X86)
+        else if (m_kernel == MIMC_KERNEL_AVX512_IFMA)
+        {
+            const FieldT sixteen(16);
+            for (const auto &C_i : m_round_constants)
+            {
+                const FieldT C_260 = C_i * sixteen;
+                uint64_t limbs[ifma::LIMBS];
+                ifma::to_radix52(limbs, mimc_batch_limbs(C_260));
+                m_kernel_constants.insert(m_kernel_constants.end(), limbs, limbs + ifma::LIMBS);
+            }
+        }
+#endif
+    }
+
+    /**
+    * Shared instance using the default round constants and the best kernel
+    */
+    static const MiMCe7_batch &default_instance()
+    {
+        static std::once_flag initialised;
+        static MiMCe7_batch *instance = nullptr;
+
+        std::call_once(initialised, []() {
+            instance = new MiMCe7_batch(MiMC_gadget::static_constants());
+        });
+
+        return *instance;
+    }
+
+    MiMCBatchKernel kernel() const
+    {
+        return m_kernel;
+    }
+
+    size_t lanes() const
+    {
+        switch (m_kernel)
+        {
+#if defined(MIXER_MIMC_BATCH_X86)
+        case MIMC_KERNEL_AVX2:
+            return avx2::LANES;
+        case MIMC_KERNEL_AVX512_IFMA:
+            return ifma::LANES;
+#endif
+        default:
+            return 1;
+        }
+    }
+
+    /**
+    * out[i] = E_k[i](x[i]), keys are read from in_k[i * key_stride]
+    */
+    void encrypt(const FieldT *in_x, const FieldT *in_k, size_t key_stride, FieldT *out, size_t n) const
+    {
+        _run(false, in_x, 1, in_k, key_stride, out, n);
+    }
+
+    /**
+    * out[i] = MiMC_hash(in_msgs[i*msgs_per_hash ... (i+1)*msgs_per_hash], in_keys[i * key_stride])
+    *
+    * A key_stride of 0 uses the same key (e.g. a merkle tree level IV) for every hash.
+    */
+    void hash(const FieldT *in_msgs, size_t msgs_per_hash, const FieldT *in_keys, size_t key_stride, FieldT *out, size_t n) const
+    {
+        _run(true, in_msgs, msgs_per_hash, in_keys, key_stride, out, n);
+    }
+};
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_MIMC_BATCH_HPP_
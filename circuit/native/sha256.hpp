@@ -0,0 +1,345 @@
+#ifndef MIXER_NATIVE_SHA256_HPP_
+#define MIXER_NATIVE_SHA256_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define MIXER_SHA256_X86 1
+#endif
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+// The block after a 512 bit message: 0x80, zeros and the bit length
+static const uint8_t SHA256_PADDING_512[64] = {
+    0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00};
+
+inline uint32_t sha256_rotr(uint32_t x, unsigned n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t sha256_load_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void sha256_store_be32(uint8_t *p, uint32_t x)
+{
+    p[0] = (uint8_t)(x >> 24);
+    p[1] = (uint8_t)(x >> 16);
+    p[2] = (uint8_t)(x >> 8);
+    p[3] = (uint8_t)x;
+}
+
+/**
+* Expand a 16 word message block to the full 64 word message schedule
+*/
+inline void sha256_message_schedule(uint32_t W[64], const uint8_t block[64])
+{
+    for (size_t i = 0; i < 16; i++)
+    {
+        W[i] = sha256_load_be32(block + (4 * i));
+    }
+    for (size_t i = 16; i < 64; i++)
+    {
+        const uint32_t s0 = sha256_rotr(W[i - 15], 7) ^ sha256_rotr(W[i - 15], 18) ^ (W[i - 15] >> 3);
+        const uint32_t s1 = sha256_rotr(W[i - 2], 17) ^ sha256_rotr(W[i - 2], 19) ^ (W[i - 2] >> 10);
+        W[i] = W[i - 16] + s0 + W[i - 7] + s1;
+    }
+}
+
+/**
+* One SHA256 compression function, updates `state` in place
+*/
+inline void sha256_compress(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t W[64];
+    sha256_message_schedule(W, block);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        const uint32_t S1 = sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25);
+        const uint32_t ch = (e & f) ^ (~e & g);
+        const uint32_t temp1 = h + S1 + ch + SHA256_K[i] + W[i];
+        const uint32_t S0 = sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22);
+        const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t temp2 = S0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/*
+* Every intermediate word of one compression function, as needed to fill
+* in the witness of libsnark's SHA256 gadgets.
+*
+* A and E hold the a and e words with the three before them: round i
+* reads a, b, c, d = A[i + 3], A[i + 2], A[i + 1], A[i] and e, f, g, h
+* from E the same way, then sets A[i + 4] and E[i + 4]. The first four of
+* each are the input state.
+*
+*  - SHA-NI: two rounds per instruction, the state after each pair holds
+*            both of their new a and e words
+*  - scalar: one round at a time
+*/
+struct Sha256Trace
+{
+    uint32_t W[64];
+    uint32_t A[68];
+    uint32_t E[68];
+    uint32_t H[8];
+};
+
+enum Sha256Kernel
+{
+    SHA256_KERNEL_AUTO = 0,
+    SHA256_KERNEL_SCALAR,
+    SHA256_KERNEL_SHANI
+};
+
+inline void sha256_trace_begin(const uint32_t state[8], const uint8_t block[64], Sha256Trace &out)
+{
+    sha256_message_schedule(out.W, block);
+    for (size_t i = 0; i < 4; i++)
+    {
+        out.A[3 - i] = state[i];
+        out.E[3 - i] = state[4 + i];
+    }
+}
+
+inline void sha256_trace_end(const uint32_t state[8], Sha256Trace &out)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        out.H[i] = state[i] + out.A[67 - i];
+        out.H[4 + i] = state[4 + i] + out.E[67 - i];
+    }
+}
+
+inline void sha256_compress_trace_scalar(const uint32_t state[8], const uint8_t block[64], Sha256Trace &out)
+{
+    sha256_trace_begin(state, block, out);
+
+    const uint32_t *A = out.A;
+    const uint32_t *E = out.E;
+    for (size_t i = 0; i < 64; i++)
+    {
+        const uint32_t a = A[i + 3], b = A[i + 2], c = A[i + 1], d = A[i];
+        const uint32_t e = E[i + 3], f = E[i + 2], g = E[i + 1], h = E[i];
+        const uint32_t S1 = sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25);
+        const uint32_t ch = (e & f) ^ (~e & g);
+        const uint32_t temp1 = h + S1 + ch + SHA256_K[i] + out.W[i];
+        const uint32_t S0 = sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22);
+        const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+
+        out.A[i + 4] = temp1 + S0 + maj;
+        out.E[i + 4] = d + temp1;
+    }
+
+    sha256_trace_end(state, out);
+}
+
+#if defined(MIXER_SHA256_X86)
+__attribute__((target("sha,sse4.1"))) inline void sha256_compress_trace_shani(const uint32_t state[8], const uint8_t block[64], Sha256Trace &out)
+{
+    sha256_trace_begin(state, block, out);
+
+    // The instructions keep the state as ABEF and CDGH, highest lane first
+    __m128i abef = _mm_set_epi32(state[0], state[1], state[4], state[5]);
+    __m128i cdgh = _mm_set_epi32(state[2], state[3], state[6], state[7]);
+
+    for (size_t i = 0; i < 64; i += 4)
+    {
+        __m128i wk = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(out.W + i)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(SHA256_K + i)));
+
+        // Each pair of rounds makes the old ABEF the new CDGH, B and F are the first round's a and e
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+        out.A[i + 4] = uint32_t(_mm_extract_epi32(cdgh, 2));
+        out.A[i + 5] = uint32_t(_mm_extract_epi32(cdgh, 3));
+        out.E[i + 4] = uint32_t(_mm_extract_epi32(cdgh, 0));
+        out.E[i + 5] = uint32_t(_mm_extract_epi32(cdgh, 1));
+
+        wk = _mm_shuffle_epi32(wk, 0x0E);
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, wk);
+        out.A[i + 6] = uint32_t(_mm_extract_epi32(abef, 2));
+        out.A[i + 7] = uint32_t(_mm_extract_epi32(abef, 3));
+        out.E[i + 6] = uint32_t(_mm_extract_epi32(abef, 0));
+        out.E[i + 7] = uint32_t(_mm_extract_epi32(abef, 1));
+    }
+
+    sha256_trace_end(state, out);
+}
+#endif // MIXER_SHA256_X86
+
+inline bool sha256_kernel_supported(Sha256Kernel kernel)
+{
+    switch (kernel)
+    {
+    case SHA256_KERNEL_AUTO:
+    case SHA256_KERNEL_SCALAR:
+        return true;
+#if defined(MIXER_SHA256_X86)
+    case SHA256_KERNEL_SHANI:
+    {
+        unsigned int eax, ebx, ecx, edx;
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1") && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+inline const char *sha256_kernel_name(Sha256Kernel kernel)
+{
+    switch (kernel)
+    {
+    case SHA256_KERNEL_SCALAR:
+        return "scalar";
+    case SHA256_KERNEL_SHANI:
+        return "shani";
+    default:
+        return "auto";
+    }
+}
+
+/**
+* SHA-NI if the CPU has it, can be overridden with the MIXER_SHA256_KERNEL
+* environment variable (scalar, shani)
+*/
+inline Sha256Kernel sha256_detect_kernel()
+{
+    const char *forced = ::getenv("MIXER_SHA256_KERNEL");
+    if (forced != nullptr)
+    {
+        for (auto kernel : {SHA256_KERNEL_SCALAR, SHA256_KERNEL_SHANI})
+        {
+            if (0 == ::strcmp(forced, sha256_kernel_name(kernel)) && sha256_kernel_supported(kernel))
+            {
+                return kernel;
+            }
+        }
+    }
+
+    if (sha256_kernel_supported(SHA256_KERNEL_SHANI))
+    {
+        return SHA256_KERNEL_SHANI;
+    }
+
+    return SHA256_KERNEL_SCALAR;
+}
+
+/**
+* One compression function of `block` on `state`, keeping every intermediate word
+*/
+inline void sha256_compress_trace(const uint32_t state[8], const uint8_t block[64], Sha256Trace &out, Sha256Kernel kernel = SHA256_KERNEL_AUTO)
+{
+    if (kernel == SHA256_KERNEL_AUTO)
+    {
+        static const Sha256Kernel detected = sha256_detect_kernel();
+        kernel = detected;
+    }
+
+#if defined(MIXER_SHA256_X86)
+    if (kernel == SHA256_KERNEL_SHANI)
+    {
+        sha256_compress_trace_shani(state, block, out);
+        return;
+    }
+#endif
+
+    sha256_compress_trace_scalar(state, block, out);
+}
+
+/**
+* SHA256 of a complete message
+*/
+inline void sha256(const uint8_t *in_data, size_t in_len, uint8_t out_digest[32])
+{
+    uint32_t state[8];
+    std::memcpy(state, SHA256_IV, sizeof(state));
+
+    size_t offset = 0;
+    for (; (offset + 64) <= in_len; offset += 64)
+    {
+        sha256_compress(state, in_data + offset);
+    }
+
+    // Final block(s): remaining bytes, 0x80, zeros and the 64-bit bit length
+    uint8_t tail[128];
+    std::memset(tail, 0, sizeof(tail));
+    const size_t remaining = in_len - offset;
+    std::memcpy(tail, in_data + offset, remaining);
+    tail[remaining] = 0x80;
+
+    const size_t tail_len = (remaining < 56) ? 64 : 128;
+    const uint64_t bit_len = (uint64_t)in_len * 8;
+    for (size_t i = 0; i < 8; i++)
+    {
+        tail[tail_len - 1 - i] = (uint8_t)(bit_len >> (8 * i));
+    }
+
+    sha256_compress(state, tail);
+    if (tail_len == 128)
+    {
+        sha256_compress(state, tail + 64);
+    }
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        sha256_store_be32(out_digest + (4 * i), state[i]);
+    }
+}
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_SHA256_HPP_
@@ -0,0 +1,386 @@
+#ifndef MIXER_NATIVE_SHA256_BATCH_HPP_
+#define MIXER_NATIVE_SHA256_BATCH_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include "native/sha256.hpp"
+
+namespace ethsnarks
+{
+
+namespace native
+{
+
+/*
+* Multi-buffer SHA256 of many independent 512 bit messages, one message
+* per 32 bit SIMD lane. Messages and digests are big-endian words, 16 and
+* 8 per message.
+*
+* Every message is exactly one block, so the second compression function
+* is of SHA256_PADDING_512: its message schedule plus round constants is
+* the same for every lane and is computed once.
+*
+*  - AVX-512: 16 lanes
+*  - AVX2:    8 lanes
+*  - single:  one message at a time, with SHA-NI if the CPU has it
+*/
+
+enum Sha256BatchKernel
+{
+    SHA256_BATCH_KERNEL_AUTO = 0,
+    SHA256_BATCH_KERNEL_SINGLE,
+    SHA256_BATCH_KERNEL_AVX2,
+    SHA256_BATCH_KERNEL_AVX512
+};
+
+/**
+* W[i] + K[i] of the padding block
+*/
+inline const uint32_t *sha256_padding_512_round_words()
+{
+    struct Words
+    {
+        uint32_t WK[64];
+
+        Words()
+        {
+            sha256_message_schedule(WK, SHA256_PADDING_512);
+            for (size_t i = 0; i < 64; i++)
+            {
+                WK[i] += SHA256_K[i];
+            }
+        }
+    };
+    static const Words words;
+    return words.WK;
+}
+
+#if defined(MIXER_SHA256_X86)
+
+namespace sha256_avx2
+{
+
+static const size_t LANES = 8;
+
+template <int N>
+__attribute__((target("avx2"))) inline __m256i rotr(__m256i x)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+}
+
+/**
+* One compression function on every lane, W is NULL if K already includes the message schedule
+*/
+__attribute__((target("avx2"))) inline void compress(__m256i state[8], const __m256i *W, const uint32_t *K)
+{
+    __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        const __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr<6>(e), rotr<11>(e)), rotr<25>(e));
+        const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, _mm256_set1_epi32(K[i])));
+        if (W != nullptr)
+        {
+            temp1 = _mm256_add_epi32(temp1, W[i]);
+        }
+        const __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr<2>(a), rotr<13>(a)), rotr<22>(a));
+        const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(temp1, _mm256_add_epi32(S0, maj));
+    }
+
+    state[0] = _mm256_add_epi32(state[0], a);
+    state[1] = _mm256_add_epi32(state[1], b);
+    state[2] = _mm256_add_epi32(state[2], c);
+    state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e);
+    state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g);
+    state[7] = _mm256_add_epi32(state[7], h);
+}
+
+__attribute__((target("avx2"))) inline void chunk(const uint32_t *in_words, uint32_t *out_digests, size_t count)
+{
+    // Transpose so each word of the message is one vector, unused lanes hash zeros
+    alignas(32) uint32_t lanes[16][LANES] = {};
+    for (size_t l = 0; l < count; l++)
+    {
+        for (size_t j = 0; j < 16; j++)
+        {
+            lanes[j][l] = in_words[(16 * l) + j];
+        }
+    }
+
+    __m256i W[64];
+    for (size_t j = 0; j < 16; j++)
+    {
+        W[j] = _mm256_load_si256(reinterpret_cast<const __m256i *>(lanes[j]));
+    }
+    for (size_t i = 16; i < 64; i++)
+    {
+        const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr<7>(W[i - 15]), rotr<18>(W[i - 15])), _mm256_srli_epi32(W[i - 15], 3));
+        const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr<17>(W[i - 2]), rotr<19>(W[i - 2])), _mm256_srli_epi32(W[i - 2], 10));
+        W[i] = _mm256_add_epi32(_mm256_add_epi32(W[i - 16], s0), _mm256_add_epi32(W[i - 7], s1));
+    }
+
+    __m256i state[8];
+    for (size_t j = 0; j < 8; j++)
+    {
+        state[j] = _mm256_set1_epi32(SHA256_IV[j]);
+    }
+    compress(state, W, SHA256_K);
+    compress(state, nullptr, sha256_padding_512_round_words());
+
+    for (size_t j = 0; j < 8; j++)
+    {
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[j]), state[j]);
+    }
+    for (size_t l = 0; l < count; l++)
+    {
+        for (size_t j = 0; j < 8; j++)
+        {
+            out_digests[(8 * l) + j] = lanes[j][l];
+        }
+    }
+}
+
+} // namespace sha256_avx2
+
+namespace sha256_avx512
+{
+
+static const size_t LANES = 16;
+
+/**
+* One compression function on every lane, W is NULL if K already includes the message schedule
+*/
+__attribute__((target("avx512f"))) inline void compress(__m512i state[8], const __m512i *W, const uint32_t *K)
+{
+    __m512i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m512i e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        const __m512i S1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25), 0x96);
+        const __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+        __m512i temp1 = _mm512_add_epi32(_mm512_add_epi32(h, S1), _mm512_add_epi32(ch, _mm512_set1_epi32(K[i])));
+        if (W != nullptr)
+        {
+            temp1 = _mm512_add_epi32(temp1, W[i]);
+        }
+        const __m512i S0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22), 0x96);
+        const __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi32(temp1, _mm512_add_epi32(S0, maj));
+    }
+
+    state[0] = _mm512_add_epi32(state[0], a);
+    state[1] = _mm512_add_epi32(state[1], b);
+    state[2] = _mm512_add_epi32(state[2], c);
+    state[3] = _mm512_add_epi32(state[3], d);
+    state[4] = _mm512_add_epi32(state[4], e);
+    state[5] = _mm512_add_epi32(state[5], f);
+    state[6] = _mm512_add_epi32(state[6], g);
+    state[7] = _mm512_add_epi32(state[7], h);
+}
+
+__attribute__((target("avx512f"))) inline void chunk(const uint32_t *in_words, uint32_t *out_digests, size_t count)
+{
+    alignas(64) uint32_t lanes[16][LANES] = {};
+    for (size_t l = 0; l < count; l++)
+    {
+        for (size_t j = 0; j < 16; j++)
+        {
+            lanes[j][l] = in_words[(16 * l) + j];
+        }
+    }
+
+    __m512i W[64];
+    for (size_t j = 0; j < 16; j++)
+    {
+        W[j] = _mm512_load_si512(lanes[j]);
+    }
+    for (size_t i = 16; i < 64; i++)
+    {
+        const __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(W[i - 15], 7), _mm512_ror_epi32(W[i - 15], 18), _mm512_srli_epi32(W[i - 15], 3), 0x96);
+        const __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(W[i - 2], 17), _mm512_ror_epi32(W[i - 2], 19), _mm512_srli_epi32(W[i - 2], 10), 0x96);
+        W[i] = _mm512_add_epi32(_mm512_add_epi32(W[i - 16], s0), _mm512_add_epi32(W[i - 7], s1));
+    }
+
+    __m512i state[8];
+    for (size_t j = 0; j < 8; j++)
+    {
+        state[j] = _mm512_set1_epi32(SHA256_IV[j]);
+    }
+    compress(state, W, SHA256_K);
+    compress(state, nullptr, sha256_padding_512_round_words());
+
+    for (size_t j = 0; j < 8; j++)
+    {
+        _mm512_store_si512(lanes[j], state[j]);
+    }
+    for (size_t l = 0; l < count; l++)
+    {
+        for (size_t j = 0; j < 8; j++)
+        {
+            out_digests[(8 * l) + j] = lanes[j][l];
+        }
+    }
+}
+
+} // namespace sha256_avx512
+
+#endif // MIXER_SHA256_X86
+
+inline bool sha256_batch_kernel_supported(Sha256BatchKernel kernel)
+{
+    switch (kernel)
+    {
+    case SHA256_BATCH_KERNEL_AUTO:
+    case SHA256_BATCH_KERNEL_SINGLE:
+        return true;
+#if defined(MIXER_SHA256_X86)
+    case SHA256_BATCH_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    case SHA256_BATCH_KERNEL_AVX512:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+inline const char *sha256_batch_kernel_name(Sha256BatchKernel kernel)
+{
+    switch (kernel)
+    {
+    case SHA256_BATCH_KERNEL_SINGLE:
+        return "single";
+    case SHA256_BATCH_KERNEL_AVX2:
+        return "avx2";
+    case SHA256_BATCH_KERNEL_AVX512:
+        return "avx512";
+    default:
+        return "auto";
+    }
+}
+
+/**
+* Picks the widest kernel supported by the CPU, can be overridden with
+* the MIXER_SHA256_BATCH_KERNEL environment variable (single, avx2, avx512)
+*/
+inline Sha256BatchKernel sha256_batch_detect_kernel()
+{
+    const char *forced = ::getenv("MIXER_SHA256_BATCH_KERNEL");
+    if (forced != nullptr)
+    {
+        for (auto kernel : {SHA256_BATCH_KERNEL_SINGLE, SHA256_BATCH_KERNEL_AVX2, SHA256_BATCH_KERNEL_AVX512})
+        {
+            if (0 == ::strcmp(forced, sha256_batch_kernel_name(kernel)) && sha256_batch_kernel_supported(kernel))
+            {
+                return kernel;
+            }
+        }
+    }
+
+    if (sha256_batch_kernel_supported(SHA256_BATCH_KERNEL_AVX512))
+    {
+        return SHA256_BATCH_KERNEL_AVX512;
+    }
+    if (sha256_batch_kernel_supported(SHA256_BATCH_KERNEL_AVX2))
+    {
+        return SHA256_BATCH_KERNEL_AVX2;
+    }
+
+    return SHA256_BATCH_KERNEL_SINGLE;
+}
+
+inline size_t sha256_batch_lanes(Sha256BatchKernel kernel)
+{
+    switch (kernel)
+    {
+#if defined(MIXER_SHA256_X86)
+    case SHA256_BATCH_KERNEL_AVX2:
+        return sha256_avx2::LANES;
+    case SHA256_BATCH_KERNEL_AVX512:
+        return sha256_avx512::LANES;
+#endif
+    default:
+        return 1;
+    }
+}
+
+/**
+* out_digests[8 * i ...] = SHA256 of the 16 words in_words[16 * i ...], for i < n
+*/
+inline void sha256_batch_512(const uint32_t *in_words, uint32_t *out_digests, size_t n, Sha256BatchKernel kernel = SHA256_BATCH_KERNEL_AUTO)
+{
+    if (kernel == SHA256_BATCH_KERNEL_AUTO)
+    {
+        static const Sha256BatchKernel detected = sha256_batch_detect_kernel();
+        kernel = detected;
+    }
+
+    const size_t lanes = sha256_batch_lanes(kernel);
+    for (size_t offset = 0; offset < n; offset += lanes)
+    {
+        const size_t count = std::min(lanes, n - offset);
+        const uint32_t *words = in_words + (16 * offset);
+        uint32_t *digests = out_digests + (8 * offset);
+
+        switch (kernel)
+        {
+#if defined(MIXER_SHA256_X86)
+        case SHA256_BATCH_KERNEL_AVX2:
+            sha256_avx2::chunk(words, digests, count);
+            break;
+        case SHA256_BATCH_KERNEL_AVX512:
+            sha256_avx512::chunk(words, digests, count);
+            break;
+#endif
+        default:
+        {
+            uint8_t block[64];
+            for (size_t j = 0; j < 16; j++)
+            {
+                sha256_store_be32(block + (4 * j), words[j]);
+            }
+
+            Sha256Trace input_trace, padding_trace;
+            sha256_compress_trace(SHA256_IV, block, input_trace);
+            sha256_compress_trace(input_trace.H, SHA256_PADDING_512, padding_trace);
+            std::memcpy(digests, padding_trace.H, sizeof(padding_trace.H));
+            break;
+        }
+        }
+    }
+}
+
+} // namespace native
+
+} // namespace ethsnarks
+
+#endif // MIXER_NATIVE_SHA256_BATCH_HPP_
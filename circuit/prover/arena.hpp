@@ -0,0 +1,77 @@
+#ifndef MIXER_PROVER_ARENA_HPP_
+#define MIXER_PROVER_ARENA_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* The prover's buffers are kept from one proof to the next, in the objects
+* which use them, instead of being allocated by every call: they're only
+* allocated when they need to grow, which after the first proof with a
+* context is never. Growing them goes through the `arena_*` functions, so
+* that the heap allocations they make are counted.
+*/
+
+/**
+* Heap allocations made by growing buffers, and the bytes the buffers hold
+*/
+struct ArenaCounters
+{
+    std::atomic<size_t> allocations;
+    std::atomic<size_t> bytes;
+
+    ArenaCounters() : allocations(0), bytes(0)
+    {
+    }
+};
+
+/**
+* Capacity for at least n elements, counted in `counters` (when not null)
+* if it has to grow. It grows an eighth more than needed, so buffers whose
+* size depends a little on the witness, such as the terms of each thread,
+* settle after the first proof.
+*/
+template <typename T>
+void arena_reserve(std::vector<T> &buffer, size_t n, ArenaCounters *counters)
+{
+    if (n <= buffer.capacity())
+    {
+        return;
+    }
+    const size_t capacity = n + (n / 8);
+    if (counters != nullptr)
+    {
+        counters->allocations++;
+        counters->bytes += (capacity - buffer.capacity()) * sizeof(T);
+    }
+    buffer.reserve(capacity);
+}
+
+template <typename T>
+T *arena_resize(std::vector<T> &buffer, size_t n, ArenaCounters *counters)
+{
+    arena_reserve(buffer, n, counters);
+    buffer.resize(n);
+    return buffer.data();
+}
+
+template <typename T>
+T *arena_assign(std::vector<T> &buffer, size_t n, const T &value, ArenaCounters *counters)
+{
+    arena_reserve(buffer, n, counters);
+    buffer.assign(n, value);
+    return buffer.data();
+}
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_ARENA_HPP_
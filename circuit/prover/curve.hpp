@@ -0,0 +1,400 @@
+#ifndef MIXER_PROVER_CURVE_HPP_
+#define MIXER_PROVER_CURVE_HPP_
+
+#include <cstddef>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* Point arithmetic for the prover's multi-scalar multiplications, generic
+* over the coordinate field so the same code handles G1 (over Fq) and G2
+* (over Fq2). Both BN254 groups are y^2 = x^3 + b, so a = 0 throughout.
+*
+* Points are converted from and to libff's types only at the boundaries,
+* libff's alt_bn128 points use the same Jacobian coordinates as here:
+* (X : Y : Z) = (X/Z^2, Y/Z^3).
+*/
+
+typedef libff::alt_bn128_Fq FqT;
+typedef libff::alt_bn128_Fq2 Fq2T;
+typedef libff::alt_bn128_G1 G1T;
+typedef libff::alt_bn128_G2 G2T;
+
+typedef libff::bigint<FieldT::num_limbs> ScalarT;
+
+/**
+* Affine point, (0, 0) isn't on either curve so it represents infinity
+*/
+template <typename F>
+struct AffinePoint
+{
+    F x;
+    F y;
+
+    static AffinePoint zero()
+    {
+        return AffinePoint{F::zero(), F::zero()};
+    }
+
+    bool is_zero() const
+    {
+        return x.is_zero() && y.is_zero();
+    }
+
+    AffinePoint operator-() const
+    {
+        return is_zero() ? *this : AffinePoint{x, -y};
+    }
+
+    bool operator==(const AffinePoint &other) const
+    {
+        return x == other.x && y == other.y;
+    }
+};
+
+template <typename F>
+struct JacobianPoint
+{
+    F X;
+    F Y;
+    F Z;
+
+    static JacobianPoint zero()
+    {
+        return JacobianPoint{F::one(), F::one(), F::zero()};
+    }
+
+    static JacobianPoint from_affine(const AffinePoint<F> &p)
+    {
+        return p.is_zero() ? zero() : JacobianPoint{p.x, p.y, F::one()};
+    }
+
+    bool is_zero() const
+    {
+        return Z.is_zero();
+    }
+
+    JacobianPoint operator-() const
+    {
+        return JacobianPoint{X, -Y, Z};
+    }
+
+    // dbl-2009-l
+    JacobianPoint dbl() const
+    {
+        if (is_zero())
+        {
+            return *this;
+        }
+
+        const F A = X.squared();
+        const F B = Y.squared();
+        const F C = B.squared();
+        F D = (X + B).squared() - A - C;
+        D = D + D;
+        const F E = A + A + A;
+        const F F_ = E.squared();
+        const F X3 = F_ - (D + D);
+        F C8 = C + C;
+        C8 = C8 + C8;
+        C8 = C8 + C8;
+        const F Y3 = E * (D - X3) - C8;
+        const F YZ = Y * Z;
+        return JacobianPoint{X3, Y3, YZ + YZ};
+    }
+
+    // madd-2007-bl
+    JacobianPoint mixed_add(const AffinePoint<F> &other) const
+    {
+        if (other.is_zero())
+        {
+            return *this;
+        }
+        if (is_zero())
+        {
+            return from_affine(other);
+        }
+
+        const F Z1Z1 = Z.squared();
+        const F U2 = other.x * Z1Z1;
+        const F S2 = other.y * Z * Z1Z1;
+        const F H = U2 - X;
+        F r = S2 - Y;
+        if (H.is_zero())
+        {
+            return r.is_zero() ? dbl() : zero();
+        }
+        r = r + r;
+
+        const F HH = H.squared();
+        F I = HH + HH;
+        I = I + I;
+        const F J = H * I;
+        const F V = X * I;
+        const F X3 = r.squared() - J - (V + V);
+        const F YJ = Y * J;
+        const F Y3 = r * (V - X3) - (YJ + YJ);
+        const F Z3 = (Z + H).squared() - Z1Z1 - HH;
+        return JacobianPoint{X3, Y3, Z3};
+    }
+
+    // add-2007-bl
+    JacobianPoint operator+(const JacobianPoint &other) const
+    {
+        if (other.is_zero())
+        {
+            return *this;
+        }
+        if (is_zero())
+        {
+            return other;
+        }
+
+        const F Z1Z1 = Z.squared();
+        const F Z2Z2 = other.Z.squared();
+        const F U1 = X * Z2Z2;
+        const F U2 = other.X * Z1Z1;
+        const F S1 = Y * other.Z * Z2Z2;
+        const F S2 = other.Y * Z * Z1Z1;
+        const F H = U2 - U1;
+        F r = S2 - S1;
+        if (H.is_zero())
+        {
+            return r.is_zero() ? dbl() : zero();
+        }
+        r = r + r;
+
+        const F H2 = H + H;
+        const F I = H2.squared();
+        const F J = H * I;
+        const F V = U1 * I;
+        const F X3 = r.squared() - J - (V + V);
+        const F S1J = S1 * J;
+        const F Y3 = r * (V - X3) - (S1J + S1J);
+        const F Z3 = ((Z + other.Z).squared() - Z1Z1 - Z2Z2) * H;
+        return JacobianPoint{X3, Y3, Z3};
+    }
+
+    JacobianPoint &operator+=(const JacobianPoint &other)
+    {
+        return *this = *this + other;
+    }
+};
+
+/**
+* Montgomery's trick, replaces every non-zero value with its inverse using
+* a single field inversion. `scratch` must hold `n` elements.
+*/
+template <typename F>
+void batch_invert(F *values, size_t n, F *scratch)
+{
+    F acc = F::one();
+    for (size_t i = 0; i < n; i++)
+    {
+        scratch[i] = acc;
+        if (!values[i].is_zero())
+        {
+            acc = acc * values[i];
+        }
+    }
+
+    acc = acc.inverse();
+
+    for (size_t i = n; i-- > 0;)
+    {
+        if (!values[i].is_zero())
+        {
+            const F inverse = acc * scratch[i];
+            acc = acc * values[i];
+            values[i] = inverse;
+        }
+    }
+}
+
+/**
+* Denominator of the slope for the affine addition a + b, to be inverted
+* with others in a batch. It's 0 when the sum needs no inversion, because
+* either point is zero or they cancel.
+*/
+template <typename F>
+F affine_add_denominator(const AffinePoint<F> &a, const AffinePoint<F> &b)
+{
+    if (a.is_zero() || b.is_zero())
+    {
+        return F::zero();
+    }
+    if (!(a.x == b.x))
+    {
+        return b.x - a.x;
+    }
+    if (a.y == b.y)
+    {
+        return a.y + a.y;
+    }
+    return F::zero();
+}
+
+/**
+* a += b, given the inverse of `affine_add_denominator(a, b)`
+*/
+template <typename F>
+void affine_add_with_inverse(AffinePoint<F> &a, const AffinePoint<F> &b, const F &inverse)
+{
+    if (b.is_zero())
+    {
+        return;
+    }
+    if (a.is_zero())
+    {
+        a = b;
+        return;
+    }
+
+    F lambda;
+    if (!(a.x == b.x))
+    {
+        lambda = (b.y - a.y) * inverse;
+    }
+    else if (a.y == b.y)
+    {
+        const F x2 = a.x.squared();
+        lambda = (x2 + x2 + x2) * inverse;
+    }
+    else
+    {
+        a = AffinePoint<F>::zero();
+        return;
+    }
+
+    const F x3 = lambda.squared() - a.x - b.x;
+    a.y = lambda * (a.x - x3) - a.y;
+    a.x = x3;
+}
+
+/**
+* Converts many Jacobian points to affine with one field inversion
+*/
+template <typename F>
+void batch_normalize(const JacobianPoint<F> *in, AffinePoint<F> *out, size_t n)
+{
+    std::vector<F> z_inverses(n);
+    std::vector<F> scratch(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        z_inverses[i] = in[i].Z;
+    }
+    batch_invert(z_inverses.data(), n, scratch.data());
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (in[i].is_zero())
+        {
+            out[i] = AffinePoint<F>::zero();
+            continue;
+        }
+        const F z_inv2 = z_inverses[i].squared();
+        out[i] = AffinePoint<F>{in[i].X * z_inv2, in[i].Y * z_inv2 * z_inverses[i]};
+    }
+}
+
+/**
+* Points of a libff group type in affine form, most proving key points are
+* already affine (Z = 1) after deserialization, the rest share one inversion
+*/
+template <typename GroupT, typename F>
+void to_affine(const std::vector<GroupT> &in, std::vector<AffinePoint<F>> &out)
+{
+    out.resize(in.size());
+
+    std::vector<JacobianPoint<F>> projective;
+    std::vector<size_t> projective_indices;
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        const auto &p = in[i];
+        if (p.is_zero())
+        {
+            out[i] = AffinePoint<F>::zero();
+        }
+        else if (p.Z == F::one())
+        {
+            out[i] = AffinePoint<F>{p.X, p.Y};
+        }
+        else
+        {
+            projective.push_back(JacobianPoint<F>{p.X, p.Y, p.Z});
+            projective_indices.push_back(i);
+        }
+    }
+
+    std::vector<AffinePoint<F>> normalized(projective.size());
+    batch_normalize(projective.data(), normalized.data(), projective.size());
+    for (size_t i = 0; i < projective.size(); i++)
+    {
+        out[projective_indices[i]] = normalized[i];
+    }
+}
+
+inline JacobianPoint<FqT> from_libff(const G1T &p)
+{
+    return p.is_zero() ? JacobianPoint<FqT>::zero() : JacobianPoint<FqT>{p.X, p.Y, p.Z};
+}
+
+inline JacobianPoint<Fq2T> from_libff(const G2T &p)
+{
+    return p.is_zero() ? JacobianPoint<Fq2T>::zero() : JacobianPoint<Fq2T>{p.X, p.Y, p.Z};
+}
+
+inline G1T to_libff(const JacobianPoint<FqT> &p)
+{
+    return p.is_zero() ? G1T::zero() : G1T(p.X, p.Y, p.Z);
+}
+
+inline G2T to_libff(const JacobianPoint<Fq2T> &p)
+{
+    return p.is_zero() ? G2T::zero() : G2T(p.X, p.Y, p.Z);
+}
+
+/**
+* Canonical (non-Montgomery) form of field elements, as used for scalar recoding
+*/
+inline void to_scalars(const FieldT *in, size_t n, std::vector<ScalarT> &out)
+{
+    out.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = in[i].as_bigint();
+    }
+}
+
+/**
+* `width` bits of `scalar` starting at bit `offset`, width <= 32
+*/
+inline uint32_t scalar_window(const ScalarT &scalar, size_t offset, size_t width)
+{
+    const size_t limb = offset / 64;
+    const size_t shift = offset % 64;
+    if (limb >= ScalarT::N)
+    {
+        return 0;
+    }
+
+    uint64_t bits = scalar.data[limb] >> shift;
+    if (shift + width > 64 && (limb + 1) < ScalarT::N)
+    {
+        bits |= scalar.data[limb + 1] << (64 - shift);
+    }
+    return (uint32_t)(bits & ((uint64_t(1) << width) - 1));
+}
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_CURVE_HPP_
@@ -0,0 +1,260 @@
+#ifndef MIXER_PROVER_FIXED_BASE_HPP_
+#define MIXER_PROVER_FIXED_BASE_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "prover/curve.hpp"
+#include "prover/glv.hpp"
+#include "prover/msm.hpp"
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* Precomputed multiples of a fixed set of bases, for multi-scalar
+* multiplications against the same bases with different scalars.
+*
+* For every base P the table holds the affine points 2^(window * j) * P,
+* one row for each signed digit j of a scalar. A multi-scalar
+* multiplication then adds each row into the bucket of its digit and
+* combines the buckets once, without any doublings, compared to the
+* bucket method's doublings and bucket combination for every window.
+*
+* Memory is `rows` points per base: fewer rows are stored by passing a
+* lower `max_rows`, the digits are then handled in several passes which
+* each combine their buckets and are joined by `window * rows` doublings
+* of the result. With a single row this is the plain bucket method.
+*
+* With the endomorphism the rows only cover the 128 bit halves of the GLV
+* decomposition, the table is half the size and the second half of each
+* scalar adds phi of the same points (one multiplication per addition).
+*/
+template <typename F>
+class FixedBaseTable
+{
+public:
+    FixedBaseTable() : m_window(0),
+                       m_rows(0),
+                       m_size(0),
+                       m_endomorphism(false)
+    {
+    }
+
+    /**
+    * `max_rows` is 0 for every digit of a scalar to be a lookup
+    */
+    void build(const std::vector<AffinePoint<F>> &bases, size_t window, size_t max_rows, size_t n_threads, bool use_endomorphism = true)
+    {
+        m_endomorphism = use_endomorphism;
+        const size_t n_digits = signed_digits_count(window, scalar_bits());
+
+        m_window = window;
+        m_rows = (max_rows == 0) ? n_digits : std::min(max_rows, n_digits);
+        m_size = bases.size();
+        m_points.resize(m_size * m_rows);
+
+        // Normalized in blocks of bases, to share the field inversions without doubling the memory
+        static const size_t BLOCK_SIZE = 1024;
+        parallel_ranges(m_size, n_threads, [this, &bases](size_t begin, size_t end, size_t) {
+            std::vector<JacobianPoint<F>> rows(BLOCK_SIZE * m_rows);
+            for (size_t block = begin; block < end; block += BLOCK_SIZE)
+            {
+                const size_t block_end = std::min(end, block + BLOCK_SIZE);
+                for (size_t i = block; i < block_end; i++)
+                {
+                    JacobianPoint<F> point = JacobianPoint<F>::from_affine(bases[i]);
+                    for (size_t j = 0; j < m_rows; j++)
+                    {
+                        rows[((i - block) * m_rows) + j] = point;
+                        for (size_t k = 0; k < m_window; k++)
+                        {
+                            point = point.dbl();
+                        }
+                    }
+                }
+                batch_normalize(rows.data(), &m_points[block * m_rows], (block_end - block) * m_rows);
+            }
+        });
+    }
+
+    void clear()
+    {
+        m_window = m_rows = m_size = 0;
+        m_endomorphism = false;
+        std::vector<AffinePoint<F>>().swap(m_points);
+    }
+
+    bool empty() const
+    {
+        return m_points.empty();
+    }
+
+    // Number of bases
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    size_t window() const
+    {
+        return m_window;
+    }
+
+    size_t rows() const
+    {
+        return m_rows;
+    }
+
+    bool uses_endomorphism() const
+    {
+        return m_endomorphism;
+    }
+
+    size_t memory_size() const
+    {
+        return m_points.size() * sizeof(AffinePoint<F>);
+    }
+
+    const AffinePoint<F> &base(size_t i) const
+    {
+        return m_points[i * m_rows];
+    }
+
+    /**
+    * Sum of scalars[i] * base(i) for i = indices[k], k < n. The scalars must
+    * not be zero. The buckets and digits are kept in `workspace`, if given.
+    */
+    JacobianPoint<F> multi_exp(const ScalarT *scalars, const uint32_t *indices, size_t n, size_t n_threads, MsmWorkspace<F> *workspace = nullptr) const
+    {
+        if (n_threads == 0)
+        {
+            n_threads = default_threads();
+        }
+
+        MsmWorkspace<F> local_workspace;
+        MsmWorkspace<F> &ws = (workspace != nullptr) ? *workspace : local_workspace;
+        ws.prepare(n_threads);
+        parallel_ranges(n, n_threads, [this, scalars, indices, &ws](size_t begin, size_t end, size_t thread_index) {
+            ws.partial_sums()[thread_index] = multi_exp_range(scalars, indices + begin, end - begin, ws.thread(thread_index));
+        });
+        return ws.total();
+    }
+
+    /**
+    * Raw table, in the in-memory representation of the field elements
+    */
+    bool write(std::ostream &out) const
+    {
+        const uint64_t header[4] = {m_window, m_rows, m_size, m_endomorphism};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(m_points.data()), memory_size());
+        return out.good();
+    }
+
+    bool read(std::istream &in)
+    {
+        uint64_t header[4];
+        if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] < 2 || header[0] > 24 || header[3] > 1 || header[1] == 0 || header[1] > signed_digits_count(header[0], header[3] ? GLV_SCALAR_BITS : size_t(FieldT::num_bits)))
+        {
+            return false;
+        }
+
+        m_endomorphism = header[3] != 0;
+        m_window = header[0];
+        m_rows = header[1];
+        m_size = header[2];
+        m_points.resize(m_size * m_rows);
+        if (!in.read(reinterpret_cast<char *>(m_points.data()), memory_size()))
+        {
+            clear();
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    size_t scalar_bits() const
+    {
+        return m_endomorphism ? GLV_SCALAR_BITS : size_t(FieldT::num_bits);
+    }
+
+    JacobianPoint<F> multi_exp_range(const ScalarT *scalars, const uint32_t *indices, size_t n, MsmScratch<F> &scratch) const
+    {
+        const size_t n_digits = signed_digits_count(m_window, scalar_bits());
+        const size_t n_passes = (n_digits + m_rows - 1) / m_rows;
+
+        Buckets<F> &buckets = scratch.buckets;
+        buckets.reset(m_window, scratch.counters);
+        int32_t *digits = arena_resize(scratch.digits, n_digits, scratch.counters);
+        int32_t *endomorphism_digits = arena_resize(scratch.endomorphism_digits, n_digits, scratch.counters);
+        JacobianPoint<F> result = JacobianPoint<F>::zero();
+        for (size_t pass = n_passes; pass-- > 0;)
+        {
+            for (size_t k = 0; k < (m_window * m_rows) && !result.is_zero(); k++)
+            {
+                result = result.dbl();
+            }
+
+            const size_t first_digit = pass * m_rows;
+            const size_t pass_rows = std::min(m_rows, n_digits - first_digit);
+            for (size_t k = 0; k < n; k++)
+            {
+                assert(indices[k] < m_size);
+                const AffinePoint<F> *row = &m_points[indices[k] * m_rows];
+
+                if (!m_endomorphism)
+                {
+                    signed_digits(scalars[indices[k]], m_window, digits, n_digits);
+                    for (size_t j = 0; j < pass_rows; j++)
+                    {
+                        buckets.add(digits[first_digit + j], row[j]);
+                    }
+                    continue;
+                }
+
+                // The halves' signs go to their digits
+                GlvScalar halves;
+                glv_decompose(scalars[indices[k]], halves);
+                signed_digits(halves.k1, m_window, digits, n_digits);
+                signed_digits(halves.k2, m_window, endomorphism_digits, n_digits);
+                for (size_t j = 0; j < pass_rows; j++)
+                {
+                    const int32_t digit = digits[first_digit + j];
+                    const int32_t endomorphism_digit = endomorphism_digits[first_digit + j];
+                    buckets.add(halves.k1_negative ? -digit : digit, row[j]);
+                    if (endomorphism_digit != 0)
+                    {
+                        buckets.add(halves.k2_negative ? -endomorphism_digit : endomorphism_digit, endomorphism(row[j]));
+                    }
+                }
+            }
+
+            result += buckets.reduce();
+        }
+
+        return result;
+    }
+
+    size_t m_window;
+    size_t m_rows;
+    size_t m_size;
+    bool m_endomorphism;
+
+    // m_points[(i * m_rows) + j] = 2^(m_window * j) * base i
+    std::vector<AffinePoint<F>> m_points;
+};
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_FIXED_BASE_HPP_
@@ -0,0 +1,344 @@
+#ifndef MIXER_PROVER_GLV_HPP_
+#define MIXER_PROVER_GLV_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+#include "prover/curve.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* GLV endomorphism for BN254. Both G1 and G2 are on curves y^2 = x^3 + b
+* over fields which contain a cube root of unity beta, so
+* phi(x, y) = (beta * x, y) is an endomorphism. On the prime order
+* subgroups it multiplies by a cube root of unity lambda mod r.
+*
+* A scalar k is split into k1 + k2 * lambda with |k1| and |k2| below 2^128,
+* so k * P = k1 * P + k2 * phi(P) needs half the windows or doublings of
+* the full scalar. The split uses the short basis (a1, b1), (a2, b2) of the
+* lattice {(x, y) : x + y * lambda = 0 mod r}, rounding k * b / r through
+* the precomputed g = 2^256 * b / r (Gallant, Lambert and Vanstone,
+* "Faster Point Multiplication on Elliptic Curves with Efficient
+* Endomorphisms", section 4).
+*
+* lambda = 4407920970296243842393367215006156084916469457145843978461, the
+* matching beta differs between the two groups.
+*/
+
+static const size_t GLV_SCALAR_BITS = 128;
+
+/**
+* k = k1 + k2 * lambda (mod r), the halves as sign and magnitude
+*/
+struct GlvScalar
+{
+    ScalarT k1;
+    ScalarT k2;
+    bool k1_negative;
+    bool k2_negative;
+};
+
+namespace glv
+{
+
+static const size_t N = 4;
+
+// G_B2 = 2^256 * b2 / r and G_MINUS_B1 = 2^256 * -b1 / r, rounded down
+static const uint64_t G_B2[2] = {0xd91d232ec7e0b3d7ULL, 0x0000000000000002ULL};
+static const uint64_t G_MINUS_B1[3] = {0x7a7bd9d4391eb18dULL, 0x4ccef014a773d2cfULL, 0x0000000000000002ULL};
+static const uint64_t A1[1] = {0x89d3256894d213e3ULL};
+static const uint64_t MINUS_B1[2] = {0x8211bbeb7d4f1128ULL, 0x6f4d8248eeb859fcULL};
+static const uint64_t A2[2] = {0x0be4e1541221250bULL, 0x6f4d8248eeb859fdULL};
+static const uint64_t B2[1] = {0x89d3256894d213e3ULL};
+
+/**
+* out = a * b mod 2^256
+*/
+inline void mul(const uint64_t *a, size_t a_limbs, const uint64_t *b, size_t b_limbs, uint64_t *out)
+{
+    uint64_t product[2 * N] = {0};
+    for (size_t i = 0; i < a_limbs; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b_limbs; j++)
+        {
+            const unsigned __int128 t = ((unsigned __int128)a[i] * b[j]) + product[i + j] + carry;
+            product[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        product[i + b_limbs] = carry;
+    }
+    ::memcpy(out, product, N * sizeof(uint64_t));
+}
+
+/**
+* floor(k * g / 2^256), k has N limbs
+*/
+inline void mul_high(const uint64_t *k, const uint64_t *g, size_t g_limbs, uint64_t *out)
+{
+    uint64_t product[2 * N] = {0};
+    for (size_t i = 0; i < N; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < g_limbs; j++)
+        {
+            const unsigned __int128 t = ((unsigned __int128)k[i] * g[j]) + product[i + j] + carry;
+            product[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        product[i + g_limbs] = carry;
+    }
+    ::memcpy(out, product + N, N * sizeof(uint64_t));
+}
+
+// a -= b mod 2^256
+inline void sub(uint64_t *a, const uint64_t *b)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+        const unsigned __int128 t = (unsigned __int128)a[i] - b[i] - borrow;
+        a[i] = (uint64_t)t;
+        borrow = (uint64_t)(t >> 64) & 1;
+    }
+}
+
+// Magnitude of a two's complement value into `out`, returns its sign
+inline bool abs(const uint64_t *a, ScalarT &out)
+{
+    const uint64_t sign = a[N - 1] >> 63;
+    const uint64_t mask = 0 - sign;
+    uint64_t carry = sign;
+    for (size_t i = 0; i < N; i++)
+    {
+        const unsigned __int128 t = (unsigned __int128)(a[i] ^ mask) + carry;
+        out.data[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
+    return sign != 0;
+}
+
+} // namespace glv
+
+/**
+* Splits a scalar below r, the same operations run for every scalar
+*/
+inline void glv_decompose(const ScalarT &k, GlvScalar &out)
+{
+    using namespace glv;
+    static_assert(ScalarT::N == N, "BN254 scalars have 4 limbs");
+
+    uint64_t c1[N], c2[N];
+    mul_high(k.data, G_B2, 2, c1);
+    mul_high(k.data, G_MINUS_B1, 3, c2);
+
+    // k1 = k - c1 * a1 - c2 * a2
+    uint64_t k1[N], t[N];
+    ::memcpy(k1, k.data, sizeof(k1));
+    mul(c1, 1, A1, 1, t);
+    sub(k1, t);
+    mul(c2, 2, A2, 2, t);
+    sub(k1, t);
+
+    // k2 = -c1 * b1 - c2 * b2
+    uint64_t k2[N];
+    mul(c1, 1, MINUS_B1, 2, k2);
+    mul(c2, 2, B2, 1, t);
+    sub(k2, t);
+
+    out.k1_negative = glv::abs(k1, out.k1);
+    out.k2_negative = glv::abs(k2, out.k2);
+}
+
+inline const FqT &glv_beta_G1()
+{
+    static const FqT beta(libff::bigint<FqT::num_limbs>("2203960485148121921418603742825762020974279258880205651966"));
+    return beta;
+}
+
+inline const FqT &glv_beta_G2()
+{
+    static const FqT beta(libff::bigint<FqT::num_limbs>("21888242871839275220042445260109153167277707414472061641714758635765020556616"));
+    return beta;
+}
+
+/**
+* phi(P) = lambda * P
+*/
+inline AffinePoint<FqT> endomorphism(const AffinePoint<FqT> &p)
+{
+    return AffinePoint<FqT>{glv_beta_G1() * p.x, p.y};
+}
+
+inline AffinePoint<Fq2T> endomorphism(const AffinePoint<Fq2T> &p)
+{
+    const FqT &beta = glv_beta_G2();
+    return AffinePoint<Fq2T>{Fq2T(beta * p.x.c0, beta * p.x.c1), p.y};
+}
+
+// x = X / Z^2, so scaling X scales x
+inline JacobianPoint<FqT> endomorphism(const JacobianPoint<FqT> &p)
+{
+    return JacobianPoint<FqT>{glv_beta_G1() * p.X, p.Y, p.Z};
+}
+
+inline JacobianPoint<Fq2T> endomorphism(const JacobianPoint<Fq2T> &p)
+{
+    const FqT &beta = glv_beta_G2();
+    return JacobianPoint<Fq2T>{Fq2T(beta * p.X.c0, beta * p.X.c1), p.Y, p.Z};
+}
+
+/*
+* Constant time scalar multiplication, for the prover's secret r and s.
+*
+* Each GLV half is made odd, recoded into odd signed digits of
+* CT_WINDOW bits which are never zero, and every digit looks up its
+* multiple of the point by scanning the whole table. No branch or memory
+* access depends on the scalar, except for the exceptional cases of the
+* addition formulas which random scalars hit with negligible probability.
+*/
+
+static const size_t CT_WINDOW = 4;
+static const size_t CT_TABLE_SIZE = size_t(1) << (CT_WINDOW - 1);
+static const size_t CT_DIGITS = GLV_SCALAR_BITS / CT_WINDOW;
+
+/**
+* out = a if `select` is 1, unchanged if it's 0, without branching on it
+*/
+template <typename T>
+void ct_assign(T &out, const T &a, uint64_t select)
+{
+    static_assert(sizeof(T) % sizeof(uint64_t) == 0, "assigned word by word");
+    const uint64_t mask = 0 - select;
+    uint64_t *out_words = reinterpret_cast<uint64_t *>(&out);
+    const uint64_t *a_words = reinterpret_cast<const uint64_t *>(&a);
+    for (size_t i = 0; i < sizeof(T) / sizeof(uint64_t); i++)
+    {
+        out_words[i] ^= mask & (out_words[i] ^ a_words[i]);
+    }
+}
+
+/**
+* Odd signed digits of an odd scalar below 2^GLV_SCALAR_BITS + 1: `digits`
+* gets CT_DIGITS digits in (-2^CT_WINDOW, 2^CT_WINDOW), least significant
+* first, and the return value is the top digit, which is positive
+*/
+inline int32_t ct_odd_digits(const ScalarT &scalar, int32_t *digits)
+{
+    // Three limbs hold the scalar while it's shifted down
+    uint64_t k[3] = {scalar.data[0], scalar.data[1], scalar.data[2]};
+    for (size_t i = 0; i < CT_DIGITS; i++)
+    {
+        const int64_t digit = (int64_t)(k[0] & ((uint64_t(1) << (CT_WINDOW + 1)) - 1)) - (int64_t(1) << CT_WINDOW);
+        digits[i] = (int32_t)digit;
+
+        // k = (k - digit) >> CT_WINDOW
+        const uint64_t minus_digit = (uint64_t)(-digit);
+        const uint64_t extension = (uint64_t)((-digit) >> 63);
+        unsigned __int128 t = (unsigned __int128)k[0] + minus_digit;
+        k[0] = (uint64_t)t;
+        t = (unsigned __int128)k[1] + extension + (uint64_t)(t >> 64);
+        k[1] = (uint64_t)t;
+        k[2] = k[2] + extension + (uint64_t)(t >> 64);
+
+        k[0] = (k[0] >> CT_WINDOW) | (k[1] << (64 - CT_WINDOW));
+        k[1] = (k[1] >> CT_WINDOW) | (k[2] << (64 - CT_WINDOW));
+        k[2] = k[2] >> CT_WINDOW;
+    }
+    return (int32_t)k[0];
+}
+
+/**
+* out = sign(digit) * table[(|digit| - 1) / 2], reading every entry of the table
+*/
+template <typename F>
+void ct_lookup(const JacobianPoint<F> *table, int32_t digit, JacobianPoint<F> &out)
+{
+    const uint32_t negative = (uint32_t)digit >> 31;
+    const uint32_t magnitude = ((uint32_t)digit ^ (0 - negative)) + negative;
+    const uint32_t index = (magnitude - 1) >> 1;
+
+    out = table[0];
+    for (size_t i = 1; i < CT_TABLE_SIZE; i++)
+    {
+        const uint64_t difference = i ^ index;
+        ct_assign(out, table[i], ((difference | (0 - difference)) >> 63) ^ 1);
+    }
+
+    const F minus_Y = -out.Y;
+    ct_assign(out.Y, minus_Y, negative);
+}
+
+/**
+* scalar * p for a secret scalar, below r
+*/
+template <typename F>
+JacobianPoint<F> ct_mul(const JacobianPoint<F> &p, const ScalarT &scalar)
+{
+    GlvScalar halves;
+    glv_decompose(scalar, halves);
+
+    // The signs of the halves go to the bases, k1 * P1 + k2 * P2 for non-negative k1 and k2
+    JacobianPoint<F> bases[2] = {p, endomorphism(p)};
+    ScalarT magnitudes[2] = {halves.k1, halves.k2};
+    const uint64_t negative[2] = {halves.k1_negative, halves.k2_negative};
+    uint64_t even[2];
+
+    JacobianPoint<F> tables[2][CT_TABLE_SIZE];
+    int32_t digits[2][CT_DIGITS];
+    int32_t top_digits[2];
+    for (size_t h = 0; h < 2; h++)
+    {
+        const F minus_Y = -bases[h].Y;
+        ct_assign(bases[h].Y, minus_Y, negative[h]);
+
+        // An even half is made odd, and the base subtracted again at the end
+        even[h] = (magnitudes[h].data[0] & 1) ^ 1;
+        magnitudes[h].data[0] |= 1;
+
+        // table[i] = (2i + 1) * base
+        const JacobianPoint<F> twice = bases[h].dbl();
+        tables[h][0] = bases[h];
+        for (size_t i = 1; i < CT_TABLE_SIZE; i++)
+        {
+            tables[h][i] = tables[h][i - 1] + twice;
+        }
+
+        top_digits[h] = ct_odd_digits(magnitudes[h], digits[h]);
+    }
+
+    JacobianPoint<F> result, addend;
+    ct_lookup(tables[0], top_digits[0], result);
+    ct_lookup(tables[1], top_digits[1], addend);
+    result += addend;
+    for (size_t i = CT_DIGITS; i-- > 0;)
+    {
+        for (size_t j = 0; j < CT_WINDOW; j++)
+        {
+            result = result.dbl();
+        }
+        ct_lookup(tables[0], digits[0][i], addend);
+        result += addend;
+        ct_lookup(tables[1], digits[1][i], addend);
+        result += addend;
+    }
+
+    for (size_t h = 0; h < 2; h++)
+    {
+        const JacobianPoint<F> corrected = result + (-bases[h]);
+        ct_assign(result, corrected, even[h]);
+    }
+
+    return result;
+}
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_GLV_HPP_
@@ -0,0 +1,981 @@
+#ifndef MIXER_PROVER_GROTH16_HPP_
+#define MIXER_PROVER_GROTH16_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+#include "prover/arena.hpp"
+#include "prover/curve.hpp"
+#include "prover/fixed_base.hpp"
+#include "prover/glv.hpp"
+#include "prover/msm.hpp"
+#include "prover/parallel.hpp"
+#include "prover/qap.hpp"
+#include "prover/witness.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* Groth16 prover for `r1cs_gg_ppzksnark_zok` proving keys, computes the
+* same proofs as libsnark's `r1cs_gg_ppzksnark_zok_prover` but keeps state
+* which only depends on the key between proofs.
+*
+* The multi-scalar multiplications over the A, B, H and L queries use the
+* batch-affine bucket method (see `pippenger_msm`) over affine copies of the
+* bases. The assignment is classified once per proof (see `Witness`), so
+* zero scalars are skipped and scalars which are 1 only add their base.
+* The bases never change, so they can also be expanded into fixed-base
+* tables once (see `FixedBaseTable`), either at key load or from a sidecar
+* file saved by `save_tables`. Both split scalars with the GLV endomorphism
+* unless it's turned off.
+*
+* The multiplications by the secret r and s are constant time (`ct_mul`).
+*
+* H's coefficients come from `QapWitnessMap` when it supports the
+* constraint system's evaluation domain, otherwise from libsnark.
+*
+* The sums over variables which are known before the rest of the witness
+* can be computed then (see `PartialSums`), and a proof given them only
+* computes the sums over the others. Likewise a proof of an assignment
+* close to a previous one only computes the sums over what changed, and a
+* pipelined proof computes them while the rest of the witness is generated.
+*
+* The buffers of a proof's stages can be kept in a `ProverArena` from one
+* proof to the next, then repeated proofs don't allocate them again.
+*/
+
+static const char FIXED_BASE_TABLES_MAGIC[8] = {'M', 'I', 'X', 'F', 'B', 'T', '\0', '\0'};
+static const uint32_t FIXED_BASE_TABLES_VERSION = 2;
+
+static const char PARTIAL_SUMS_MAGIC[8] = {'M', 'I', 'X', 'P', 'S', 'U', 'M', '\0'};
+static const uint32_t PARTIAL_SUMS_VERSION = 1;
+
+enum MultiExpMethod
+{
+    MULTI_EXP_AUTO,      // Fixed-base tables when there are any, otherwise Pippenger
+    MULTI_EXP_LIBFF,     // libff and libsnark's multi-exponentiation, as used by their prover
+    MULTI_EXP_PIPPENGER, // Batch-affine bucket method, even if there are tables
+};
+
+/**
+* Wall time of each phase of a proof, in seconds. When A and B are
+* evaluated together their time is in `msm_A`. The witness map's
+* transforms are in `fft` rather than `witness_map`.
+*/
+struct ProverTimings
+{
+    double witness_map;
+    double fft;
+    double witness_scalars;
+    double msm_A;
+    double msm_B;
+    double msm_H;
+    double msm_L;
+};
+
+/**
+* The A, B and L multi-scalar multiplications of a proof, before r and s
+* are added. They're linear in the assignment, so the sums over disjoint
+* sets of variables add up to the sums over all of them, and the sums over
+* variables which are known early can be computed before the rest of the
+* witness (see `Groth16Prover::evaluate_sums`). H isn't linear in the
+* assignment, so it's always computed from all of it.
+*/
+struct PartialSums
+{
+    G1T A;
+    libsnark::knowledge_commitment<G2T, G1T> B;
+    G1T L;
+
+    static PartialSums zero()
+    {
+        return PartialSums{G1T::zero(), libsnark::knowledge_commitment<G2T, G1T>(G2T::zero(), G1T::zero()), G1T::zero()};
+    }
+
+    PartialSums operator+(const PartialSums &other) const
+    {
+        return PartialSums{A + other.A, libsnark::knowledge_commitment<G2T, G1T>(B.g + other.B.g, B.h + other.B.h), L + other.L};
+    }
+};
+
+/**
+* The padded assignment of a proof and its sums over all of it, from which
+* a proof of a similar assignment only needs the sums over the differences
+*/
+struct ProvedAssignment
+{
+    std::vector<FieldT> padded_assignment;
+    PartialSums sums;
+};
+
+/**
+* Buffers of one stage of a proof, e.g. the sums over some of the
+* variables, or H: the scalars, their slices for each query and the
+* multi-scalar multiplications' scratch, and H's coefficients
+*/
+struct ProverScratch
+{
+    Witness padded_witness;
+    Witness witness;
+    MsmWorkspace<FqT> G1;
+    MsmWorkspace<Fq2T> G2;
+    std::vector<FusedBases<FqT>> fused_G1;
+    std::vector<FusedBases<Fq2T>> fused_G2;
+    std::vector<JacobianPoint<FqT>> G1_sums;
+    std::vector<JacobianPoint<Fq2T>> G2_sums;
+    std::vector<uint32_t> B_ones;
+    std::vector<FieldT> coefficients_for_H;
+    QapScratch qap;
+    ArenaCounters *counters;
+
+    explicit ProverScratch(ArenaCounters *in_counters = nullptr) : padded_witness(in_counters),
+                                                                   witness(in_counters),
+                                                                   G1(in_counters),
+                                                                   G2(in_counters),
+                                                                   qap(in_counters),
+                                                                   counters(in_counters)
+    {
+    }
+};
+
+/**
+* The buffers of pipelined proofs, one scratch for each of the stages
+* which run at the same time, and the allocations made by all of them.
+* They're sized by the first proof and kept, see `Groth16Prover::prove_pipelined`.
+*/
+struct ProverArena
+{
+    ArenaCounters counters;
+    ProverScratch early;
+    ProverScratch late;
+    ProverScratch H;
+
+    ProverArena() : early(&counters), late(&counters), H(&counters)
+    {
+    }
+};
+
+template <typename F>
+void write_point(std::ostream &out, const JacobianPoint<F> &point)
+{
+    out.write(reinterpret_cast<const char *>(&point), sizeof(point));
+}
+
+template <typename F>
+bool read_point(std::istream &in, JacobianPoint<F> &out_point)
+{
+    return bool(in.read(reinterpret_cast<char *>(&out_point), sizeof(out_point)));
+}
+
+template <typename F>
+bool same_bases(const std::vector<AffinePoint<F>> &bases, const FixedBaseTable<F> &table)
+{
+    if (bases.size() != table.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < bases.size(); i++)
+    {
+        if (!(bases[i] == table.base(i)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+class Groth16Prover
+{
+public:
+    typedef libsnark::r1cs_gg_ppzksnark_zok_proof<ppT> ProofT;
+    typedef libsnark::knowledge_commitment<G2T, G1T> KnowledgeCommitmentT;
+
+    Groth16Prover(const ProvingKeyT &in_pk, size_t in_n_threads = 0) : m_pk(in_pk),
+                                                                         m_n_threads((in_n_threads == 0) ? default_threads() : in_n_threads),
+                                                                         m_method(MULTI_EXP_AUTO),
+                                                                         m_endomorphism(true),
+                                                                         m_qap(in_pk.constraint_system, m_n_threads)
+    {
+        to_affine(m_pk.A_query, m_A_bases);
+        to_affine(m_pk.H_query, m_H_bases);
+        to_affine(m_pk.L_query, m_L_bases);
+
+        std::vector<G1T> B_G1_query;
+        std::vector<G2T> B_G2_query;
+        for (const auto &value : m_pk.B_query.values)
+        {
+            B_G1_query.push_back(value.h);
+            B_G2_query.push_back(value.g);
+        }
+        to_affine(B_G1_query, m_B_G1_bases);
+        to_affine(B_G2_query, m_B_G2_bases);
+
+        // Where each variable's bases are in the sparse B query, for the fused A and B
+        const auto &B_indices = m_pk.B_query.indices;
+        m_B_positions.assign(B_indices.empty() ? 0 : (B_indices.back() + 1), uint32_t(FusedBases<FqT>::NO_POSITION));
+        for (size_t k = 0; k < B_indices.size(); k++)
+        {
+            m_B_positions[B_indices[k]] = k;
+        }
+    }
+
+    size_t n_threads() const
+    {
+        return m_n_threads;
+    }
+
+    const QapWitnessMap &qap() const
+    {
+        return m_qap;
+    }
+
+    bool has_tables() const
+    {
+        return !m_A_table.empty();
+    }
+
+    size_t tables_memory_size() const
+    {
+        return m_A_table.memory_size() + m_B_G1_table.memory_size() + m_B_G2_table.memory_size() + m_H_table.memory_size() + m_L_table.memory_size();
+    }
+
+    /**
+    * Which multi-scalar multiplication to use, for benchmarks
+    */
+    void use_method(MultiExpMethod method)
+    {
+        m_method = method;
+    }
+
+    /**
+    * Whether Pippenger and the tables built from now on split scalars with
+    * the GLV endomorphism, for benchmarks
+    */
+    void use_endomorphism(bool enabled)
+    {
+        m_endomorphism = enabled;
+    }
+
+    /**
+    * Build the fixed-base tables, `window` bits per scalar digit. Each base
+    * is stored `max_rows` times, or once for every digit when it's 0.
+    */
+    void precompute(size_t window, size_t max_rows = 0)
+    {
+        m_A_table.build(m_A_bases, window, max_rows, m_n_threads, m_endomorphism);
+        m_B_G1_table.build(m_B_G1_bases, window, max_rows, m_n_threads, m_endomorphism);
+        m_B_G2_table.build(m_B_G2_bases, window, max_rows, m_n_threads, m_endomorphism);
+        m_H_table.build(m_H_bases, window, max_rows, m_n_threads, m_endomorphism);
+        m_L_table.build(m_L_bases, window, max_rows, m_n_threads, m_endomorphism);
+    }
+
+    void clear_tables()
+    {
+        m_A_table.clear();
+        m_B_G1_table.clear();
+        m_B_G2_table.clear();
+        m_H_table.clear();
+        m_L_table.clear();
+    }
+
+    bool save_tables(const std::string &tables_file) const
+    {
+        std::ofstream out(tables_file, std::ios::binary);
+        if (!out.is_open() || !has_tables())
+        {
+            return false;
+        }
+
+        out.write(FIXED_BASE_TABLES_MAGIC, sizeof(FIXED_BASE_TABLES_MAGIC));
+        out.write(reinterpret_cast<const char *>(&FIXED_BASE_TABLES_VERSION), sizeof(FIXED_BASE_TABLES_VERSION));
+        return m_A_table.write(out) && m_B_G1_table.write(out) && m_B_G2_table.write(out) && m_H_table.write(out) && m_L_table.write(out);
+    }
+
+    /**
+    * Load tables saved by `save_tables`, they're only used if their bases
+    * are those of the proving key. Returns false if there's no valid file.
+    */
+    bool load_tables(const std::string &tables_file)
+    {
+        std::ifstream in(tables_file, std::ios::binary);
+        if (!in.is_open())
+        {
+            return false;
+        }
+
+        char magic[sizeof(FIXED_BASE_TABLES_MAGIC)];
+        uint32_t version = 0;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char *>(&version), sizeof(version));
+        if (!in || 0 != ::memcmp(magic, FIXED_BASE_TABLES_MAGIC, sizeof(magic)) || version != FIXED_BASE_TABLES_VERSION)
+        {
+            std::cerr << "Not a fixed-base tables file: " << tables_file << std::endl;
+            return false;
+        }
+
+        FixedBaseTable<FqT> A_table, B_G1_table, H_table, L_table;
+        FixedBaseTable<Fq2T> B_G2_table;
+        if (!A_table.read(in) || !B_G1_table.read(in) || !B_G2_table.read(in) || !H_table.read(in) || !L_table.read(in))
+        {
+            std::cerr << "Truncated fixed-base tables file: " << tables_file << std::endl;
+            return false;
+        }
+
+        if (!same_bases(m_A_bases, A_table) || !same_bases(m_B_G1_bases, B_G1_table) || !same_bases(m_B_G2_bases, B_G2_table) || !same_bases(m_H_bases, H_table) || !same_bases(m_L_bases, L_table))
+        {
+            std::cerr << "Fixed-base tables are for a different proving key: " << tables_file << std::endl;
+            return false;
+        }
+
+        m_A_table = std::move(A_table);
+        m_B_G1_table = std::move(B_G1_table);
+        m_B_G2_table = std::move(B_G2_table);
+        m_H_table = std::move(H_table);
+        m_L_table = std::move(L_table);
+        return true;
+    }
+
+    /**
+    * sum(A_query[i] * assignment[i]), `padded_assignment` is 1 followed by the full variable assignment
+    */
+    G1T evaluate_A(const std::vector<FieldT> &padded_assignment) const
+    {
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            const size_t n = std::min(padded_assignment.size(), m_pk.A_query.size());
+            return libff::multi_exp_with_mixed_addition<G1T, FieldT, libff::multi_exp_method_BDLO12>(
+                m_pk.A_query.begin(), m_pk.A_query.begin() + n,
+                padded_assignment.begin(), padded_assignment.begin() + n, 1);
+        }
+
+        Witness padded_witness;
+        padded_witness.assign(padded_assignment, m_n_threads);
+        return evaluate_A(padded_witness);
+    }
+
+    /**
+    * With `scratch`, its buffers are used instead of allocating new ones,
+    * as for the other sums
+    */
+    G1T evaluate_A(const Witness &padded_witness, ProverScratch *scratch = nullptr) const
+    {
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+        if (padded_witness.size() <= m_A_bases.size())
+        {
+            return to_libff(multi_exp(m_A_table, m_A_bases, padded_witness, buffers.G1));
+        }
+
+        buffers.witness.slice(padded_witness, 0, m_A_bases.size());
+        return to_libff(multi_exp(m_A_table, m_A_bases, buffers.witness, buffers.G1));
+    }
+
+    KnowledgeCommitmentT evaluate_B(const std::vector<FieldT> &padded_assignment) const
+    {
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            return libsnark::kc_multi_exp_with_mixed_addition<G2T, G1T, FieldT, libff::multi_exp_method_BDLO12>(
+                m_pk.B_query, 0, padded_assignment.size(),
+                padded_assignment.begin(), padded_assignment.end(), 1);
+        }
+
+        Witness padded_witness;
+        padded_witness.assign(padded_assignment, m_n_threads);
+        return evaluate_B(padded_witness);
+    }
+
+    KnowledgeCommitmentT evaluate_B(const Witness &padded_witness, ProverScratch *scratch = nullptr) const
+    {
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+
+        // The sparse query only holds the non-zero bases, gather the scalars of their variables
+        const auto &indices = m_pk.B_query.indices;
+        const size_t n = std::lower_bound(indices.begin(), indices.end(), padded_witness.size()) - indices.begin();
+        buffers.witness.gather(padded_witness, indices.data(), n);
+        return KnowledgeCommitmentT(to_libff(multi_exp(m_B_G2_table, m_B_G2_bases, buffers.witness, buffers.G2)),
+                                    to_libff(multi_exp(m_B_G1_table, m_B_G1_bases, buffers.witness, buffers.G1)));
+    }
+
+    /**
+    * A and B at once, every scalar of the assignment is recoded a single
+    * time for A, B in G1 and B in G2
+    */
+    void evaluate_AB(const Witness &padded_witness, G1T &out_A, KnowledgeCommitmentT &out_B, ProverScratch *scratch = nullptr) const
+    {
+        // The tables recode the scalars in each of their passes anyway
+        if ((m_method != MULTI_EXP_PIPPENGER && has_tables()) || padded_witness.size() > m_A_bases.size())
+        {
+            out_A = evaluate_A(padded_witness, scratch);
+            out_B = evaluate_B(padded_witness, scratch);
+            return;
+        }
+
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+
+        const FusedBases<FqT> A_bases{m_A_bases.data(), nullptr, 0};
+        const FusedBases<FqT> B_G1_bases{m_B_G1_bases.data(), m_B_positions.data(), m_B_positions.size()};
+        const FusedBases<Fq2T> B_G2_bases{m_B_G2_bases.data(), m_B_positions.data(), m_B_positions.size()};
+        arena_resize(buffers.fused_G1, 2, buffers.counters);
+        arena_resize(buffers.fused_G2, 1, buffers.counters);
+        buffers.fused_G1[0] = A_bases;
+        buffers.fused_G1[1] = B_G1_bases;
+        buffers.fused_G2[0] = B_G2_bases;
+
+        const auto &others = padded_witness.others();
+        fused_pippenger_msm<FqT, Fq2T>(buffers.fused_G1, buffers.fused_G2, padded_witness.scalars(), others.data(), others.size(), m_n_threads, m_endomorphism,
+                                       buffers.G1_sums, buffers.G2_sums, &buffers.G1, &buffers.G2);
+
+        const auto &A_ones = padded_witness.ones();
+        std::vector<uint32_t> &B_ones = buffers.B_ones;
+        arena_reserve(B_ones, A_ones.size(), buffers.counters);
+        B_ones.clear();
+        for (const uint32_t i : A_ones)
+        {
+            if (B_G1_bases.base(i) != nullptr)
+            {
+                B_ones.push_back(m_B_positions[i]);
+            }
+        }
+
+        out_A = to_libff(buffers.G1_sums[0] + sum_points(m_A_bases.data(), A_ones.data(), A_ones.size(), m_n_threads, &buffers.G1));
+        out_B = KnowledgeCommitmentT(to_libff(buffers.G2_sums[0] + sum_points(m_B_G2_bases.data(), B_ones.data(), B_ones.size(), m_n_threads, &buffers.G2)),
+                                     to_libff(buffers.G1_sums[1] + sum_points(m_B_G1_bases.data(), B_ones.data(), B_ones.size(), m_n_threads, &buffers.G1)));
+    }
+
+    /**
+    * sum(H_query[i] * h[i]) for the coefficients of H(X) = (A(X) * B(X) - C(X)) / Z(X)
+    */
+    G1T evaluate_H(const std::vector<FieldT> &coefficients_for_H, size_t degree, ProverScratch *scratch = nullptr) const
+    {
+        const size_t n = std::min(degree - 1, m_pk.H_query.size());
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            return libff::multi_exp<G1T, FieldT, libff::multi_exp_method_BDLO12>(
+                m_pk.H_query.begin(), m_pk.H_query.begin() + n,
+                coefficients_for_H.begin(), coefficients_for_H.begin() + n, 1);
+        }
+
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+        buffers.witness.assign(coefficients_for_H.data(), n, m_n_threads);
+        return to_libff(multi_exp(m_H_table, m_H_bases, buffers.witness, buffers.G1));
+    }
+
+    /**
+    * sum(L_query[i] * assignment[i]) over the auxiliary variables
+    */
+    G1T evaluate_L(const std::vector<FieldT> &padded_assignment, size_t num_inputs) const
+    {
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            const size_t first = num_inputs + 1;
+            const size_t n = std::min(padded_assignment.size() - first, m_pk.L_query.size());
+            return libff::multi_exp_with_mixed_addition<G1T, FieldT, libff::multi_exp_method_BDLO12>(
+                m_pk.L_query.begin(), m_pk.L_query.begin() + n,
+                padded_assignment.begin() + first, padded_assignment.begin() + first + n, 1);
+        }
+
+        Witness padded_witness;
+        padded_witness.assign(padded_assignment, m_n_threads);
+        return evaluate_L(padded_witness, num_inputs);
+    }
+
+    G1T evaluate_L(const Witness &padded_witness, size_t num_inputs, ProverScratch *scratch = nullptr) const
+    {
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+
+        const size_t first = num_inputs + 1;
+        buffers.witness.slice(padded_witness, first, first + std::min(padded_witness.size() - first, m_L_bases.size()));
+        return to_libff(multi_exp(m_L_table, m_L_bases, buffers.witness, buffers.G1));
+    }
+
+    /**
+    * The A, B and L sums over `padded_assignment` as it is, variables which
+    * are zero in it add nothing, e.g. those not known yet
+    */
+    PartialSums evaluate_sums(const std::vector<FieldT> &padded_assignment, size_t num_inputs) const
+    {
+        PartialSums sums;
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            sums.A = evaluate_A(padded_assignment);
+            sums.B = evaluate_B(padded_assignment);
+            sums.L = evaluate_L(padded_assignment, num_inputs);
+            return sums;
+        }
+
+        Witness padded_witness;
+        padded_witness.assign(padded_assignment, m_n_threads);
+        return evaluate_sums(padded_witness, num_inputs);
+    }
+
+    /**
+    * The sums over the variables of `padded_assignment`, read in place, for
+    * which `variables` is `selected`, it's false past its end
+    */
+    PartialSums evaluate_sums(const PaddedAssignment &padded_assignment, size_t num_inputs, const std::vector<bool> &variables, bool selected, ProverScratch *scratch = nullptr) const
+    {
+        const FieldT zero = FieldT::zero();
+        auto value_at = [&padded_assignment, &variables, selected, &zero](size_t i) -> const FieldT & {
+            const bool in_variables = (i < variables.size()) && variables[i];
+            return (in_variables == selected) ? padded_assignment[i] : zero;
+        };
+
+        if (m_method == MULTI_EXP_LIBFF)
+        {
+            std::vector<FieldT> assignment(padded_assignment.size());
+            for (size_t i = 0; i < assignment.size(); i++)
+            {
+                assignment[i] = value_at(i);
+            }
+            return evaluate_sums(assignment, num_inputs);
+        }
+
+        ProverScratch local_scratch;
+        ProverScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+        buffers.padded_witness.assign_each(padded_assignment.size(), value_at, m_n_threads);
+        return evaluate_sums(buffers.padded_witness, num_inputs, &buffers);
+    }
+
+    PartialSums evaluate_sums(const Witness &padded_witness, size_t num_inputs, ProverScratch *scratch = nullptr) const
+    {
+        PartialSums sums;
+        evaluate_AB(padded_witness, sums.A, sums.B, scratch);
+        sums.L = evaluate_L(padded_witness, num_inputs, scratch);
+        return sums;
+    }
+
+    /**
+    * Saves sums from `evaluate_sums` for proofs with this proving key
+    */
+    bool save_sums(std::ostream &out, const PartialSums &sums) const
+    {
+        out.write(PARTIAL_SUMS_MAGIC, sizeof(PARTIAL_SUMS_MAGIC));
+        out.write(reinterpret_cast<const char *>(&PARTIAL_SUMS_VERSION), sizeof(PARTIAL_SUMS_VERSION));
+        write_point(out, from_libff(m_pk.delta_g1));
+        write_point(out, from_libff(sums.A));
+        write_point(out, from_libff(sums.B.g));
+        write_point(out, from_libff(sums.B.h));
+        write_point(out, from_libff(sums.L));
+        return bool(out);
+    }
+
+    /**
+    * Loads sums saved by `save_sums`, unless they're for another proving key
+    */
+    bool load_sums(std::istream &in, PartialSums &out_sums) const
+    {
+        char magic[sizeof(PARTIAL_SUMS_MAGIC)];
+        uint32_t version;
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char *>(&version), sizeof(version));
+        if (!in || 0 != ::memcmp(magic, PARTIAL_SUMS_MAGIC, sizeof(magic)) || version != PARTIAL_SUMS_VERSION)
+        {
+            return false;
+        }
+
+        JacobianPoint<FqT> delta_g1, A, B_h, L;
+        JacobianPoint<Fq2T> B_g;
+        if (!read_point(in, delta_g1) || !read_point(in, A) || !read_point(in, B_g) || !read_point(in, B_h) || !read_point(in, L))
+        {
+            return false;
+        }
+        if (!(to_libff(delta_g1) == m_pk.delta_g1))
+        {
+            std::cerr << "Partial sums are for another proving key" << std::endl;
+            return false;
+        }
+
+        out_sums = PartialSums{to_libff(A), KnowledgeCommitmentT(to_libff(B_g), to_libff(B_h)), to_libff(L)};
+        return true;
+    }
+
+    ProofT prove(const libsnark::r1cs_primary_input<FieldT> &primary_input, const libsnark::r1cs_auxiliary_input<FieldT> &auxiliary_input, ProverTimings *out_timings = nullptr) const
+    {
+        return prove(primary_input, auxiliary_input, PartialSums::zero(), std::vector<bool>(), out_timings);
+    }
+
+    /**
+    * A proof where `known` holds the sums over the variables of the padded
+    * assignment for which `known_variables` is set, so only H and the sums
+    * over the other variables are computed. r and s are new for every proof.
+    * The assignment and the sums over all of it are kept in `out_proved`,
+    * if it's given, for `reprove`.
+    */
+    ProofT prove(const libsnark::r1cs_primary_input<FieldT> &primary_input, const libsnark::r1cs_auxiliary_input<FieldT> &auxiliary_input, const PartialSums &known, const std::vector<bool> &known_variables, ProverTimings *out_timings = nullptr, ProvedAssignment *out_proved = nullptr) const
+    {
+        ProverTimings timings;
+        auto phase_start = std::chrono::steady_clock::now();
+        auto end_phase = [&phase_start](double &out_seconds) {
+            const auto now = std::chrono::steady_clock::now();
+            out_seconds = std::chrono::duration<double>(now - phase_start).count();
+            phase_start = now;
+        };
+
+        std::vector<FieldT> padded_assignment;
+        std::vector<FieldT> coefficients_for_H;
+        const size_t degree = witness_map(primary_input, auxiliary_input, padded_assignment, coefficients_for_H, timings.fft);
+        end_phase(timings.witness_map);
+        timings.witness_map -= timings.fft;
+
+        if (out_proved != nullptr)
+        {
+            out_proved->padded_assignment = padded_assignment;
+        }
+
+        // H needed all of them, the known variables add nothing more to the other sums
+        for (size_t i = 0; i < std::min(known_variables.size(), padded_assignment.size()); i++)
+        {
+            if (known_variables[i])
+            {
+                padded_assignment[i] = FieldT::zero();
+            }
+        }
+
+        const bool use_libff = (m_method == MULTI_EXP_LIBFF);
+        Witness padded_witness;
+        if (!use_libff)
+        {
+            padded_witness.assign(padded_assignment, m_n_threads);
+        }
+        end_phase(timings.witness_scalars);
+
+        G1T evaluation_At;
+        KnowledgeCommitmentT evaluation_Bt;
+        if (use_libff)
+        {
+            evaluation_At = evaluate_A(padded_assignment);
+            end_phase(timings.msm_A);
+            evaluation_Bt = evaluate_B(padded_assignment);
+            end_phase(timings.msm_B);
+        }
+        else
+        {
+            evaluate_AB(padded_witness, evaluation_At, evaluation_Bt);
+            end_phase(timings.msm_A);
+            timings.msm_B = 0;
+        }
+        const G1T evaluation_Ht = evaluate_H(coefficients_for_H, degree);
+        end_phase(timings.msm_H);
+        const G1T evaluation_Lt = use_libff ? evaluate_L(padded_assignment, primary_input.size()) : evaluate_L(padded_witness, primary_input.size());
+        end_phase(timings.msm_L);
+
+        const PartialSums sums = known + PartialSums{evaluation_At, evaluation_Bt, evaluation_Lt};
+        if (out_proved != nullptr)
+        {
+            out_proved->sums = sums;
+        }
+
+        if (out_timings != nullptr)
+        {
+            *out_timings = timings;
+        }
+
+        return randomize(sums, evaluation_Ht);
+    }
+
+    /**
+    * A proof of an assignment, read in place, which only differs from
+    * `previous` in a few variables, e.g. the root, some of the path and the
+    * authenticator's nodes above it after another leaf was added. Its sums
+    * are those of `previous` plus the sums over the differences, unless
+    * more than a quarter of the variables changed. H is computed from all
+    * of it, and r and s are new as for any proof. `out_proved` may be
+    * `previous`. Buffers are kept in `arena`, as for `prove_pipelined`.
+    *
+    * All the sums' time is in `msm_A`, the FFTs' in `witness_map`.
+    */
+    ProofT reprove(const ProvedAssignment &previous, const PaddedAssignment &padded_assignment, size_t num_inputs, ProverTimings *out_timings = nullptr, ProvedAssignment *out_proved = nullptr, ProverArena *arena = nullptr) const
+    {
+        ProverArena local_arena;
+        ProverArena &buffers = (arena != nullptr) ? *arena : local_arena;
+
+        ProverTimings timings = ProverTimings();
+        auto phase_start = std::chrono::steady_clock::now();
+        auto end_phase = [&phase_start](double &out_seconds) {
+            const auto now = std::chrono::steady_clock::now();
+            out_seconds = std::chrono::duration<double>(now - phase_start).count();
+            phase_start = now;
+        };
+
+        const size_t degree = witness_map(padded_assignment, num_inputs, buffers.H.coefficients_for_H, &buffers.H.qap);
+        end_phase(timings.witness_map);
+
+        const size_t n = padded_assignment.size();
+        const std::vector<FieldT> &previous_assignment = previous.padded_assignment;
+        size_t n_changed = n;
+        if (previous_assignment.size() == n)
+        {
+            n_changed = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                n_changed += (padded_assignment[i] == previous_assignment[i]) ? 0 : 1;
+            }
+        }
+        end_phase(timings.witness_scalars);
+
+        // Differences are rarely 0 or 1, so past a point a full proof is quicker
+        const bool incremental = (n_changed <= n / 4);
+        PartialSums sums;
+        if (!incremental)
+        {
+            sums = evaluate_sums(padded_assignment, num_inputs, std::vector<bool>(), false, &buffers.late);
+        }
+        else if (m_method == MULTI_EXP_LIBFF)
+        {
+            std::vector<FieldT> differences(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                differences[i] = padded_assignment[i] - previous_assignment[i];
+            }
+            sums = previous.sums + evaluate_sums(differences, num_inputs);
+        }
+        else
+        {
+            auto difference_at = [&padded_assignment, &previous_assignment](size_t i) -> FieldT {
+                return padded_assignment[i] - previous_assignment[i];
+            };
+            buffers.late.padded_witness.assign_each(n, difference_at, m_n_threads);
+            sums = previous.sums + evaluate_sums(buffers.late.padded_witness, num_inputs, &buffers.late);
+        }
+        end_phase(timings.msm_A);
+        const G1T evaluation_Ht = evaluate_H(buffers.H.coefficients_for_H, degree, &buffers.H);
+        end_phase(timings.msm_H);
+
+        if (out_proved != nullptr)
+        {
+            out_proved->padded_assignment.resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                out_proved->padded_assignment[i] = padded_assignment[i];
+            }
+            out_proved->sums = sums;
+        }
+
+        if (out_timings != nullptr)
+        {
+            *out_timings = timings;
+        }
+
+        return randomize(sums, evaluation_Ht);
+    }
+
+    /**
+    * A proof of an assignment which is read in place, in stages as its
+    * witness is generated. The sums over `early_variables`, whose values
+    * must be final, are computed while `generate_rest()` assigns the
+    * others, which it must only do to those. Then H, the sums over the
+    * other variables and `check()`, e.g. whether the constraints are
+    * satisfied, all run at once. Returns false, without a proof, if
+    * `generate_rest` or `check` does.
+    *
+    * The stages run on the pool's workers (see `ThreadPool`). Their buffers
+    * are kept in `arena`, if it's given, so that once they're big enough
+    * for the circuit, the prover allocates nothing, whatever `generate_rest`
+    * and `check` do.
+    *
+    * If `early_known` is given, it holds the sums over `early_variables`,
+    * e.g. saved by an earlier `evaluate_sums`, and they aren't computed.
+    */
+    template <typename GenerateFn, typename CheckFn>
+    bool prove_pipelined(const PaddedAssignment &padded_assignment, size_t num_inputs, const std::vector<bool> &early_variables, GenerateFn generate_rest, CheckFn check, ProofT &out_proof, ProvedAssignment *out_proved = nullptr, ProverArena *arena = nullptr, const PartialSums *early_known = nullptr) const
+    {
+        ProverArena local_arena;
+        ProverArena &buffers = (arena != nullptr) ? *arena : local_arena;
+        ThreadPool &pool = ThreadPool::instance();
+
+        PartialSums early_sums;
+        auto early_stage = [this, &padded_assignment, num_inputs, &early_variables, &early_sums, &buffers](size_t) {
+            early_sums = evaluate_sums(padded_assignment, num_inputs, early_variables, true, &buffers.early);
+        };
+        // Without chunks the job is already done, waiting for it returns at once
+        ParallelJob early_job((early_known != nullptr) ? 0 : 1, early_stage);
+        if (early_known != nullptr)
+        {
+            early_sums = *early_known;
+        }
+        else
+        {
+            pool.submit(early_job, 1);
+        }
+
+        if (!generate_rest())
+        {
+            pool.wait(early_job);
+            return false;
+        }
+
+        G1T evaluation_Ht;
+        PartialSums sums;
+        bool checked = false;
+        parallel_tasks(3, [this, &padded_assignment, num_inputs, &early_variables, &check, &buffers, &evaluation_Ht, &sums, &checked](size_t stage) {
+            if (stage == 0)
+            {
+                const size_t degree = witness_map(padded_assignment, num_inputs, buffers.H.coefficients_for_H, &buffers.H.qap);
+                evaluation_Ht = evaluate_H(buffers.H.coefficients_for_H, degree, &buffers.H);
+            }
+            else if (stage == 1)
+            {
+                checked = check();
+            }
+            else
+            {
+                sums = evaluate_sums(padded_assignment, num_inputs, early_variables, false, &buffers.late);
+            }
+        });
+
+        pool.wait(early_job);
+        if (!checked)
+        {
+            return false;
+        }
+
+        if (out_proved != nullptr)
+        {
+            out_proved->padded_assignment.resize(padded_assignment.size());
+            for (size_t i = 0; i < padded_assignment.size(); i++)
+            {
+                out_proved->padded_assignment[i] = padded_assignment[i];
+            }
+            out_proved->sums = early_sums + sums;
+        }
+
+        out_proof = randomize(early_sums + sums, evaluation_Ht);
+        return true;
+    }
+
+protected:
+    /**
+    * The coefficients of H for an assignment read in place, returns the
+    * evaluation domain's degree. libsnark's witness map, when the domain
+    * isn't supported, needs it copied.
+    */
+    size_t witness_map(const PaddedAssignment &padded_assignment, size_t num_inputs, std::vector<FieldT> &out_coefficients_for_H, QapScratch *scratch = nullptr) const
+    {
+        if (m_qap.supported())
+        {
+            m_qap.coefficients_for_H(padded_assignment, out_coefficients_for_H, nullptr, scratch);
+            return m_qap.degree();
+        }
+
+        libsnark::r1cs_primary_input<FieldT> primary_input(num_inputs);
+        libsnark::r1cs_auxiliary_input<FieldT> auxiliary_input(padded_assignment.size() - 1 - num_inputs);
+        for (size_t i = 0; i < primary_input.size(); i++)
+        {
+            primary_input[i] = padded_assignment[1 + i];
+        }
+        for (size_t i = 0; i < auxiliary_input.size(); i++)
+        {
+            auxiliary_input[i] = padded_assignment[1 + num_inputs + i];
+        }
+        auto qap_wit = libsnark::r1cs_to_qap_witness_map(m_pk.constraint_system, primary_input, auxiliary_input, FieldT::zero(), FieldT::zero(), FieldT::zero());
+        out_coefficients_for_H = std::move(qap_wit.coefficients_for_H);
+        return qap_wit.degree();
+    }
+
+    /**
+    * The padded assignment, 1 followed by the full variable assignment, and
+    * the coefficients of H. Returns the evaluation domain's degree.
+    */
+    size_t witness_map(const libsnark::r1cs_primary_input<FieldT> &primary_input, const libsnark::r1cs_auxiliary_input<FieldT> &auxiliary_input, std::vector<FieldT> &out_padded_assignment, std::vector<FieldT> &out_coefficients_for_H, double &out_fft) const
+    {
+        out_padded_assignment.assign(1, FieldT::one());
+        if (m_qap.supported())
+        {
+            out_padded_assignment.insert(out_padded_assignment.end(), primary_input.begin(), primary_input.end());
+            out_padded_assignment.insert(out_padded_assignment.end(), auxiliary_input.begin(), auxiliary_input.end());
+            m_qap.coefficients_for_H(out_padded_assignment, out_coefficients_for_H, &out_fft);
+            return m_qap.degree();
+        }
+
+        auto qap_wit = libsnark::r1cs_to_qap_witness_map(m_pk.constraint_system, primary_input, auxiliary_input, FieldT::zero(), FieldT::zero(), FieldT::zero());
+        out_padded_assignment.insert(out_padded_assignment.end(), qap_wit.coefficients_for_ABCs.begin(), qap_wit.coefficients_for_ABCs.begin() + qap_wit.num_variables());
+        out_coefficients_for_H = std::move(qap_wit.coefficients_for_H);
+        out_fft = 0;
+        return qap_wit.degree();
+    }
+
+    /**
+    * The proof from the sums over the whole assignment and H, with new r and s
+    */
+    ProofT randomize(const PartialSums &sums, const G1T &evaluation_Ht) const
+    {
+        const FieldT r = FieldT::random_element();
+        const FieldT s = FieldT::random_element();
+
+        // r and s are secret, so everything they multiply is constant time
+        const ScalarT r_scalar = r.as_bigint();
+        const ScalarT s_scalar = s.as_bigint();
+        const ScalarT rs_scalar = (r * s).as_bigint();
+        const JacobianPoint<FqT> delta_g1 = from_libff(m_pk.delta_g1);
+
+        // A = alpha + sum(a_i * A_i(t)) + r * delta
+        G1T g1_A = m_pk.alpha_g1 + sums.A + to_libff(ct_mul(delta_g1, r_scalar));
+
+        // B = beta + sum(a_i * B_i(t)) + s * delta
+        const G1T g1_B = m_pk.beta_g1 + sums.B.h + to_libff(ct_mul(delta_g1, s_scalar));
+        G2T g2_B = m_pk.beta_g2 + sums.B.g + to_libff(ct_mul(from_libff(m_pk.delta_g2), s_scalar));
+
+        // C = sum(a_i * L_i(t)) + H(t) * Z(t) / delta + s * A + r * B - r * s * delta
+        G1T g1_C = evaluation_Ht + sums.L + to_libff(ct_mul(from_libff(g1_A), s_scalar) + ct_mul(from_libff(g1_B), r_scalar) + (-ct_mul(delta_g1, rs_scalar)));
+
+        return ProofT(std::move(g1_A), std::move(g2_B), std::move(g1_C));
+    }
+
+    /**
+    * Sum of the witness' scalars times the bases, the scalars which are 1 only add their base
+    */
+    template <typename F>
+    JacobianPoint<F> multi_exp(const FixedBaseTable<F> &table, const std::vector<AffinePoint<F>> &bases, const Witness &witness, MsmWorkspace<F> &workspace) const
+    {
+        const auto &ones = witness.ones();
+        const auto &others = witness.others();
+        const JacobianPoint<F> ones_sum = sum_points(bases.data(), ones.data(), ones.size(), m_n_threads, &workspace);
+        if (m_method != MULTI_EXP_PIPPENGER && !table.empty())
+        {
+            return ones_sum + table.multi_exp(witness.scalars(), others.data(), others.size(), m_n_threads, &workspace);
+        }
+        return ones_sum + pippenger_msm(bases.data(), witness.scalars(), others.data(), others.size(), m_n_threads, m_endomorphism, 0, &workspace);
+    }
+
+    const ProvingKeyT &m_pk;
+    const size_t m_n_threads;
+    MultiExpMethod m_method;
+    bool m_endomorphism;
+    const QapWitnessMap m_qap;
+
+    // The query bases in affine coordinates, B is split into its G1 and G2 halves
+    std::vector<AffinePoint<FqT>> m_A_bases;
+    std::vector<AffinePoint<FqT>> m_B_G1_bases;
+    std::vector<AffinePoint<Fq2T>> m_B_G2_bases;
+    std::vector<uint32_t> m_B_positions;
+    std::vector<AffinePoint<FqT>> m_H_bases;
+    std::vector<AffinePoint<FqT>> m_L_bases;
+
+    FixedBaseTable<FqT> m_A_table;
+    FixedBaseTable<FqT> m_B_G1_table;
+    FixedBaseTable<Fq2T> m_B_G2_table;
+    FixedBaseTable<FqT> m_H_table;
+    FixedBaseTable<FqT> m_L_table;
+};
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_GROTH16_HPP_
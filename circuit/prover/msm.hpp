@@ -0,0 +1,687 @@
+#ifndef MIXER_PROVER_MSM_HPP_
+#define MIXER_PROVER_MSM_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "prover/arena.hpp"
+#include "prover/curve.hpp"
+#include "prover/glv.hpp"
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* Multi-scalar multiplication with the bucket (Pippenger) method: scalars
+* are recoded into signed base 2^window digits, every point is added to the
+* bucket of its digit, then the buckets are combined with a running sum
+* which weights bucket k by k.
+*
+* Buckets are kept in affine coordinates and added to in batches, the
+* slopes of a whole batch of additions share one field inversion
+* (Montgomery's trick). An affine addition is then about 6 multiplications
+* instead of 11 for a mixed Jacobian addition.
+*
+* Terms are passed as a list of indices into the bases and scalars, see
+* `Witness`: zero scalars are left out, and the terms whose scalar is 1 are
+* only a sum of points (`sum_points`), the bucket method is for the rest.
+*
+* Their buffers can be kept in a `MsmWorkspace` between calls, so repeated
+* multiplications of the same size allocate nothing.
+*/
+
+/**
+* Number of signed digits of width `window` needed for any scalar of
+* `bits` bits, the last digit absorbs the carry out of the top window
+*/
+inline size_t signed_digits_count(size_t window, size_t bits = FieldT::num_bits)
+{
+    return (bits + 2 + window - 1) / window;
+}
+
+/**
+* Signed base 2^window digits of a scalar, each in [-2^(window-1), 2^(window-1)),
+* so a point only ever needs one of 2^(window-1) buckets
+*/
+inline void signed_digits(const ScalarT &scalar, size_t window, int32_t *out_digits, size_t n_digits)
+{
+    const int32_t half = int32_t(1) << (window - 1);
+    int32_t carry = 0;
+    for (size_t j = 0; j < n_digits; j++)
+    {
+        int32_t digit = (int32_t)scalar_window(scalar, j * window, window) + carry;
+        carry = (digit >= half) ? 1 : 0;
+        out_digits[j] = digit - (carry << window);
+    }
+}
+
+/**
+* Window for the bucket method over `n` points with scalars of `bits` bits
+* which needs the fewest field multiplications: each of the windows adds
+* every point (~6 each) then combines 2^(window-1) buckets (~27 each)
+*/
+inline size_t pippenger_window(size_t n, size_t bits = FieldT::num_bits)
+{
+    size_t best_window = 2;
+    double best_cost = 0;
+    for (size_t window = 2; window <= 22; window++)
+    {
+        const double cost = signed_digits_count(window, bits) * ((6.0 * n) + (27.0 * (size_t(1) << (window - 1))));
+        if (window == 2 || cost < best_cost)
+        {
+            best_window = window;
+            best_cost = cost;
+        }
+    }
+    return best_window;
+}
+
+/**
+* Buckets for one window of digits, added to with batches of affine additions
+*/
+template <typename F>
+class Buckets
+{
+public:
+    static const size_t MAX_BATCH_SIZE = 1024;
+
+    Buckets() : m_batch_id(1), m_batch_size(1)
+    {
+    }
+
+    explicit Buckets(size_t window) : Buckets()
+    {
+        reset(window);
+    }
+
+    /**
+    * Empty buckets for digits of `window` bits, re-using the memory of the
+    * previous ones
+    */
+    void reset(size_t window, ArenaCounters *counters = nullptr)
+    {
+        const size_t n_buckets = size_t(1) << (window - 1);
+        arena_assign(m_buckets, n_buckets, AffinePoint<F>::zero(), counters);
+        arena_assign(m_overflow, n_buckets, JacobianPoint<F>::zero(), counters);
+        arena_assign(m_batch_ids, n_buckets, uint32_t(0), counters);
+        m_batch_id = 1;
+
+        m_batch_size = std::max<size_t>(1, std::min(size_t(MAX_BATCH_SIZE), n_buckets / 4));
+        arena_reserve(m_pending_buckets, m_batch_size, counters);
+        arena_reserve(m_pending_points, m_batch_size, counters);
+        m_pending_buckets.clear();
+        m_pending_points.clear();
+        arena_resize(m_inverses, m_batch_size, counters);
+        arena_resize(m_scratch, m_batch_size, counters);
+    }
+
+    void add(int32_t digit, const AffinePoint<F> &point)
+    {
+        if (digit == 0 || point.is_zero())
+        {
+            return;
+        }
+
+        const size_t bucket = (size_t)std::abs(digit) - 1;
+        const AffinePoint<F> addend = (digit > 0) ? point : -point;
+
+        if (m_batch_ids[bucket] == m_batch_id)
+        {
+            // Already being added to in this batch, rare unless many digits are equal
+            m_overflow[bucket] = m_overflow[bucket].mixed_add(addend);
+        }
+        else if (m_buckets[bucket].is_zero())
+        {
+            m_buckets[bucket] = addend;
+        }
+        else
+        {
+            m_batch_ids[bucket] = m_batch_id;
+            m_pending_buckets.push_back(bucket);
+            m_pending_points.push_back(addend);
+            if (m_pending_buckets.size() == m_batch_size)
+            {
+                flush();
+            }
+        }
+    }
+
+    /**
+    * Sum of (k + 1) * bucket[k], empties the buckets
+    */
+    JacobianPoint<F> reduce()
+    {
+        flush();
+
+        JacobianPoint<F> running = JacobianPoint<F>::zero();
+        JacobianPoint<F> sum = JacobianPoint<F>::zero();
+        for (size_t k = m_buckets.size(); k-- > 0;)
+        {
+            running = running.mixed_add(m_buckets[k]);
+            if (!m_overflow[k].is_zero())
+            {
+                running += m_overflow[k];
+                m_overflow[k] = JacobianPoint<F>::zero();
+            }
+            sum += running;
+            m_buckets[k] = AffinePoint<F>::zero();
+        }
+        return sum;
+    }
+
+protected:
+    /**
+    * Add the pending points to their buckets, with one inversion for all the slopes
+    */
+    void flush()
+    {
+        const size_t n = m_pending_buckets.size();
+        if (n == 0)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            m_inverses[i] = affine_add_denominator(m_buckets[m_pending_buckets[i]], m_pending_points[i]);
+        }
+
+        batch_invert(m_inverses.data(), n, m_scratch.data());
+
+        for (size_t i = 0; i < n; i++)
+        {
+            affine_add_with_inverse(m_buckets[m_pending_buckets[i]], m_pending_points[i], m_inverses[i]);
+        }
+
+        m_pending_buckets.clear();
+        m_pending_points.clear();
+        m_batch_id++;
+    }
+
+    std::vector<AffinePoint<F>> m_buckets;
+
+    // Additions to buckets which were already in the batch
+    std::vector<JacobianPoint<F>> m_overflow;
+
+    // Batch which last added to each bucket
+    std::vector<uint32_t> m_batch_ids;
+    uint32_t m_batch_id;
+
+    size_t m_batch_size;
+    std::vector<size_t> m_pending_buckets;
+    std::vector<AffinePoint<F>> m_pending_points;
+    std::vector<F> m_inverses;
+    std::vector<F> m_scratch;
+};
+
+/**
+* One of the multi-scalar multiplications of `fused_pippenger_msm`. Scalar i
+* pairs with bases[i], or with bases[positions[i]] when the bases are
+* sparse, where positions past `n_positions` or NO_POSITION have no base.
+*/
+template <typename F>
+struct FusedBases
+{
+    static const uint32_t NO_POSITION = 0xFFFFFFFF;
+
+    const AffinePoint<F> *bases;
+    const uint32_t *positions;
+    size_t n_positions;
+
+    const AffinePoint<F> *base(uint32_t i) const
+    {
+        if (positions == nullptr)
+        {
+            return &bases[i];
+        }
+        return (i < n_positions && positions[i] != NO_POSITION) ? &bases[positions[i]] : nullptr;
+    }
+};
+
+/**
+* Per thread state of one multi-scalar multiplication of a fused range: the
+* points of the range's terms, zero where the scalar has no base
+*/
+template <typename F>
+class FusedBuckets
+{
+public:
+    FusedBuckets() : m_bases{nullptr, nullptr, 0},
+                     m_result(JacobianPoint<F>::zero())
+    {
+    }
+
+    /**
+    * No terms yet, for `bases` with n_points points and digits of `window` bits
+    */
+    void reset(const FusedBases<F> &bases, size_t n_points, size_t window, ArenaCounters *counters)
+    {
+        m_bases = bases;
+        arena_assign(m_points, n_points, AffinePoint<F>::zero(), counters);
+        m_buckets.reset(window, counters);
+        m_result = JacobianPoint<F>::zero();
+    }
+
+    // Term k is scalar i, split into `halves` unless that's null
+    void set_term(size_t k, uint32_t i, const GlvScalar *halves)
+    {
+        const AffinePoint<F> *base = m_bases.base(i);
+        if (base == nullptr)
+        {
+            return;
+        }
+        if (halves == nullptr)
+        {
+            m_points[k] = *base;
+            return;
+        }
+        m_points[2 * k] = halves->k1_negative ? -*base : *base;
+        m_points[(2 * k) + 1] = endomorphism(halves->k2_negative ? -*base : *base);
+    }
+
+    // Adds digit j of every point, after shifting the sum so far by a window
+    void add_window(const int32_t *digits, size_t n_digits, size_t j, size_t window)
+    {
+        for (size_t k = 0; k < window && !m_result.is_zero(); k++)
+        {
+            m_result = m_result.dbl();
+        }
+        for (size_t k = 0; k < m_points.size(); k++)
+        {
+            m_buckets.add(digits[(k * n_digits) + j], m_points[k]);
+        }
+        m_result += m_buckets.reduce();
+    }
+
+    const JacobianPoint<F> &result() const
+    {
+        return m_result;
+    }
+
+protected:
+    FusedBases<F> m_bases;
+    std::vector<AffinePoint<F>> m_points;
+    Buckets<F> m_buckets;
+    JacobianPoint<F> m_result;
+};
+
+/**
+* One thread's buffers for multi-scalar multiplications, see `MsmWorkspace`
+*/
+template <typename F>
+struct MsmScratch
+{
+    ArenaCounters *counters;
+
+    std::vector<AffinePoint<F>> points;
+    std::vector<int32_t> digits;
+    std::vector<int32_t> endomorphism_digits;
+    std::vector<F> inverses;
+    std::vector<F> scratch;
+    Buckets<F> buckets;
+
+    // Fused multiplications and their results, see `fused_pippenger_msm`
+    std::vector<FusedBuckets<F>> fused;
+    std::vector<JacobianPoint<F>> fused_sums;
+
+    MsmScratch() : counters(nullptr)
+    {
+    }
+};
+
+/**
+* Buffers of multi-scalar multiplications in one group, kept between calls
+* so that they're only allocated when they grow. A workspace must only be
+* used by one multiplication at a time.
+*/
+template <typename F>
+class MsmWorkspace
+{
+public:
+    explicit MsmWorkspace(ArenaCounters *counters = nullptr) : m_counters(counters)
+    {
+    }
+
+    /**
+    * Scratch for n_threads threads, and as many partial sums set to zero
+    */
+    void prepare(size_t n_threads)
+    {
+        if (m_threads.size() < n_threads)
+        {
+            arena_resize(m_threads, n_threads, m_counters);
+            for (auto &scratch : m_threads)
+            {
+                scratch.counters = m_counters;
+            }
+        }
+        arena_assign(m_partial_sums, n_threads, JacobianPoint<F>::zero(), m_counters);
+    }
+
+    MsmScratch<F> &thread(size_t thread_index)
+    {
+        return m_threads[thread_index];
+    }
+
+    std::vector<JacobianPoint<F>> &partial_sums()
+    {
+        return m_partial_sums;
+    }
+
+    JacobianPoint<F> total() const
+    {
+        JacobianPoint<F> result = JacobianPoint<F>::zero();
+        for (const auto &partial_sum : m_partial_sums)
+        {
+            result += partial_sum;
+        }
+        return result;
+    }
+
+    ArenaCounters *counters() const
+    {
+        return m_counters;
+    }
+
+protected:
+    ArenaCounters *m_counters;
+    std::vector<MsmScratch<F>> m_threads;
+    std::vector<JacobianPoint<F>> m_partial_sums;
+};
+
+/**
+* Sum of bases[indices[k]] for k < n. The points are added pairwise in
+* rounds, the additions of a round share one inversion, until there are
+* too few left for batching to pay off.
+*/
+template <typename F>
+JacobianPoint<F> sum_range(const AffinePoint<F> *bases, const uint32_t *indices, size_t n, MsmScratch<F> &buffers)
+{
+    static const size_t BLOCK_SIZE = 4096;
+    static const size_t MIN_BATCH_SIZE = 16;
+
+    std::vector<AffinePoint<F>> &points = buffers.points;
+    arena_reserve(points, BLOCK_SIZE, buffers.counters);
+    F *inverses = arena_resize(buffers.inverses, BLOCK_SIZE / 2, buffers.counters);
+    F *scratch = arena_resize(buffers.scratch, BLOCK_SIZE / 2, buffers.counters);
+
+    JacobianPoint<F> result = JacobianPoint<F>::zero();
+    for (size_t block = 0; block < n; block += BLOCK_SIZE)
+    {
+        points.clear();
+        for (size_t k = block; k < std::min(n, block + BLOCK_SIZE); k++)
+        {
+            if (!bases[indices[k]].is_zero())
+            {
+                points.push_back(bases[indices[k]]);
+            }
+        }
+
+        size_t remaining = points.size();
+        while (remaining >= MIN_BATCH_SIZE)
+        {
+            const size_t pairs = remaining / 2;
+            for (size_t i = 0; i < pairs; i++)
+            {
+                inverses[i] = affine_add_denominator(points[2 * i], points[(2 * i) + 1]);
+            }
+
+            batch_invert(inverses, pairs, scratch);
+
+            for (size_t i = 0; i < pairs; i++)
+            {
+                AffinePoint<F> sum = points[2 * i];
+                affine_add_with_inverse(sum, points[(2 * i) + 1], inverses[i]);
+                points[i] = sum;
+            }
+            if (remaining % 2 != 0)
+            {
+                points[pairs] = points[remaining - 1];
+            }
+            remaining = pairs + (remaining % 2);
+        }
+
+        for (size_t i = 0; i < remaining; i++)
+        {
+            result = result.mixed_add(points[i]);
+        }
+    }
+
+    return result;
+}
+
+/**
+* Sum of bases[indices[k]] for k < n, for the terms whose scalar is 1
+*/
+template <typename F>
+JacobianPoint<F> sum_points(const AffinePoint<F> *bases, const uint32_t *indices, size_t n, size_t n_threads, MsmWorkspace<F> *workspace = nullptr)
+{
+    if (n_threads == 0)
+    {
+        n_threads = default_threads();
+    }
+
+    MsmWorkspace<F> local_workspace;
+    MsmWorkspace<F> &ws = (workspace != nullptr) ? *workspace : local_workspace;
+    ws.prepare(n_threads);
+    parallel_ranges(n, n_threads, [bases, indices, &ws](size_t begin, size_t end, size_t thread_index) {
+        ws.partial_sums()[thread_index] = sum_range(bases, indices + begin, end - begin, ws.thread(thread_index));
+    });
+    return ws.total();
+}
+
+/**
+* Sum of scalars[i] * bases[i] for i = indices[k], k < n, with one window
+* of buckets at a time. The scalars must not be zero.
+*
+* With the endomorphism each term becomes k1 * P + k2 * phi(P), twice the
+* points with half the digits, which halves the bucket combinations.
+*/
+template <typename F>
+JacobianPoint<F> pippenger_range(const AffinePoint<F> *bases, const ScalarT *scalars, const uint32_t *indices, size_t n, size_t window, bool use_endomorphism, MsmScratch<F> &scratch)
+{
+    const size_t n_digits = signed_digits_count(window, use_endomorphism ? GLV_SCALAR_BITS : size_t(FieldT::num_bits));
+    const size_t n_points = use_endomorphism ? (2 * n) : n;
+
+    AffinePoint<F> *points = arena_resize(scratch.points, n_points, scratch.counters);
+    int32_t *digits = arena_resize(scratch.digits, n_points * n_digits, scratch.counters);
+    for (size_t k = 0; k < n; k++)
+    {
+        const AffinePoint<F> &base = bases[indices[k]];
+        if (!use_endomorphism)
+        {
+            points[k] = base;
+            signed_digits(scalars[indices[k]], window, &digits[k * n_digits], n_digits);
+            continue;
+        }
+
+        GlvScalar halves;
+        glv_decompose(scalars[indices[k]], halves);
+        points[2 * k] = halves.k1_negative ? -base : base;
+        points[(2 * k) + 1] = endomorphism(halves.k2_negative ? -base : base);
+        signed_digits(halves.k1, window, &digits[(2 * k) * n_digits], n_digits);
+        signed_digits(halves.k2, window, &digits[((2 * k) + 1) * n_digits], n_digits);
+    }
+
+    Buckets<F> &buckets = scratch.buckets;
+    buckets.reset(window, scratch.counters);
+    JacobianPoint<F> result = JacobianPoint<F>::zero();
+    for (size_t j = n_digits; j-- > 0;)
+    {
+        for (size_t k = 0; k < window && !result.is_zero(); k++)
+        {
+            result = result.dbl();
+        }
+
+        for (size_t k = 0; k < n_points; k++)
+        {
+            buckets.add(digits[(k * n_digits) + j], points[k]);
+        }
+        result += buckets.reduce();
+    }
+
+    return result;
+}
+
+/**
+* Sum of scalars[i] * bases[i] for i = indices[k], k < n, the terms are
+* split between threads. `window` is 0 to pick one for the number of
+* points per thread.
+*/
+template <typename F>
+JacobianPoint<F> pippenger_msm(const AffinePoint<F> *bases, const ScalarT *scalars, const uint32_t *indices, size_t n, size_t n_threads, bool use_endomorphism = true, size_t window = 0, MsmWorkspace<F> *workspace = nullptr)
+{
+    if (n_threads == 0)
+    {
+        n_threads = default_threads();
+    }
+    if (window == 0)
+    {
+        const size_t per_thread = (n + n_threads - 1) / n_threads;
+        window = use_endomorphism ? pippenger_window(2 * per_thread, GLV_SCALAR_BITS) : pippenger_window(per_thread);
+    }
+
+    MsmWorkspace<F> local_workspace;
+    MsmWorkspace<F> &ws = (workspace != nullptr) ? *workspace : local_workspace;
+    ws.prepare(n_threads);
+    parallel_ranges(n, n_threads, [bases, scalars, indices, window, use_endomorphism, &ws](size_t begin, size_t end, size_t thread_index) {
+        ws.partial_sums()[thread_index] = pippenger_range(bases, scalars, indices + begin, end - begin, window, use_endomorphism, ws.thread(thread_index));
+    });
+    return ws.total();
+}
+
+/**
+* Multi-scalar multiplications of the same scalars with different bases, in
+* G1 (`F1`) and G2 (`F2`): out_1[s] is the sum of scalars[i] times the
+* base of scalar i in bases_1[s], for i = indices[k], k < n. Each scalar is
+* recoded once for all of them. The scalars must not be zero.
+*/
+template <typename F1, typename F2>
+void fused_pippenger_msm(const std::vector<FusedBases<F1>> &bases_1, const std::vector<FusedBases<F2>> &bases_2,
+                         const ScalarT *scalars, const uint32_t *indices, size_t n, size_t n_threads, bool use_endomorphism,
+                         std::vector<JacobianPoint<F1>> &out_1, std::vector<JacobianPoint<F2>> &out_2,
+                         MsmWorkspace<F1> *workspace_1 = nullptr, MsmWorkspace<F2> *workspace_2 = nullptr)
+{
+    if (n_threads == 0)
+    {
+        n_threads = default_threads();
+    }
+    const size_t per_thread = (n + n_threads - 1) / n_threads;
+    const size_t window = use_endomorphism ? pippenger_window(2 * per_thread, GLV_SCALAR_BITS) : pippenger_window(per_thread);
+    const size_t n_digits = signed_digits_count(window, use_endomorphism ? GLV_SCALAR_BITS : size_t(FieldT::num_bits));
+
+    MsmWorkspace<F1> local_workspace_1;
+    MsmWorkspace<F2> local_workspace_2;
+    MsmWorkspace<F1> &ws_1 = (workspace_1 != nullptr) ? *workspace_1 : local_workspace_1;
+    MsmWorkspace<F2> &ws_2 = (workspace_2 != nullptr) ? *workspace_2 : local_workspace_2;
+    ws_1.prepare(n_threads);
+    ws_2.prepare(n_threads);
+
+    // Results of threads which had no range stay zero
+    for (size_t t = 0; t < n_threads; t++)
+    {
+        arena_assign(ws_1.thread(t).fused_sums, bases_1.size(), JacobianPoint<F1>::zero(), ws_1.counters());
+        arena_assign(ws_2.thread(t).fused_sums, bases_2.size(), JacobianPoint<F2>::zero(), ws_2.counters());
+    }
+
+    parallel_ranges(n, n_threads, [&](size_t begin, size_t end, size_t thread_index) {
+        const size_t n_terms = end - begin;
+        const size_t n_points = use_endomorphism ? (2 * n_terms) : n_terms;
+
+        MsmScratch<F1> &scratch_1 = ws_1.thread(thread_index);
+        MsmScratch<F2> &scratch_2 = ws_2.thread(thread_index);
+        if (scratch_1.fused.size() < bases_1.size())
+        {
+            arena_resize(scratch_1.fused, bases_1.size(), scratch_1.counters);
+        }
+        if (scratch_2.fused.size() < bases_2.size())
+        {
+            arena_resize(scratch_2.fused, bases_2.size(), scratch_2.counters);
+        }
+        FusedBuckets<F1> *buckets_1 = scratch_1.fused.data();
+        FusedBuckets<F2> *buckets_2 = scratch_2.fused.data();
+        for (size_t s = 0; s < bases_1.size(); s++)
+        {
+            buckets_1[s].reset(bases_1[s], n_points, window, scratch_1.counters);
+        }
+        for (size_t s = 0; s < bases_2.size(); s++)
+        {
+            buckets_2[s].reset(bases_2[s], n_points, window, scratch_2.counters);
+        }
+
+        // Recode each scalar once, and place its base in every multiplication
+        int32_t *digits = arena_resize(scratch_1.digits, n_points * n_digits, scratch_1.counters);
+        for (size_t k = 0; k < n_terms; k++)
+        {
+            const uint32_t i = indices[begin + k];
+            GlvScalar halves;
+            if (use_endomorphism)
+            {
+                glv_decompose(scalars[i], halves);
+                signed_digits(halves.k1, window, &digits[(2 * k) * n_digits], n_digits);
+                signed_digits(halves.k2, window, &digits[((2 * k) + 1) * n_digits], n_digits);
+            }
+            else
+            {
+                signed_digits(scalars[i], window, &digits[k * n_digits], n_digits);
+            }
+
+            for (size_t s = 0; s < bases_1.size(); s++)
+            {
+                buckets_1[s].set_term(k, i, use_endomorphism ? &halves : nullptr);
+            }
+            for (size_t s = 0; s < bases_2.size(); s++)
+            {
+                buckets_2[s].set_term(k, i, use_endomorphism ? &halves : nullptr);
+            }
+        }
+
+        // One multiplication at a time, so each streams through its own points
+        for (size_t j = n_digits; j-- > 0;)
+        {
+            for (size_t s = 0; s < bases_1.size(); s++)
+            {
+                buckets_1[s].add_window(digits, n_digits, j, window);
+            }
+            for (size_t s = 0; s < bases_2.size(); s++)
+            {
+                buckets_2[s].add_window(digits, n_digits, j, window);
+            }
+        }
+
+        for (size_t s = 0; s < bases_1.size(); s++)
+        {
+            scratch_1.fused_sums[s] = buckets_1[s].result();
+        }
+        for (size_t s = 0; s < bases_2.size(); s++)
+        {
+            scratch_2.fused_sums[s] = buckets_2[s].result();
+        }
+    });
+
+    arena_assign(out_1, bases_1.size(), JacobianPoint<F1>::zero(), ws_1.counters());
+    arena_assign(out_2, bases_2.size(), JacobianPoint<F2>::zero(), ws_2.counters());
+    for (size_t t = 0; t < n_threads; t++)
+    {
+        for (size_t s = 0; s < bases_1.size(); s++)
+        {
+            out_1[s] += ws_1.thread(t).fused_sums[s];
+        }
+        for (size_t s = 0; s < bases_2.size(); s++)
+        {
+            out_2[s] += ws_2.thread(t).fused_sums[s];
+        }
+    }
+}
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_MSM_HPP_
@@ -0,0 +1,274 @@
+#ifndef MIXER_PROVER_NTT_HPP_
+#define MIXER_PROVER_NTT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* Number theoretic transforms over Fr of power of two sizes, with all of
+* their roots of unity and twiddle factors computed once when they're set
+* up rather than on every call.
+*
+* Sizes up to 2^NTT_DIRECT_LOG_SIZE are transformed directly, they fit in
+* cache. Larger ones use the four-step decomposition of n = n1 * n2: the
+* input is transposed so its n1 columns of n2 elements are contiguous rows,
+* each row is transformed and multiplied by its twiddles, transposed back
+* and its n2 rows of n1 elements transformed. Every small transform works
+* on contiguous memory which fits in cache, the transposes go in blocks
+* and both the rows and the blocks are split across threads.
+*/
+
+static const size_t NTT_DIRECT_LOG_SIZE = 10;
+static const size_t NTT_TRANSPOSE_BLOCK = 16;
+
+/**
+* out[i] = base^i for i < n
+*/
+inline void power_table(const FieldT &base, size_t n, std::vector<FieldT> &out, size_t n_threads)
+{
+    out.resize(n);
+    parallel_ranges(n, n_threads, [&base, &out](size_t begin, size_t end, size_t) {
+        FieldT power = base ^ begin;
+        for (size_t i = begin; i < end; i++)
+        {
+            out[i] = power;
+            power *= base;
+        }
+    });
+}
+
+/**
+* In-place radix-2 transform of `n` elements, `roots[i]` = w^i for i < n / 2
+* where w is a primitive n-th root of unity
+*/
+inline void radix2_transform(FieldT *a, size_t n, const FieldT *roots)
+{
+    for (size_t i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            std::swap(a[i], a[j]);
+        }
+    }
+
+    // The first layer's twiddles are all 1
+    for (size_t i = 0; i + 1 < n; i += 2)
+    {
+        const FieldT t = a[i + 1];
+        a[i + 1] = a[i] - t;
+        a[i] += t;
+    }
+
+    for (size_t half = 2; half < n; half <<= 1)
+    {
+        const size_t stride = n / (2 * half);
+        for (size_t start = 0; start < n; start += 2 * half)
+        {
+            for (size_t j = 0; j < half; j++)
+            {
+                const FieldT t = roots[j * stride] * a[start + j + half];
+                a[start + j + half] = a[start + j] - t;
+                a[start + j] += t;
+            }
+        }
+    }
+}
+
+/**
+* out[c * rows + r] = in[r * cols + c], a block of rows per thread
+*/
+inline void transpose(const FieldT *in, FieldT *out, size_t rows, size_t cols, size_t n_threads)
+{
+    const size_t block = NTT_TRANSPOSE_BLOCK;
+    parallel_ranges((rows + block - 1) / block, n_threads, [=](size_t begin, size_t end, size_t) {
+        for (size_t row_block = begin; row_block < end; row_block++)
+        {
+            const size_t row_end = std::min(rows, (row_block + 1) * block);
+            for (size_t col_begin = 0; col_begin < cols; col_begin += block)
+            {
+                const size_t col_end = std::min(cols, col_begin + block);
+                for (size_t r = row_block * block; r < row_end; r++)
+                {
+                    for (size_t c = col_begin; c < col_end; c++)
+                    {
+                        out[c * rows + r] = in[r * cols + c];
+                    }
+                }
+            }
+        }
+    });
+}
+
+class Radix2Ntt
+{
+public:
+    Radix2Ntt() : m_n1(1), m_n2(1)
+    {
+    }
+
+    /**
+    * Tables for transforms of 2^log_size elements, `omega` must be a
+    * primitive 2^log_size-th root of unity
+    */
+    void init(size_t log_size, const FieldT &omega, size_t n_threads)
+    {
+        const size_t n = size_t(1) << log_size;
+        const FieldT omega_inverse = omega.inverse();
+        m_size_inverse = FieldT(n).inverse();
+
+        if (log_size <= NTT_DIRECT_LOG_SIZE)
+        {
+            m_n1 = 1;
+            m_n2 = n;
+            power_table(omega, n / 2, m_roots_2, 1);
+            power_table(omega_inverse, n / 2, m_inverse_roots_2, 1);
+            m_roots_1.clear();
+            m_inverse_roots_1.clear();
+            m_twiddles.clear();
+            m_inverse_twiddles.clear();
+            return;
+        }
+
+        m_n1 = size_t(1) << (log_size / 2);
+        m_n2 = n / m_n1;
+        power_table(omega ^ m_n2, m_n1 / 2, m_roots_1, 1);
+        power_table(omega_inverse ^ m_n2, m_n1 / 2, m_inverse_roots_1, 1);
+        power_table(omega ^ m_n1, m_n2 / 2, m_roots_2, 1);
+        power_table(omega_inverse ^ m_n1, m_n2 / 2, m_inverse_roots_2, 1);
+
+        // twiddles[j1 * n2 + k2] = w^(j1 * k2), the inverse's also divide by n
+        m_twiddles.resize(n);
+        m_inverse_twiddles.resize(n);
+        const size_t n2 = m_n2;
+        parallel_ranges(m_n1, n_threads, [this, &omega, &omega_inverse, n2](size_t begin, size_t end, size_t) {
+            for (size_t j1 = begin; j1 < end; j1++)
+            {
+                const FieldT step = omega ^ j1;
+                const FieldT inverse_step = omega_inverse ^ j1;
+                FieldT twiddle = FieldT::one();
+                FieldT inverse_twiddle = m_size_inverse;
+                for (size_t k2 = 0; k2 < n2; k2++)
+                {
+                    m_twiddles[j1 * n2 + k2] = twiddle;
+                    m_inverse_twiddles[j1 * n2 + k2] = inverse_twiddle;
+                    twiddle *= step;
+                    inverse_twiddle *= inverse_step;
+                }
+            }
+        });
+    }
+
+    size_t size() const
+    {
+        return m_n1 * m_n2;
+    }
+
+    /**
+    * a[i] = sum(a[j] * w^(i * j)), in place. `scratch` holds size() elements,
+    * or is null to allocate them.
+    */
+    void forward(FieldT *a, size_t n_threads, FieldT *scratch = nullptr) const
+    {
+        transform(a, m_roots_1, m_roots_2, m_twiddles, n_threads, scratch);
+    }
+
+    /**
+    * Inverse of `forward`, divides by the size
+    */
+    void inverse(FieldT *a, size_t n_threads, FieldT *scratch = nullptr) const
+    {
+        transform(a, m_inverse_roots_1, m_inverse_roots_2, m_inverse_twiddles, n_threads, scratch);
+        if (m_n1 == 1)
+        {
+            for (size_t i = 0; i < m_n2; i++)
+            {
+                a[i] *= m_size_inverse;
+            }
+        }
+    }
+
+protected:
+    void transform(FieldT *a, const std::vector<FieldT> &roots_1, const std::vector<FieldT> &roots_2, const std::vector<FieldT> &twiddles, size_t n_threads, FieldT *scratch) const
+    {
+        const size_t n1 = m_n1;
+        const size_t n2 = m_n2;
+        if (n1 == 1)
+        {
+            radix2_transform(a, n2, roots_2.data());
+            return;
+        }
+
+        // a[j1 + n1 * j2] is row j2 and column j1 of an n2 x n1 matrix
+        std::vector<FieldT> local_scratch;
+        if (scratch == nullptr)
+        {
+            local_scratch.resize(size());
+            scratch = local_scratch.data();
+        }
+        FieldT *columns = scratch;
+        transpose(a, columns, n2, n1, n_threads);
+
+        parallel_ranges(n1, n_threads, [columns, n2, &roots_2, &twiddles](size_t begin, size_t end, size_t) {
+            for (size_t j1 = begin; j1 < end; j1++)
+            {
+                FieldT *column = columns + j1 * n2;
+                radix2_transform(column, n2, roots_2.data());
+                const FieldT *column_twiddles = twiddles.data() + j1 * n2;
+                for (size_t k2 = 0; k2 < n2; k2++)
+                {
+                    column[k2] *= column_twiddles[k2];
+                }
+            }
+        });
+        transpose(columns, a, n1, n2, n_threads);
+
+        parallel_ranges(n2, n_threads, [a, n1, &roots_1](size_t begin, size_t end, size_t) {
+            for (size_t k2 = begin; k2 < end; k2++)
+            {
+                radix2_transform(a + k2 * n1, n1, roots_1.data());
+            }
+        });
+
+        // Row k2 and column k1 is element k2 + n2 * k1 of the result
+        transpose(a, columns, n2, n1, n_threads);
+        parallel_ranges(size(), n_threads, [a, columns](size_t begin, size_t end, size_t) {
+            std::copy(columns + begin, columns + end, a + begin);
+        });
+    }
+
+    size_t m_n1;
+    size_t m_n2;
+    FieldT m_size_inverse;
+
+    // Powers of the n1-th and n2-th roots of unity for the small transforms
+    std::vector<FieldT> m_roots_1;
+    std::vector<FieldT> m_inverse_roots_1;
+    std::vector<FieldT> m_roots_2;
+    std::vector<FieldT> m_inverse_roots_2;
+
+    std::vector<FieldT> m_twiddles;
+    std::vector<FieldT> m_inverse_twiddles;
+};
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_NTT_HPP_
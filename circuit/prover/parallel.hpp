@@ -0,0 +1,299 @@
+#ifndef MIXER_PROVER_PARALLEL_HPP_
+#define MIXER_PROVER_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+inline size_t default_threads()
+{
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+/*
+* Work is split between the calling thread and a pool of worker threads,
+* which are started the first time they're needed and then kept for the
+* life of the process, so splitting work doesn't start threads.
+*
+* A job is a number of chunks, run in any order by the caller and by idle
+* workers. Jobs live on their caller's stack and are queued in a linked
+* list, so submitting one allocates nothing. A worker which waits for a job
+* it submitted itself runs that job's chunks too, jobs may be nested.
+*/
+
+class ThreadPool;
+
+class ParallelJob
+{
+    friend class ThreadPool;
+
+protected:
+    void *m_fn;
+    void (*m_run)(void *fn, size_t chunk);
+    const size_t m_n_chunks;
+    std::atomic<size_t> m_next;
+    std::atomic<size_t> m_finished;
+
+    ParallelJob *m_next_job;
+    bool m_queued;
+
+    template <typename Fn>
+    static void run_chunk(void *fn, size_t chunk)
+    {
+        (*static_cast<Fn *>(fn))(chunk);
+    }
+
+    // An index past the last chunk once they're all claimed
+    size_t claim()
+    {
+        return m_next.fetch_add(1);
+    }
+
+    bool claimed() const
+    {
+        return m_next.load() >= m_n_chunks;
+    }
+
+    bool done() const
+    {
+        return m_finished.load() == m_n_chunks;
+    }
+
+    // True if it was the last chunk to finish, the job may be gone as soon as it is
+    bool run(size_t chunk)
+    {
+        m_run(m_fn, chunk);
+        const size_t n_chunks = m_n_chunks;
+        return m_finished.fetch_add(1) + 1 == n_chunks;
+    }
+
+public:
+    /**
+    * fn(chunk) is called once for each chunk in [0, n_chunks), fn must
+    * outlive the job
+    */
+    template <typename Fn>
+    ParallelJob(size_t n_chunks, Fn &fn) : m_fn(static_cast<void *>(&fn)),
+                                           m_run(&run_chunk<Fn>),
+                                           m_n_chunks(n_chunks),
+                                           m_next(0),
+                                           m_finished(0),
+                                           m_next_job(nullptr),
+                                           m_queued(false)
+    {
+    }
+
+    ParallelJob(const ParallelJob &) = delete;
+    ParallelJob &operator=(const ParallelJob &) = delete;
+
+    ~ParallelJob();
+};
+
+class ThreadPool
+{
+protected:
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_done;
+    std::vector<std::thread> m_workers;
+    ParallelJob *m_jobs;
+    std::atomic<size_t> m_threads_started;
+
+    ThreadPool() : m_jobs(nullptr), m_threads_started(0)
+    {
+    }
+
+    // The first queued job with chunks left, the others are dropped from the queue
+    ParallelJob *next_job()
+    {
+        while (m_jobs != nullptr && m_jobs->claimed())
+        {
+            m_jobs->m_queued = false;
+            m_jobs = m_jobs->m_next_job;
+        }
+        return m_jobs;
+    }
+
+    void remove(ParallelJob &job)
+    {
+        if (!job.m_queued)
+        {
+            return;
+        }
+        for (ParallelJob **it = &m_jobs; *it != nullptr; it = &(*it)->m_next_job)
+        {
+            if (*it == &job)
+            {
+                *it = job.m_next_job;
+                break;
+            }
+        }
+        job.m_queued = false;
+    }
+
+    void finished(bool last_chunk)
+    {
+        if (last_chunk)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+        }
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            ParallelJob *job = next_job();
+            if (job == nullptr)
+            {
+                m_work.wait(lock);
+                continue;
+            }
+
+            // The claimed chunk keeps the job alive until it has run
+            const size_t chunk = job->claim();
+            if (chunk >= job->m_n_chunks)
+            {
+                continue;
+            }
+            lock.unlock();
+            finished(job->run(chunk));
+            lock.lock();
+        }
+    }
+
+public:
+    /**
+    * The process' pool, its workers are never stopped
+    */
+    static ThreadPool &instance()
+    {
+        static std::once_flag once;
+        static ThreadPool *pool = nullptr;
+        std::call_once(once, []() {
+            pool = new ThreadPool();
+        });
+        return *pool;
+    }
+
+    /**
+    * Queues the job's chunks for the workers, starting workers until there
+    * are at least n_workers of them
+    */
+    void submit(ParallelJob &job, size_t n_workers)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_workers.size() < n_workers)
+        {
+            m_workers.emplace_back(&ThreadPool::work, this);
+            m_threads_started++;
+        }
+
+        ParallelJob **tail = &m_jobs;
+        while (*tail != nullptr)
+        {
+            tail = &(*tail)->m_next_job;
+        }
+        job.m_next_job = nullptr;
+        job.m_queued = true;
+        *tail = &job;
+        m_work.notify_all();
+    }
+
+    /**
+    * Runs the job's chunks which no worker has claimed on the calling
+    * thread, then waits for the others
+    */
+    void wait(ParallelJob &job)
+    {
+        for (size_t chunk = job.claim(); chunk < job.m_n_chunks; chunk = job.claim())
+        {
+            job.run(chunk);
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        remove(job);
+        m_done.wait(lock, [&job]() -> bool {
+            return job.done();
+        });
+    }
+
+    /**
+    * Worker threads started since the process began
+    */
+    size_t threads_started() const
+    {
+        return m_threads_started.load();
+    }
+};
+
+inline ParallelJob::~ParallelJob()
+{
+    // Even once its chunks have run, e.g. when an exception skipped its
+    // wait(), the job may still be queued and must leave the queue first
+    ThreadPool::instance().wait(*this);
+}
+
+/**
+* Splits [0, n) into one contiguous range per thread and runs
+* fn(begin, end, thread_index) on each, on the calling thread and the
+* pool's workers
+*/
+template <typename Fn>
+void parallel_ranges(size_t n, size_t n_threads, Fn fn)
+{
+    if (n_threads == 0)
+    {
+        n_threads = default_threads();
+    }
+    n_threads = std::max<size_t>(1, std::min(n_threads, n));
+
+    const size_t per_thread = (n + n_threads - 1) / n_threads;
+    const size_t n_ranges = (n == 0) ? 1 : ((n + per_thread - 1) / per_thread);
+    if (n_ranges == 1)
+    {
+        fn(0, n, 0);
+        return;
+    }
+
+    auto range = [n, per_thread, &fn](size_t t) {
+        fn(t * per_thread, std::min(n, (t + 1) * per_thread), t);
+    };
+    ParallelJob job(n_ranges, range);
+    ThreadPool::instance().submit(job, n_ranges - 1);
+    ThreadPool::instance().wait(job);
+}
+
+/**
+* Runs fn(task) for each task in [0, n_tasks) at the same time when there
+* are idle workers, the calling thread runs any which are left
+*/
+template <typename Fn>
+void parallel_tasks(size_t n_tasks, Fn fn)
+{
+    if (n_tasks == 0)
+    {
+        return;
+    }
+    ParallelJob job(n_tasks, fn);
+    ThreadPool::instance().submit(job, n_tasks - 1);
+    ThreadPool::instance().wait(job);
+}
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_PARALLEL_HPP_
@@ -0,0 +1,404 @@
+#ifndef MIXER_PROVER_QAP_HPP_
+#define MIXER_PROVER_QAP_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "ethsnarks.hpp"
+
+#include <libfqfft/evaluation_domain/domains/basic_radix2_domain.hpp>
+#include <libfqfft/evaluation_domain/domains/step_radix2_domain.hpp>
+#include <libfqfft/evaluation_domain/get_evaluation_domain.hpp>
+
+#include "prover/arena.hpp"
+#include "prover/ntt.hpp"
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+/*
+* libsnark's `r1cs_to_qap_witness_map` without zero knowledge terms (d1 =
+* d2 = d3 = 0, as Groth16 uses it): the coefficients of
+*
+*   H(X) = (A(X) * B(X) - C(X)) / Z(X)
+*
+* where A, B and C interpolate the constraints' linear combinations over
+* the evaluation domain and Z vanishes on it. It's computed on a coset of
+* the domain, where Z isn't 0.
+*
+* The domain is whichever libsnark picks for the constraint system, so
+* the proving key's H query matches. Radix-2 domains, 2^k points, and step
+* radix-2 domains, 2^k points and 2^j points on a coset, are transformed
+* with `Radix2Ntt`. For anything else `supported()` is false.
+*
+* A step domain's points are S0 = {w_big^i} and S1 = {w * w_small^i},
+* w being a primitive 2 * big-th root of unity. A polynomial of degree below
+* big + small is c(X) + (X^big - 1) * q(X): on S0 it's c, and X^big = -1 on
+* S1, so q is half the difference between c and the polynomial there.
+*
+* Every polynomial is interpolated once and evaluated on the coset once,
+* with H also interpolated once, and scaling by powers of the coset's
+* generator is from tables made when the map is set up.
+*/
+
+template <typename AssignmentT>
+FieldT evaluate_linear_combination(const libsnark::linear_combination<FieldT> &lc, const AssignmentT &padded_assignment)
+{
+    FieldT sum = FieldT::zero();
+    for (const auto &term : lc.terms)
+    {
+        sum += term.coeff * padded_assignment[term.index];
+    }
+    return sum;
+}
+
+/**
+* libsnark's `is_satisfied` over the padded assignment, which may be a
+* `PaddedAssignment` view, without copying it into primary and auxiliary inputs
+*/
+template <typename AssignmentT>
+bool constraints_satisfied(const libsnark::r1cs_constraint_system<FieldT> &cs, const AssignmentT &padded_assignment, size_t n_threads)
+{
+    if (padded_assignment.size() != cs.num_variables() + 1)
+    {
+        return false;
+    }
+
+    std::atomic<bool> satisfied(true);
+    parallel_ranges(cs.constraints.size(), n_threads, [&cs, &padded_assignment, &satisfied](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end && satisfied.load(std::memory_order_relaxed); i++)
+        {
+            const auto &constraint = cs.constraints[i];
+            if (!(evaluate_linear_combination(constraint.a, padded_assignment) * evaluate_linear_combination(constraint.b, padded_assignment) == evaluate_linear_combination(constraint.c, padded_assignment)))
+            {
+                satisfied = false;
+            }
+        }
+    });
+    return satisfied.load();
+}
+
+/**
+* Buffers of `QapWitnessMap::coefficients_for_H`, kept between calls
+*/
+struct QapScratch
+{
+    ArenaCounters *counters;
+    std::vector<FieldT> B;
+    std::vector<FieldT> C;
+    std::vector<FieldT> q;
+    std::vector<FieldT> on_S1;
+    std::vector<FieldT> transform;
+
+    explicit QapScratch(ArenaCounters *in_counters = nullptr) : counters(in_counters)
+    {
+    }
+};
+
+class QapWitnessMap
+{
+public:
+    typedef libsnark::r1cs_constraint_system<FieldT> ConstraintSystemT;
+
+    QapWitnessMap(const ConstraintSystemT &in_cs, size_t in_n_threads) : m_cs(in_cs),
+                                                                         m_n_threads(in_n_threads),
+                                                                         m_degree(0),
+                                                                         m_big(0),
+                                                                         m_small(0)
+    {
+        std::shared_ptr<libfqfft::evaluation_domain<FieldT>> domain;
+        try
+        {
+            domain = libfqfft::get_evaluation_domain<FieldT>(m_cs.num_constraints() + m_cs.num_inputs() + 1);
+        }
+        catch (...)
+        {
+            return;
+        }
+
+        FieldT omega;
+        const auto basic = std::dynamic_pointer_cast<libfqfft::basic_radix2_domain<FieldT>>(domain);
+        const auto step = std::dynamic_pointer_cast<libfqfft::step_radix2_domain<FieldT>>(domain);
+        if (basic)
+        {
+            m_big = domain->m;
+            m_big_ntt.init(log2_exact(m_big), basic->omega, m_n_threads);
+        }
+        else if (step)
+        {
+            m_big = step->big_m;
+            m_small = step->small_m;
+            omega = step->omega;
+            m_big_ntt.init(log2_exact(m_big), step->big_omega, m_n_threads);
+            m_small_ntt.init(log2_exact(m_small), step->small_omega, m_n_threads);
+        }
+        else
+        {
+            return;
+        }
+
+        // The constraints must be on the points in the order they're transformed
+        const FieldT big_omega = basic ? basic->omega : step->big_omega;
+        if (domain->m != m_big + m_small || !(domain->get_domain_element(1) == big_omega) || !(domain->get_domain_element(m_big - 1) == (big_omega ^ (m_big - 1))))
+        {
+            return;
+        }
+        if (step && (!(domain->get_domain_element(m_big) == omega) || !(domain->get_domain_element(m_big + 1) == omega * step->small_omega)))
+        {
+            return;
+        }
+
+        const FieldT g = FieldT::multiplicative_generator;
+        power_table(g, domain->m, m_coset_powers, m_n_threads);
+        power_table(g.inverse(), domain->m, m_coset_inverse_powers, m_n_threads);
+
+        // Z on the coset only depends on i mod big / small in g * S0, and is constant on g * S1
+        const size_t period = m_small ? (m_big / m_small) : 1;
+        for (size_t i = 0; i < period; i++)
+        {
+            m_Z_inverses.push_back(domain->compute_vanishing_polynomial(g * (big_omega ^ i)).inverse());
+        }
+        if (m_small)
+        {
+            m_Z_inverses.push_back(domain->compute_vanishing_polynomial(g * omega).inverse());
+            power_table(omega, m_big, m_omega_powers, m_n_threads);
+            power_table(omega.inverse(), m_small, m_omega_inverse_powers, m_n_threads);
+            power_table(g * omega, domain->m, m_coset_omega_powers, m_n_threads);
+            m_two_inverse = FieldT(2).inverse();
+        }
+
+        m_degree = domain->m;
+    }
+
+    bool supported() const
+    {
+        return m_degree != 0;
+    }
+
+    // Size of the evaluation domain, the degree of the QAP
+    size_t degree() const
+    {
+        return m_degree;
+    }
+
+    size_t big_size() const
+    {
+        return m_big;
+    }
+
+    size_t small_size() const
+    {
+        return m_small;
+    }
+
+    /**
+    * Coefficients of H for `padded_assignment`, 1 followed by the full
+    * variable assignment. There are degree() + 1 of them, like libsnark's,
+    * the last two are 0. The time spent in transforms goes in `out_fft_seconds`.
+    * The assignment may also be a `PaddedAssignment` view. With `scratch`
+    * the buffers, and out_H, are only allocated if they have to grow.
+    */
+    template <typename AssignmentT>
+    void coefficients_for_H(const AssignmentT &padded_assignment, std::vector<FieldT> &out_H, double *out_fft_seconds = nullptr, QapScratch *scratch = nullptr) const
+    {
+        QapScratch local_scratch;
+        QapScratch &buffers = (scratch != nullptr) ? *scratch : local_scratch;
+        arena_reserve(out_H, m_degree + 1, buffers.counters);
+        arena_resize(buffers.q, m_small, buffers.counters);
+        arena_resize(buffers.on_S1, m_small, buffers.counters);
+        arena_resize(buffers.transform, std::max(m_big_ntt.size(), m_small_ntt.size()), buffers.counters);
+
+        std::vector<FieldT> &A = out_H;
+        std::vector<FieldT> &B = buffers.B;
+        std::vector<FieldT> &C = buffers.C;
+        evaluate_constraints(padded_assignment, A, B, C, buffers.counters);
+
+        const auto fft_start = std::chrono::steady_clock::now();
+        interpolate_to_coset(A.data(), buffers);
+        interpolate_to_coset(B.data(), buffers);
+        interpolate_to_coset(C.data(), buffers);
+        std::chrono::duration<double> fft_elapsed = std::chrono::steady_clock::now() - fft_start;
+
+        const size_t period = m_small ? (m_big / m_small) : 1;
+        parallel_ranges(m_degree, m_n_threads, [this, &A, &B, &C, period](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                const FieldT &Z_inverse = (i < m_big) ? m_Z_inverses[i % period] : m_Z_inverses.back();
+                A[i] = (A[i] * B[i] - C[i]) * Z_inverse;
+            }
+        });
+
+        const auto H_start = std::chrono::steady_clock::now();
+        interpolate(A.data(), buffers);
+        parallel_ranges(m_degree, m_n_threads, [this, &A](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                A[i] *= m_coset_inverse_powers[i];
+            }
+        });
+        fft_elapsed += std::chrono::steady_clock::now() - H_start;
+
+        A.push_back(FieldT::zero());
+        if (out_fft_seconds != nullptr)
+        {
+            *out_fft_seconds = fft_elapsed.count();
+        }
+    }
+
+protected:
+    static size_t log2_exact(size_t n)
+    {
+        size_t log_n = 0;
+        while ((size_t(1) << log_n) < n)
+        {
+            log_n++;
+        }
+        return log_n;
+    }
+
+    /**
+    * A, B and C at each point of the domain, with libsnark's extra
+    * `input * 0 = 0` constraints which make the inputs independent
+    */
+    template <typename AssignmentT>
+    void evaluate_constraints(const AssignmentT &padded_assignment, std::vector<FieldT> &A, std::vector<FieldT> &B, std::vector<FieldT> &C, ArenaCounters *counters) const
+    {
+        arena_assign(A, m_degree, FieldT::zero(), counters);
+        arena_assign(B, m_degree, FieldT::zero(), counters);
+        arena_assign(C, m_degree, FieldT::zero(), counters);
+
+        const auto &constraints = m_cs.constraints;
+        parallel_ranges(constraints.size(), m_n_threads, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                A[i] = evaluate_linear_combination(constraints[i].a, padded_assignment);
+                B[i] = evaluate_linear_combination(constraints[i].b, padded_assignment);
+                C[i] = evaluate_linear_combination(constraints[i].c, padded_assignment);
+            }
+        });
+
+        for (size_t i = 0; i <= m_cs.num_inputs(); i++)
+        {
+            A[constraints.size() + i] = padded_assignment[i];
+        }
+    }
+
+    /**
+    * Values on the domain to the coefficients of the polynomial through them
+    */
+    void interpolate(FieldT *a, QapScratch &scratch) const
+    {
+        m_big_ntt.inverse(a, m_n_threads, scratch.transform.data());
+        if (m_small == 0)
+        {
+            return;
+        }
+
+        // c is now in a[0, big), its values on S1 are those of c(w * X) mod X^small - 1
+        FieldT *q = scratch.q.data();
+        fold(a, m_omega_powers.data(), m_big, q);
+        m_small_ntt.forward(q, m_n_threads, scratch.transform.data());
+
+        for (size_t i = 0; i < m_small; i++)
+        {
+            q[i] = (q[i] - a[m_big + i]) * m_two_inverse;
+        }
+        m_small_ntt.inverse(q, m_n_threads, scratch.transform.data());
+
+        // q(w * X) to q(X), then c(X) + X^big * q(X) - q(X)
+        for (size_t i = 0; i < m_small; i++)
+        {
+            const FieldT coefficient = q[i] * m_omega_inverse_powers[i];
+            a[i] -= coefficient;
+            a[m_big + i] = coefficient;
+        }
+    }
+
+    /**
+    * Values on the domain to values on its coset by the multiplicative generator g
+    */
+    void interpolate_to_coset(FieldT *a, QapScratch &scratch) const
+    {
+        interpolate(a, scratch);
+
+        // a(g * X) on S0 is that mod X^big - 1, on S1 it's a(g * w * X) mod X^small - 1
+        FieldT *on_S1 = scratch.on_S1.data();
+        if (m_small != 0)
+        {
+            fold(a, m_coset_omega_powers.data(), m_big + m_small, on_S1);
+        }
+
+        const size_t big = m_big;
+        const size_t small = m_small;
+        parallel_ranges(big, m_n_threads, [this, a, big, small](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                a[i] *= m_coset_powers[i];
+                if (i < small)
+                {
+                    a[i] += a[big + i] * m_coset_powers[big + i];
+                }
+            }
+        });
+        m_big_ntt.forward(a, m_n_threads, scratch.transform.data());
+
+        if (m_small != 0)
+        {
+            m_small_ntt.forward(on_S1, m_n_threads, scratch.transform.data());
+            std::copy(on_S1, on_S1 + m_small, a + m_big);
+        }
+    }
+
+    /**
+    * out[j] = sum(a[i] * powers[i]) over the i < n which are j mod small
+    */
+    void fold(const FieldT *a, const FieldT *powers, size_t n, FieldT *out) const
+    {
+        const size_t small = m_small;
+        parallel_ranges(small, m_n_threads, [a, powers, n, out, small](size_t begin, size_t end, size_t) {
+            for (size_t j = begin; j < end; j++)
+            {
+                FieldT sum = FieldT::zero();
+                for (size_t i = j; i < n; i += small)
+                {
+                    sum += a[i] * powers[i];
+                }
+                out[j] = sum;
+            }
+        });
+    }
+
+    const ConstraintSystemT &m_cs;
+    const size_t m_n_threads;
+    size_t m_degree;
+
+    // A basic domain only has its big part
+    size_t m_big;
+    size_t m_small;
+    Radix2Ntt m_big_ntt;
+    Radix2Ntt m_small_ntt;
+
+    std::vector<FieldT> m_coset_powers;
+    std::vector<FieldT> m_coset_inverse_powers;
+    std::vector<FieldT> m_Z_inverses;
+
+    // Step domains only
+    std::vector<FieldT> m_omega_powers;
+    std::vector<FieldT> m_omega_inverse_powers;
+    std::vector<FieldT> m_coset_omega_powers;
+    FieldT m_two_inverse;
+};
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_QAP_HPP_
@@ -0,0 +1,243 @@
+#ifndef MIXER_PROVER_WITNESS_HPP_
+#define MIXER_PROVER_WITNESS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "prover/arena.hpp"
+#include "prover/curve.hpp"
+#include "prover/parallel.hpp"
+
+namespace ethsnarks
+{
+
+namespace prover
+{
+
+enum ScalarClass
+{
+    SCALAR_ZERO,
+    SCALAR_ONE,
+    SCALAR_OTHER,
+};
+
+/**
+* The padded assignment, 1 followed by the full variable assignment, over
+* a protoboard's variables in place: `variables[i]` is variable i + 1
+*/
+class PaddedAssignment
+{
+public:
+    PaddedAssignment(const FieldT *in_variables, size_t in_n_variables) : m_one(FieldT::one()),
+                                                                           m_variables(in_variables),
+                                                                           m_n_variables(in_n_variables)
+    {
+    }
+
+    size_t size() const
+    {
+        return m_n_variables + 1;
+    }
+
+    const FieldT &operator[](size_t i) const
+    {
+        return (i == 0) ? m_one : m_variables[i - 1];
+    }
+
+protected:
+    const FieldT m_one;
+    const FieldT *m_variables;
+    size_t m_n_variables;
+};
+
+/*
+* Scalars of a multi-scalar multiplication, classified as 0, 1 or anything
+* else when they're produced.
+*
+* Most of the mixer's variables are bits: the SHA256 leaf hash's inputs,
+* message schedule and rounds, and the address bits. Their term in a
+* multi-scalar multiplication is either nothing or the base itself, so
+* only the scalars which are neither are converted and recoded.
+*
+* A witness keeps its buffers when it's assigned again, the allocations
+* made when they grow are counted in `counters` if it's given.
+*/
+class Witness
+{
+public:
+    explicit Witness(ArenaCounters *counters = nullptr) : m_counters(counters)
+    {
+    }
+
+    void assign(const std::vector<FieldT> &values, size_t n_threads = 0)
+    {
+        assign(values.data(), values.size(), n_threads);
+    }
+
+    void assign(const FieldT *values, size_t n, size_t n_threads = 0)
+    {
+        assign_each(n, [values](size_t i) -> const FieldT & { return values[i]; }, n_threads);
+    }
+
+    /**
+    * Scalars value_at(0) to value_at(n - 1), e.g. from a view of the
+    * assignment which isn't copied first
+    */
+    template <typename ValueFn>
+    void assign_each(size_t n, ValueFn value_at, size_t n_threads = 0)
+    {
+        if (n_threads == 0)
+        {
+            n_threads = default_threads();
+        }
+        arena_resize(m_scalars, n, m_counters);
+        arena_resize(m_classes, n, m_counters);
+
+        // Each thread's lists are reserved for its whole range, so they never grow while it runs
+        const size_t per_thread = (n + n_threads - 1) / n_threads;
+        if (m_thread_ones.size() < n_threads)
+        {
+            arena_resize(m_thread_ones, n_threads, m_counters);
+            arena_resize(m_thread_others, n_threads, m_counters);
+        }
+        for (size_t t = 0; t < n_threads; t++)
+        {
+            arena_reserve(m_thread_ones[t], per_thread, m_counters);
+            arena_reserve(m_thread_others[t], per_thread, m_counters);
+            m_thread_ones[t].clear();
+            m_thread_others[t].clear();
+        }
+
+        std::vector<std::vector<uint32_t>> &ones = m_thread_ones;
+        std::vector<std::vector<uint32_t>> &others = m_thread_others;
+        parallel_ranges(n, n_threads, [this, &value_at, &ones, &others](size_t begin, size_t end, size_t thread_index) {
+            const FieldT one = FieldT::one();
+            for (size_t i = begin; i < end; i++)
+            {
+                const FieldT &value = value_at(i);
+                if (value.is_zero())
+                {
+                    m_classes[i] = SCALAR_ZERO;
+                    m_scalars[i] = ScalarT(0ul);
+                }
+                else if (value == one)
+                {
+                    m_classes[i] = SCALAR_ONE;
+                    m_scalars[i] = ScalarT(1ul);
+                    ones[thread_index].push_back(i);
+                }
+                else
+                {
+                    m_classes[i] = SCALAR_OTHER;
+                    m_scalars[i] = value.as_bigint();
+                    others[thread_index].push_back(i);
+                }
+            }
+        });
+
+        // Ranges are in thread order, so the indices stay ascending
+        arena_reserve(m_ones, n, m_counters);
+        arena_reserve(m_others, n, m_counters);
+        m_ones.clear();
+        m_others.clear();
+        for (size_t t = 0; t < n_threads; t++)
+        {
+            m_ones.insert(m_ones.end(), ones[t].begin(), ones[t].end());
+            m_others.insert(m_others.end(), others[t].begin(), others[t].end());
+        }
+    }
+
+    /**
+    * Scalars [begin, end) of `from`, scalar i of `from` becomes i - begin
+    */
+    void slice(const Witness &from, size_t begin, size_t end)
+    {
+        arena_reserve(m_scalars, end - begin, m_counters);
+        arena_reserve(m_classes, end - begin, m_counters);
+        m_scalars.assign(from.m_scalars.begin() + begin, from.m_scalars.begin() + end);
+        m_classes.assign(from.m_classes.begin() + begin, from.m_classes.begin() + end);
+        slice_indices(from.m_ones, begin, end, m_ones, m_counters);
+        slice_indices(from.m_others, begin, end, m_others, m_counters);
+    }
+
+    /**
+    * Scalars indices[k] of `from` for k < n, indices must be ascending
+    */
+    void gather(const Witness &from, const size_t *indices, size_t n)
+    {
+        arena_resize(m_scalars, n, m_counters);
+        arena_resize(m_classes, n, m_counters);
+        arena_reserve(m_ones, n, m_counters);
+        arena_reserve(m_others, n, m_counters);
+        m_ones.clear();
+        m_others.clear();
+        for (size_t k = 0; k < n; k++)
+        {
+            m_scalars[k] = from.m_scalars[indices[k]];
+            m_classes[k] = from.m_classes[indices[k]];
+            if (m_classes[k] == SCALAR_ONE)
+            {
+                m_ones.push_back(k);
+            }
+            else if (m_classes[k] == SCALAR_OTHER)
+            {
+                m_others.push_back(k);
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return m_scalars.size();
+    }
+
+    const ScalarT *scalars() const
+    {
+        return m_scalars.data();
+    }
+
+    ScalarClass scalar_class(size_t i) const
+    {
+        return (ScalarClass)m_classes[i];
+    }
+
+    // Ascending indices of the scalars which are 1
+    const std::vector<uint32_t> &ones() const
+    {
+        return m_ones;
+    }
+
+    // Ascending indices of the scalars which are neither 0 nor 1
+    const std::vector<uint32_t> &others() const
+    {
+        return m_others;
+    }
+
+protected:
+    static void slice_indices(const std::vector<uint32_t> &indices, size_t begin, size_t end, std::vector<uint32_t> &out, ArenaCounters *counters)
+    {
+        const auto first = std::lower_bound(indices.begin(), indices.end(), begin);
+        const auto last = std::lower_bound(first, indices.end(), end);
+        arena_resize(out, last - first, counters);
+        for (size_t k = 0; k < out.size(); k++)
+        {
+            out[k] = first[k] - begin;
+        }
+    }
+
+    std::vector<ScalarT> m_scalars;
+    std::vector<uint8_t> m_classes;
+    std::vector<uint32_t> m_ones;
+    std::vector<uint32_t> m_others;
+
+    ArenaCounters *m_counters;
+    std::vector<std::vector<uint32_t>> m_thread_ones;
+    std::vector<std::vector<uint32_t>> m_thread_others;
+};
+
+} // namespace prover
+
+} // namespace ethsnarks
+
+#endif // MIXER_PROVER_WITNESS_HPP_
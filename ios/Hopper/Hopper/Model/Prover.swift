@@ -57,6 +57,7 @@ class Prover {
                                         nullifierSecret.description,
                                         leafAddress,
                                         &in_path) else { return nil }
+            defer { mixer_free(prf) }
             return String(cString: prf)
         }) else {
             throw ProverError.couldNotGenerateProof
@@ -1,4 +1,4 @@
-__all__ = ('Mixer',)
+__all__ = ('Mixer', 'MixerTree', 'MixerVersionedTree')
 
 import os
 import re
@@ -7,12 +7,25 @@ import ctypes
 from ethsnarks.verifier import Proof, VerifyingKey
 
 
+def _take_cstr(lib, ptr):
+    """
+    Copies a string allocated by the native library, then frees it
+    """
+    if not ptr:
+        return None
+    try:
+        return ctypes.string_at(ptr)
+    finally:
+        lib.mixer_free(ptr)
+
+
 class Mixer(object):
     def __init__(self, native_library_path, vk, pk_file=None):
         if pk_file:
             if not os.path.exists(pk_file):
                 raise RuntimeError("Proving key file doesnt exist: " + pk_file)
         self._pk_file = pk_file
+        self._prover = None
 
         if not isinstance(vk, VerifyingKey):
             if isinstance(vk, dict):
@@ -26,6 +39,10 @@ class Mixer(object):
         self._vk = vk
 
         lib = ctypes.cdll.LoadLibrary(native_library_path)
+        self._lib = lib
+
+        lib.mixer_free.argtypes = [ctypes.c_void_p]
+        lib.mixer_free.restype = None
 
         lib_tree_depth = lib.mixer_tree_depth
         lib_tree_depth.restype = ctypes.c_size_t
@@ -36,15 +53,183 @@ class Mixer(object):
         lib_prove = lib.mixer_prove
         lib_prove.argtypes = ([ctypes.c_char_p] * 6) + \
             [(ctypes.c_char_p * self.tree_depth)]
-        lib_prove.restype = ctypes.c_char_p
+        lib_prove.restype = ctypes.c_void_p
         self._prove = lib_prove
 
+        lib_prover_new = lib.mixer_prover_new
+        lib_prover_new.argtypes = [ctypes.c_char_p]
+        lib_prover_new.restype = ctypes.c_void_p
+        self._prover_new = lib_prover_new
+
+        lib_prover_prove = lib.mixer_prover_prove
+        lib_prover_prove.argtypes = [ctypes.c_void_p] + ([ctypes.c_char_p] * 5) + \
+            [(ctypes.c_char_p * self.tree_depth)]
+        lib_prover_prove.restype = ctypes.c_void_p
+        self._prover_prove = lib_prover_prove
+
+        lib_prover_prepare = lib.mixer_prover_prepare
+        lib_prover_prepare.argtypes = [ctypes.c_void_p] + ([ctypes.c_char_p] * 4)
+        lib_prover_prepare.restype = ctypes.c_int
+        self._prover_prepare = lib_prover_prepare
+
+        lib_prover_prove_prepared = lib.mixer_prover_prove_prepared
+        lib_prover_prove_prepared.argtypes = [ctypes.c_void_p] + ([ctypes.c_char_p] * 6) + \
+            [(ctypes.c_char_p * self.tree_depth)]
+        lib_prover_prove_prepared.restype = ctypes.c_void_p
+        self._prover_prove_prepared = lib_prover_prove_prepared
+
+        lib_prover_reprove = lib.mixer_prover_reprove
+        lib_prover_reprove.argtypes = [ctypes.c_void_p] + ([ctypes.c_char_p] * 5) + \
+            [(ctypes.c_char_p * self.tree_depth)]
+        lib_prover_reprove.restype = ctypes.c_void_p
+        self._prover_reprove = lib_prover_reprove
+
+        lib_prover_prove_batch = lib.mixer_prover_prove_batch
+        lib_prover_prove_batch.argtypes = [ctypes.c_void_p, ctypes.c_size_t] + ([ctypes.POINTER(ctypes.c_char_p)] * 6) + \
+            [ctypes.POINTER(ctypes.c_void_p)]
+        lib_prover_prove_batch.restype = ctypes.c_size_t
+        self._prover_prove_batch = lib_prover_prove_batch
+
+        lib_prover_precompute = lib.mixer_prover_precompute
+        lib_prover_precompute.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t]
+        lib_prover_precompute.restype = ctypes.c_size_t
+        self._prover_precompute = lib_prover_precompute
+
+        lib_prover_buffer_growth = lib.mixer_prover_buffer_growth
+        lib_prover_buffer_growth.argtypes = [ctypes.c_void_p] + ([ctypes.POINTER(ctypes.c_size_t)] * 3)
+        lib_prover_buffer_growth.restype = None
+        self._prover_buffer_growth = lib_prover_buffer_growth
+
+        lib_prover_free = lib.mixer_prover_free
+        lib_prover_free.argtypes = [ctypes.c_void_p]
+        lib_prover_free.restype = None
+        self._prover_free = lib_prover_free
+
+        lib_mimc_hash = lib.mixer_mimc_hash
+        lib_mimc_hash.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t, ctypes.c_char_p]
+        lib_mimc_hash.restype = ctypes.c_void_p
+        self._mimc_hash = lib_mimc_hash
+
+        lib_mimc_hash_batch = lib.mixer_mimc_hash_batch
+        lib_mimc_hash_batch.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t,
+                                        ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t,
+                                        ctypes.POINTER(ctypes.c_void_p)]
+        lib_mimc_hash_batch.restype = ctypes.c_int
+        self._mimc_hash_batch = lib_mimc_hash_batch
+
+        lib_leaf_hash_batch = lib.mixer_leaf_hash_batch
+        lib_leaf_hash_batch.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_char_p),
+                                        ctypes.c_size_t, ctypes.POINTER(ctypes.c_void_p),
+                                        ctypes.POINTER(ctypes.c_void_p)]
+        lib_leaf_hash_batch.restype = ctypes.c_int
+        self._leaf_hash_batch = lib_leaf_hash_batch
+
+        lib_match_leaves = lib.mixer_match_leaves
+        lib_match_leaves.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t,
+                                     ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_char_p),
+                                     ctypes.c_size_t, ctypes.POINTER(ctypes.c_long)]
+        lib_match_leaves.restype = ctypes.c_size_t
+        self._match_leaves = lib_match_leaves
+
+        lib.mixer_tree_new.argtypes = []
+        lib.mixer_tree_new.restype = ctypes.c_void_p
+        lib.mixer_tree_open.argtypes = [ctypes.c_char_p, ctypes.c_bool]
+        lib.mixer_tree_open.restype = ctypes.c_void_p
+        lib.mixer_tree_free.argtypes = [ctypes.c_void_p]
+        lib.mixer_tree_free.restype = None
+        lib.mixer_tree_append.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        lib.mixer_tree_append.restype = ctypes.c_long
+        lib.mixer_tree_append_many.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t]
+        lib.mixer_tree_append_many.restype = ctypes.c_int
+        lib.mixer_tree_size.argtypes = [ctypes.c_void_p]
+        lib.mixer_tree_size.restype = ctypes.c_size_t
+        lib.mixer_tree_root.argtypes = [ctypes.c_void_p]
+        lib.mixer_tree_root.restype = ctypes.c_void_p
+        lib.mixer_tree_path.argtypes = [ctypes.c_void_p, ctypes.c_size_t,
+                                        (ctypes.c_void_p * self.tree_depth), ctypes.c_char_p]
+        lib.mixer_tree_path.restype = ctypes.c_int
+
+        lib.mixer_tree_watch.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+        lib.mixer_tree_watch.restype = ctypes.c_int
+        lib.mixer_tree_unwatch.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+        lib.mixer_tree_unwatch.restype = ctypes.c_int
+        lib.mixer_tree_watched_path.argtypes = [ctypes.c_void_p, ctypes.c_size_t,
+                                                (ctypes.c_void_p * self.tree_depth), ctypes.c_char_p]
+        lib.mixer_tree_watched_path.restype = ctypes.c_int
+
+        lib.mixer_versioned_tree_new.argtypes = []
+        lib.mixer_versioned_tree_new.restype = ctypes.c_void_p
+        lib.mixer_versioned_tree_free.argtypes = [ctypes.c_void_p]
+        lib.mixer_versioned_tree_free.restype = None
+        lib.mixer_versioned_tree_append.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        lib.mixer_versioned_tree_append.restype = ctypes.c_long
+        lib.mixer_versioned_tree_size.argtypes = [ctypes.c_void_p]
+        lib.mixer_versioned_tree_size.restype = ctypes.c_size_t
+        lib.mixer_versioned_tree_root.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+        lib.mixer_versioned_tree_root.restype = ctypes.c_void_p
+        lib.mixer_versioned_tree_find_root.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        lib.mixer_versioned_tree_find_root.restype = ctypes.c_long
+        lib.mixer_versioned_tree_path.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_size_t,
+                                                  (ctypes.c_void_p * self.tree_depth), ctypes.c_char_p]
+        lib.mixer_versioned_tree_path.restype = ctypes.c_int
+
         lib_verify = lib.mixer_verify
         lib_verify.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
         lib_verify.restype = ctypes.c_bool
         self._verify = lib_verify
 
-    def prove(self, root, wallet_address, nullifier, nullifier_secret, address_bits, path, pk_file=None):
+    def __del__(self):
+        if getattr(self, '_prover', None):
+            self._prover_free(self._prover)
+            self._prover = None
+
+    def _get_prover(self):
+        if self._prover is None:
+            self._prover = self._prover_new(self._pk_file.encode('ascii'))
+            if not self._prover:
+                raise RuntimeError("Could not load proving key: " + self._pk_file)
+        return self._prover
+
+    def precompute(self, window=16, max_rows=0):
+        """
+        Builds fixed-base tables for the proving key, used by every following
+        proof. Returns the memory used by the tables in bytes.
+        """
+        if self._pk_file is None:
+            raise RuntimeError("No proving key file")
+        memory_size = self._prover_precompute(self._get_prover(), window, max_rows)
+        if memory_size == 0:
+            raise RuntimeError("Could not precompute fixed-base tables")
+        return memory_size
+
+    def buffer_growth(self):
+        """
+        Times the prover's buffers were enlarged and the bytes they hold,
+        which stop changing after the first proof, and the number of worker
+        threads started. Other heap allocations aren't counted.
+        """
+        growths, memory_size, threads = ctypes.c_size_t(), ctypes.c_size_t(), ctypes.c_size_t()
+        self._prover_buffer_growth(self._get_prover(), ctypes.byref(growths),
+                                   ctypes.byref(memory_size), ctypes.byref(threads))
+        return growths.value, memory_size.value, threads.value
+
+    def prepare(self, prepared_file, wallet_address, nullifier, nullifier_secret):
+        """
+        Pre-proves a deposit when it's made, saving the parts of the proof
+        which only depend on it to prepared_file for prove(). The file is
+        derived from the secret and must be kept as safe.
+        """
+        if self._pk_file is None:
+            raise RuntimeError("No proving key file")
+        args = [str(_).encode('ascii') for _ in (prepared_file, wallet_address, nullifier, nullifier_secret)]
+        if 0 != self._prover_prepare(self._get_prover(), *args):
+            raise RuntimeError("Could not prepare deposit")
+
+    def prove(self, root, wallet_address, nullifier, nullifier_secret, address_bits, path, pk_file=None, prepared_file=None, retry=False):
+        """
+        With retry=True, proves again from the last proof made by this
+        wrapper, e.g. after the root changed, only multiplying what changed.
+        """
         assert isinstance(path, (list, tuple))
         assert len(path) == self.tree_depth
         if isinstance(address_bits, (tuple, list)):
@@ -75,15 +260,126 @@ class Mixer(object):
         path_carr = (ctypes.c_char_p * len(path))()
         path_carr[:] = path
 
-        pk_file_cstr = ctypes.c_char_p(pk_file.encode('ascii'))
-
-        data = self._prove(pk_file_cstr, root, wallet_address, nullifier,
-                           nullifier_secret, address_bits, path_carr)
+        if retry:
+            if pk_file != self._pk_file or prepared_file is not None:
+                raise RuntimeError("Retries need the wrapper's proving key and no prepared deposit")
+            data = self._prover_reprove(self._get_prover(), root, wallet_address, nullifier,
+                                        nullifier_secret, address_bits, path_carr)
+        elif prepared_file is not None:
+            if pk_file != self._pk_file:
+                raise RuntimeError("Prepared deposits need the wrapper's proving key")
+            prepared_file = ctypes.c_char_p(prepared_file.encode('ascii'))
+            data = self._prover_prove_prepared(self._get_prover(), prepared_file, root, wallet_address,
+                                               nullifier, nullifier_secret, address_bits, path_carr)
+        elif pk_file == self._pk_file:
+            # Re-use the proving context, the key is only loaded once
+            data = self._prover_prove(self._get_prover(), root, wallet_address, nullifier,
+                                      nullifier_secret, address_bits, path_carr)
+        else:
+            pk_file_cstr = ctypes.c_char_p(pk_file.encode('ascii'))
+            data = self._prove(pk_file_cstr, root, wallet_address, nullifier,
+                               nullifier_secret, address_bits, path_carr)
 
+        data = _take_cstr(self._lib, data)
         if data is None:
             raise RuntimeError("Could not prove!")
         return Proof.from_json(data)
 
+    def prove_batch(self, withdrawals):
+        """
+        Proofs of many withdrawals, each a tuple of prove()'s first six
+        arguments, None for those which can't be proved
+        """
+        if self._pk_file is None:
+            raise RuntimeError("No proving key file")
+        for root, wallet_address, nullifier, nullifier_secret, address_bits, path in withdrawals:
+            assert len(path) == self.tree_depth
+            assert len(address_bits) == self.tree_depth
+
+        columns = list(zip(*withdrawals)) if withdrawals else [()] * 6
+        roots, wallet_addresses, nullifiers, nullifier_secrets = [self._cstr_array(_) for _ in columns[:4]]
+        addresses = self._cstr_array([''.join([str(_) for _ in address_bits]) for address_bits in columns[4]])
+        paths = self._cstr_array([node for path in columns[5] for node in path])
+        proofs_carr = (ctypes.c_void_p * len(withdrawals))()
+        self._prover_prove_batch(self._get_prover(), len(withdrawals), roots, wallet_addresses, nullifiers,
+                                 nullifier_secrets, addresses, paths, proofs_carr)
+        proofs = [_take_cstr(self._lib, _) for _ in proofs_carr]
+        return [(Proof.from_json(_) if _ is not None else None) for _ in proofs]
+
+    def mimc_hash(self, msgs, key=0):
+        assert isinstance(msgs, (list, tuple))
+        msgs_carr = (ctypes.c_char_p * len(msgs))()
+        msgs_carr[:] = [str(_).encode('ascii') for _ in msgs]
+        key = ctypes.c_char_p(str(key).encode('ascii'))
+        return int(_take_cstr(self._lib, self._mimc_hash(msgs_carr, len(msgs), key)))
+
+    def mimc_hash_batch(self, msgs_list, keys=None):
+        """
+        Hashes many lists of messages, all of the same length, at once
+        """
+        assert isinstance(msgs_list, (list, tuple))
+        if not msgs_list:
+            return []
+        n_msgs = len(msgs_list[0])
+        assert all(len(_) == n_msgs for _ in msgs_list)
+        flat = [str(m).encode('ascii') for msgs in msgs_list for m in msgs]
+        msgs_carr = (ctypes.c_char_p * len(flat))()
+        msgs_carr[:] = flat
+        keys_carr = None
+        if keys is not None:
+            assert len(keys) == len(msgs_list)
+            keys_carr = (ctypes.c_char_p * len(keys))()
+            keys_carr[:] = [str(_).encode('ascii') for _ in keys]
+        out_carr = (ctypes.c_void_p * len(msgs_list))()
+        if 0 != self._mimc_hash_batch(msgs_carr, n_msgs, keys_carr, len(msgs_list), out_carr):
+            raise RuntimeError("Could not hash batch")
+        return [int(_take_cstr(self._lib, _)) for _ in out_carr]
+
+    @staticmethod
+    def _cstr_array(values):
+        carr = (ctypes.c_char_p * len(values))()
+        carr[:] = [(str(_).encode('ascii') if _ is not None else None) for _ in values]
+        return carr
+
+    def leaf_hash_batch(self, secrets, wallet_addresses):
+        """
+        Leaf hashes and nullifiers of many deposits, as Mixer.makeLeafHash and Mixer.makeNullifierHash
+        """
+        assert len(secrets) == len(wallet_addresses)
+        leaves_carr = (ctypes.c_void_p * len(secrets))()
+        nullifiers_carr = (ctypes.c_void_p * len(secrets))()
+        if 0 != self._leaf_hash_batch(self._cstr_array(secrets), self._cstr_array(wallet_addresses),
+                                      len(secrets), leaves_carr, nullifiers_carr):
+            raise RuntimeError("Could not hash leaves")
+        return ([int(_take_cstr(self._lib, _)) for _ in leaves_carr],
+                [int(_take_cstr(self._lib, _)) for _ in nullifiers_carr])
+
+    def match_leaves(self, leaves, secrets, wallet_addresses):
+        """
+        Offsets of the deposits' leaves among `leaves`, e.g. from the LeafAdded
+        events in order, None for those which aren't there
+        """
+        assert len(secrets) == len(wallet_addresses)
+        offsets = (ctypes.c_long * len(secrets))()
+        self._match_leaves(self._cstr_array(leaves), len(leaves), self._cstr_array(secrets),
+                           self._cstr_array(wallet_addresses), len(secrets), offsets)
+        return [(_ if _ >= 0 else None) for _ in offsets]
+
+    def new_tree(self):
+        return MixerTree(self._lib, self.tree_depth, self._lib.mixer_tree_new())
+
+    def open_tree(self, tree_file, writable=True):
+        """
+        Tree persisted to a memory mapped file, which is created if it doesn't exist
+        """
+        tree = self._lib.mixer_tree_open(tree_file.encode('ascii'), writable)
+        if not tree:
+            raise RuntimeError("Could not open tree: " + tree_file)
+        return MixerTree(self._lib, self.tree_depth, tree)
+
+    def new_versioned_tree(self):
+        return MixerVersionedTree(self._lib, self.tree_depth)
+
     def verify(self, proof):
         if not isinstance(proof, Proof):
             raise TypeError("Invalid proof type")
@@ -93,3 +389,129 @@ class Mixer(object):
         # print("VK:", self._vk.to_json().encode('ascii'))
         # print("PF:", proof.to_json().encode('ascii'))
         return self._verify(vk_cstr, proof_cstr)
+
+
+class MixerTree(object):
+    """
+    Native incremental merkle tree, mirrors MerkleTree.sol
+    """
+    def __init__(self, lib, tree_depth, tree):
+        self._lib = lib
+        self.tree_depth = tree_depth
+        self._tree = tree
+
+    def __del__(self):
+        if getattr(self, '_tree', None):
+            self._lib.mixer_tree_free(self._tree)
+            self._tree = None
+
+    def __len__(self):
+        return self._lib.mixer_tree_size(self._tree)
+
+    def append(self, leaf):
+        assert isinstance(leaf, int)
+        offset = self._lib.mixer_tree_append(self._tree, str(leaf).encode('ascii'))
+        if offset < 0:
+            raise RuntimeError("Could not append leaf")
+        return offset
+
+    def extend(self, leaves):
+        """
+        Appends many leaves at once, each level of the tree is hashed in parallel
+        """
+        leaves_carr = (ctypes.c_char_p * len(leaves))()
+        leaves_carr[:] = [str(_).encode('ascii') for _ in leaves]
+        if 0 != self._lib.mixer_tree_append_many(self._tree, leaves_carr, len(leaves)):
+            raise RuntimeError("Could not append leaves")
+
+    @property
+    def root(self):
+        return int(_take_cstr(self._lib, self._lib.mixer_tree_root(self._tree)))
+
+    def proof(self, offset):
+        """
+        Returns the authentication path and address bits, as accepted by Mixer.prove
+        """
+        path_carr = (ctypes.c_void_p * self.tree_depth)()
+        address = ctypes.create_string_buffer(self.tree_depth + 1)
+        if 0 != self._lib.mixer_tree_path(self._tree, offset, path_carr, address):
+            raise RuntimeError("Could not get path for offset %d" % (offset,))
+        return [int(_take_cstr(self._lib, _)) for _ in path_carr], address.value.decode('ascii')
+
+    def watch(self, offset):
+        """
+        Keep the path of a leaf up to date in memory as leaves are appended
+        """
+        if 0 != self._lib.mixer_tree_watch(self._tree, offset):
+            raise RuntimeError("Could not watch offset %d" % (offset,))
+
+    def unwatch(self, offset):
+        if 0 != self._lib.mixer_tree_unwatch(self._tree, offset):
+            raise RuntimeError("Offset %d isn't watched" % (offset,))
+
+    def watched_proof(self, offset):
+        """
+        Like proof(), for a watched leaf
+        """
+        path_carr = (ctypes.c_void_p * self.tree_depth)()
+        address = ctypes.create_string_buffer(self.tree_depth + 1)
+        if 0 != self._lib.mixer_tree_watched_path(self._tree, offset, path_carr, address):
+            raise RuntimeError("Offset %d isn't watched" % (offset,))
+        return [int(_take_cstr(self._lib, _)) for _ in path_carr], address.value.decode('ascii')
+
+
+class MixerVersionedTree(object):
+    """
+    Native merkle tree which serves paths against any previous root,
+    version N being the tree with N leaves
+    """
+    def __init__(self, lib, tree_depth):
+        self._lib = lib
+        self.tree_depth = tree_depth
+        self._tree = lib.mixer_versioned_tree_new()
+
+    def __del__(self):
+        if getattr(self, '_tree', None):
+            self._lib.mixer_versioned_tree_free(self._tree)
+            self._tree = None
+
+    def __len__(self):
+        return self._lib.mixer_versioned_tree_size(self._tree)
+
+    def append(self, leaf):
+        assert isinstance(leaf, int)
+        offset = self._lib.mixer_versioned_tree_append(self._tree, str(leaf).encode('ascii'))
+        if offset < 0:
+            raise RuntimeError("Could not append leaf")
+        return offset
+
+    def root(self, version=None):
+        if version is None:
+            version = len(self)
+        root = _take_cstr(self._lib, self._lib.mixer_versioned_tree_root(self._tree, version))
+        if root is None:
+            raise RuntimeError("Unknown tree version %d" % (version,))
+        return int(root)
+
+    def roots(self, count):
+        """
+        Roots of up to `count` of the most recent versions, newest first
+        """
+        latest = len(self)
+        return [self.root(latest - i) for i in range(0, min(count, latest + 1))]
+
+    def find_version(self, root):
+        version = self._lib.mixer_versioned_tree_find_root(self._tree, str(root).encode('ascii'))
+        return None if version < 0 else version
+
+    def proof(self, offset, version=None):
+        """
+        Returns the authentication path and address bits against the root of `version`
+        """
+        if version is None:
+            version = len(self)
+        path_carr = (ctypes.c_void_p * self.tree_depth)()
+        address = ctypes.create_string_buffer(self.tree_depth + 1)
+        if 0 != self._lib.mixer_versioned_tree_path(self._tree, version, offset, path_carr, address):
+            raise RuntimeError("Could not get path for offset %d at version %d" % (offset, version))
+        return [int(_take_cstr(self._lib, _)) for _ in path_carr], address.value.decode('ascii')
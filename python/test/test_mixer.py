@@ -1,3 +1,6 @@
+import os
+import tempfile
+import threading
 import unittest
 
 from ethsnarks.mimc import mimc_hash
@@ -8,6 +11,8 @@ from ethsnarks.merkletree import MerkleTree
 from mixer import Mixer
 from hashlib import sha256
 
+SCALAR_FIELD = 21888242871839275222246405745257275088548364400416034343698204186575808495617
+
 NATIVE_LIB_PATH = native_lib_path('../.build/libmixer')
 VK_PATH = '../.keys/mixer.vk.json'
 PK_PATH = '../.keys/mixer.pk.raw'
@@ -26,15 +31,7 @@ def get_sha256_hash(left, right):
 
 
 class TestMixer(unittest.TestCase):
-    def test_make_proof(self):
-        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
-        tree_depth = wrapper.tree_depth
-
-        n_items = 2 << (tree_depth - 1)
-        tree = MerkleTree(n_items)
-        for n in range(0, 2):
-            tree.append(int(FQ.random()))
-
+    def _prove_new_leaf(self, wrapper, tree, prepared_file=None):
         wallet_address = int(FQ.random())
         nullifier_secret = int(FQ.random())
         nullifier_hash = mimc_hash(
@@ -42,6 +39,9 @@ class TestMixer(unittest.TestCase):
         leaf_hash = int(get_sha256_hash(
             to_hex(nullifier_secret), to_hex(wallet_address)), 16)
 
+        if prepared_file is not None:
+            wrapper.prepare(prepared_file, wallet_address, nullifier_hash, nullifier_secret)
+
         leaf_idx = tree.append(leaf_hash)
         self.assertEqual(leaf_idx, tree.index(leaf_hash))
 
@@ -50,17 +50,352 @@ class TestMixer(unittest.TestCase):
         self.assertTrue(leaf_proof.verify(tree.root))
 
         # Generate proof
-        snark_proof = wrapper.prove(
+        return wrapper.prove(
             tree.root,
             wallet_address,
             nullifier_hash,
             nullifier_secret,
             # (index)_2 bits reversed, i.e. [LSB, ... , MSB]
             leaf_proof.address,
-            leaf_proof.path)
+            leaf_proof.path,
+            prepared_file=prepared_file)
+
+    def test_make_proof(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree_depth = wrapper.tree_depth
+
+        n_items = 2 << (tree_depth - 1)
+        tree = MerkleTree(n_items)
+        for n in range(0, 2):
+            tree.append(int(FQ.random()))
+
+        snark_proof = self._prove_new_leaf(wrapper, tree)
+
+        self.assertTrue(wrapper.verify(snark_proof))
+
+    def test_mimc_hash(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        for n in range(0, 4):
+            x = [int(FQ.random()) for _ in range(0, n + 1)]
+            k = int(FQ.random())
+            self.assertEqual(wrapper.mimc_hash(x, k), mimc_hash(x, k))
+        self.assertEqual(wrapper.mimc_hash([1, 2]), mimc_hash([1, 2]))
+
+    def test_mimc_hash_batch(self):
+        # Odd count exercises partially filled SIMD lanes
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        msgs_list = [[int(FQ.random()), int(FQ.random())] for _ in range(0, 37)]
+        keys = [int(FQ.random()) for _ in msgs_list]
+        self.assertEqual(wrapper.mimc_hash_batch(msgs_list, keys),
+                         [mimc_hash(x, k) for x, k in zip(msgs_list, keys)])
+        self.assertEqual(wrapper.mimc_hash_batch(msgs_list),
+                         [mimc_hash(x) for x in msgs_list])
+
+    def test_leaf_hash_batch(self):
+        # Odd count exercises partially filled SIMD lanes
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        secrets = [int(FQ.random()) for _ in range(0, 37)]
+        wallet_addresses = [int(FQ.random()) % (1 << 160) for _ in secrets]
+        leaves, nullifiers = wrapper.leaf_hash_batch(secrets, wallet_addresses)
+        self.assertEqual(leaves, [int(get_sha256_hash(to_hex(s), to_hex(a)), 16)
+                                  for s, a in zip(secrets, wallet_addresses)])
+        self.assertEqual(nullifiers, [mimc_hash([s, s]) for s in secrets])
+
+    def test_match_leaves(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        secrets = [int(FQ.random()) for _ in range(0, 3)]
+        wallet_addresses = [int(FQ.random()) % (1 << 160) for _ in secrets]
+        deposits, _ = wrapper.leaf_hash_batch(secrets, wallet_addresses)
+
+        events = [int(FQ.random()) for _ in range(0, 100)]
+        events[42] = deposits[0]
+        events[7] = deposits[2]
+        self.assertEqual(wrapper.match_leaves(events, secrets, wallet_addresses), [42, None, 7])
+
+    def test_reuse_prover(self):
+        # Second proof re-uses the proving context created by the first
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+
+        for n in range(0, 2):
+            snark_proof = self._prove_new_leaf(wrapper, tree)
+            self.assertTrue(wrapper.verify(snark_proof))
+
+    def test_precompute(self):
+        # Proofs with (partial) fixed-base tables verify like any other
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        self.assertGreater(wrapper.precompute(window=8, max_rows=4), 0)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+
+        snark_proof = self._prove_new_leaf(wrapper, tree)
+        self.assertTrue(wrapper.verify(snark_proof))
+
+    def test_prepared_proof(self):
+        # Proofs of a deposit pre-proved when it was made verify like any other
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+        tree.append(int(FQ.random()))
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            prepared_file = os.path.join(tmpdir, 'deposit.prepared')
+            snark_proof = self._prove_new_leaf(wrapper, tree, prepared_file)
+            self.assertTrue(wrapper.verify(snark_proof))
+
+    def test_reprove(self):
+        # A deposit lands before the withdrawal, the retry proves against the new root
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+
+        wallet_address = int(FQ.random())
+        nullifier_secret = int(FQ.random())
+        nullifier_hash = mimc_hash([nullifier_secret, nullifier_secret])
+        leaf_hash = int(get_sha256_hash(to_hex(nullifier_secret), to_hex(wallet_address)), 16)
+        leaf_idx = tree.append(leaf_hash)
+
+        for retry in (False, True):
+            leaf_proof = tree.proof(leaf_idx)
+            snark_proof = wrapper.prove(tree.root, wallet_address, nullifier_hash, nullifier_secret,
+                                        leaf_proof.address, leaf_proof.path, retry=retry)
+            self.assertTrue(wrapper.verify(snark_proof))
+            tree.append(int(FQ.random()))
 
+    def test_prove_batch(self):
+        # Every withdrawal of a batch verifies, those with the wrong nullifier or a missing path node have no proof
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+
+        deposits = []
+        for n in range(0, 4):
+            wallet_address = int(FQ.random())
+            nullifier_secret = int(FQ.random())
+            nullifier_hash = mimc_hash([nullifier_secret, nullifier_secret])
+            leaf_hash = int(get_sha256_hash(to_hex(nullifier_secret), to_hex(wallet_address)), 16)
+            deposits.append((tree.append(leaf_hash), wallet_address, nullifier_hash, nullifier_secret))
+
+        withdrawals = []
+        for leaf_idx, wallet_address, nullifier_hash, nullifier_secret in deposits:
+            leaf_proof = tree.proof(leaf_idx)
+            withdrawals.append((tree.root, wallet_address, nullifier_hash, nullifier_secret,
+                                leaf_proof.address, leaf_proof.path))
+        withdrawals[1] = withdrawals[1][:2] + (withdrawals[1][2] + 1,) + withdrawals[1][3:]
+        withdrawals[3] = withdrawals[3][:5] + ([None] + list(withdrawals[3][5][1:]),)
+
+        snark_proofs = wrapper.prove_batch(withdrawals)
+        self.assertIsNone(snark_proofs[1])
+        self.assertIsNone(snark_proofs[3])
+        for snark_proof in (snark_proofs[0], snark_proofs[2]):
+            self.assertTrue(wrapper.verify(snark_proof))
+
+    def test_prover_buffers_settle(self):
+        # Once the first proof has sized the prover's buffers, the following ones don't grow them nor start threads
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = MerkleTree(2 << (wrapper.tree_depth - 1))
+
+        wallet_address = int(FQ.random())
+        nullifier_secret = int(FQ.random())
+        nullifier_hash = mimc_hash([nullifier_secret, nullifier_secret])
+        leaf_hash = int(get_sha256_hash(to_hex(nullifier_secret), to_hex(wallet_address)), 16)
+        leaf_idx = tree.append(leaf_hash)
+
+        counters = []
+        for n in range(0, 3):
+            leaf_proof = tree.proof(leaf_idx)
+            snark_proof = wrapper.prove(tree.root, wallet_address, nullifier_hash, nullifier_secret,
+                                        leaf_proof.address, leaf_proof.path)
+            self.assertTrue(wrapper.verify(snark_proof))
+            counters.append(wrapper.buffer_growth())
+            tree.append(int(FQ.random()))
+
+        self.assertGreater(counters[0][0], 0)
+        self.assertEqual(counters[1], counters[0])
+        self.assertEqual(counters[2], counters[0])
+
+    def test_native_tree(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH, PK_PATH)
+        tree = wrapper.new_tree()
+        self.assertEqual(tree.root, 0)
+
+        for n in range(0, 3):
+            self.assertEqual(tree.append(int(FQ.random())), n)
+
+        # Unset siblings default to MerkleTree.getUniqueLeaf
+        path, address = tree.proof(2)
+        self.assertEqual(address, '01' + '0' * (wrapper.tree_depth - 2))
+        unique_leaf = int.from_bytes(sha256((0).to_bytes(2, 'big') + (3).to_bytes(30, 'big')).digest(), 'big')
+        self.assertEqual(path[0], unique_leaf % SCALAR_FIELD)
+
+        # Root and path are the ones the circuit authenticates
+        wallet_address = int(FQ.random())
+        nullifier_secret = int(FQ.random())
+        leaf_hash = int(get_sha256_hash(
+            to_hex(nullifier_secret), to_hex(wallet_address)), 16)
+        leaf_idx = tree.append(leaf_hash)
+        path, address = tree.proof(leaf_idx)
+
+        snark_proof = wrapper.prove(
+            tree.root,
+            wallet_address,
+            mimc_hash([nullifier_secret, nullifier_secret]),
+            nullifier_secret,
+            address,
+            path)
         self.assertTrue(wrapper.verify(snark_proof))
 
+    def test_native_tree_extend(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        leaves = [int(FQ.random()) for _ in range(0, 101)]
+
+        tree = wrapper.new_tree()
+        for leaf in leaves:
+            tree.append(leaf)
+
+        bulk_tree = wrapper.new_tree()
+        bulk_tree.extend(leaves[:3])
+        bulk_tree.extend(leaves[3:])
+        self.assertEqual(len(bulk_tree), len(leaves))
+        self.assertEqual(bulk_tree.root, tree.root)
+        self.assertEqual(bulk_tree.proof(57), tree.proof(57))
+
+    def test_tree_file(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        leaves = [int(FQ.random()) for _ in range(0, 11)]
+        tree = wrapper.new_tree()
+        tree.extend(leaves)
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            tree_file = os.path.join(tmpdir, 'tree.bin')
+            file_tree = wrapper.open_tree(tree_file)
+            file_tree.extend(leaves[:5])
+            for leaf in leaves[5:]:
+                file_tree.append(leaf)
+            del file_tree
+
+            # Re-opened tree is read in place, without replaying the leaves
+            file_tree = wrapper.open_tree(tree_file, writable=False)
+            self.assertEqual(len(file_tree), len(leaves))
+            self.assertEqual(file_tree.root, tree.root)
+            self.assertEqual(file_tree.proof(4), tree.proof(4))
+            with self.assertRaises(RuntimeError):
+                file_tree.append(leaves[0])
+            del file_tree
+
+    def test_tree_file_reader(self):
+        # A read-only open follows the writer's appends, each path matches the root it was read with
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        leaves = [int(FQ.random()) for _ in range(0, 64)]
+        versioned_tree = wrapper.new_versioned_tree()
+        for leaf in leaves:
+            versioned_tree.append(leaf)
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            tree_file = os.path.join(tmpdir, 'tree.bin')
+            file_tree = wrapper.open_tree(tree_file)
+            file_tree.append(leaves[0])
+            reader = wrapper.open_tree(tree_file, writable=False)
+
+            def append_leaves():
+                for leaf in leaves[1:32]:
+                    file_tree.append(leaf)
+                file_tree.extend(leaves[32:])
+            writer = threading.Thread(target=append_leaves)
+            writer.start()
+            while writer.is_alive():
+                offset = len(reader) - 1
+                root = reader.root
+                proof = reader.proof(offset)
+                if reader.root == root:
+                    version = versioned_tree.find_version(root)
+                    self.assertIsNotNone(version)
+                    self.assertEqual(proof, versioned_tree.proof(offset, version))
+            writer.join()
+            self.assertEqual(len(reader), len(leaves))
+            self.assertEqual(reader.root, versioned_tree.root())
+
+            # A second writer can't append once the first one has
+            second_writer = wrapper.open_tree(tree_file)
+            file_tree.append(int(FQ.random()))
+            with self.assertRaises(RuntimeError):
+                second_writer.append(int(FQ.random()))
+            del second_writer, reader, file_tree
+
+    def test_tree_file_watch_reader(self):
+        # Paths watched through a read-only open follow the writer's appends
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        leaves = [int(FQ.random()) for _ in range(0, 64)]
+        versioned_tree = wrapper.new_versioned_tree()
+        for leaf in leaves:
+            versioned_tree.append(leaf)
+
+        with tempfile.TemporaryDirectory() as tmpdir:
+            tree_file = os.path.join(tmpdir, 'tree.bin')
+            file_tree = wrapper.open_tree(tree_file)
+            file_tree.extend(leaves[:8])
+            reader = wrapper.open_tree(tree_file, writable=False)
+            # One leaf already appended, one appended later
+            reader.watch(5)
+            reader.watch(40)
+
+            def append_leaves():
+                for leaf in leaves[8:]:
+                    file_tree.append(leaf)
+            writer = threading.Thread(target=append_leaves)
+            writer.start()
+            while writer.is_alive():
+                root = reader.root
+                proofs = [reader.watched_proof(5), reader.watched_proof(40)]
+                if reader.root == root:
+                    version = versioned_tree.find_version(root)
+                    self.assertIsNotNone(version)
+                    self.assertEqual(proofs, [versioned_tree.proof(5, version), versioned_tree.proof(40, version)])
+            writer.join()
+            self.assertEqual(reader.watched_proof(5), versioned_tree.proof(5))
+            self.assertEqual(reader.watched_proof(40), versioned_tree.proof(40))
+            del reader, file_tree
+
+    def test_versioned_tree(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        leaves = [int(FQ.random()) for _ in range(0, 9)]
+        tree = wrapper.new_tree()
+        versioned_tree = wrapper.new_versioned_tree()
+        self.assertEqual(versioned_tree.root(), 0)
+
+        roots = [0]
+        proofs = []
+        for leaf in leaves:
+            tree.append(leaf)
+            versioned_tree.append(leaf)
+            roots.append(tree.root)
+            proofs.append(tree.proof(2))
+        self.assertEqual(versioned_tree.roots(4), roots[::-1][:4])
+
+        # Paths against an older root are the ones served at the time
+        for version in range(3, len(leaves) + 1):
+            self.assertEqual(versioned_tree.root(version), roots[version])
+            self.assertEqual(versioned_tree.proof(2, version), proofs[version - 1])
+        self.assertEqual(versioned_tree.find_version(roots[5]), 5)
+        self.assertEqual(versioned_tree.find_version(1), None)
+
+    def test_tree_watch(self):
+        wrapper = Mixer(NATIVE_LIB_PATH, VK_PATH)
+        tree = wrapper.new_tree()
+        tree.extend([int(FQ.random()) for _ in range(0, 5)])
+
+        # Leaves which exist, and one which hasn't been deposited yet
+        watched = [1, 4, 9]
+        for offset in watched:
+            tree.watch(offset)
+        for n in range(0, 7):
+            tree.append(int(FQ.random()))
+            for offset in watched:
+                self.assertEqual(tree.watched_proof(offset), tree.proof(offset))
+        tree.extend([int(FQ.random()) for _ in range(0, 21)])
+        for offset in watched:
+            self.assertEqual(tree.watched_proof(offset), tree.proof(offset))
+
+        tree.unwatch(4)
+        with self.assertRaises(RuntimeError):
+            tree.watched_proof(4)
+
 
 if __name__ == "__main__":
     unittest.main()
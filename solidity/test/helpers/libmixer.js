@@ -3,13 +3,19 @@ const ref = require("ref");
 const ArrayType = require("ref-array");
 const StringArray = ArrayType(ref.types.CString);
 
-module.exports = ffi.Library("../.build/libmixer", {
+// Strings allocated by the library, read with takeCString or takePath
+const PointerArray = ArrayType("pointer");
+
+const lib = ffi.Library("../.build/libmixer", {
   // Retrieve depth of tree
   mixer_tree_depth: ["size_t", []],
 
+  // Release a string allocated by the library
+  mixer_free: ["void", ["pointer"]],
+
   // Create a proof for the parameters
   mixer_prove: [
-    "string",
+    "pointer",
     [
       "string", // pk_file
       "string", // in_root
@@ -21,6 +27,91 @@ module.exports = ffi.Library("../.build/libmixer", {
     ]
   ],
 
+  // Load the proving key once, for use with mixer_prover_prove
+  mixer_prover_new: ["pointer", ["string"]],
+
+  // Create a proof using a proving context
+  mixer_prover_prove: [
+    "pointer",
+    [
+      "pointer", // ctx
+      "string", // in_root
+      "string", // in_wallet_address
+      "string", // in_nullifier
+      "string", // in_nullifier_secret
+      "string", // in_address
+      StringArray // in_path
+    ]
+  ],
+
+  // Precompute fixed-base tables for a proving context, returns their size in bytes
+  mixer_prover_precompute: ["size_t", ["pointer", "size_t", "size_t"]],
+
+  // Precompute fixed-base tables and save them beside the proving key
+  mixer_precompute: ["int", ["string", "size_t", "size_t"]],
+
+  // Release a proving context
+  mixer_prover_free: ["void", ["pointer"]],
+
+  // Native MiMC hash of decimal strings
+  mixer_mimc_hash: [
+    "pointer",
+    [
+      StringArray, // in_msgs
+      "size_t", // in_count
+      "string" // in_key
+    ]
+  ],
+
+  // Native merkle tree, computes the same roots and paths as MerkleTree.sol
+  mixer_tree_new: ["pointer", []],
+  mixer_tree_open: ["pointer", ["string", "bool"]],
+  mixer_tree_free: ["void", ["pointer"]],
+  mixer_tree_append: ["long", ["pointer", "string"]],
+  mixer_tree_append_many: ["int", ["pointer", StringArray, "size_t"]],
+  mixer_tree_size: ["size_t", ["pointer"]],
+  mixer_tree_root: ["pointer", ["pointer"]],
+  mixer_tree_path: [
+    "int",
+    [
+      "pointer", // tree
+      "size_t", // in_offset
+      PointerArray, // out_path
+      "char *" // out_address
+    ]
+  ],
+
+  // Paths of watched leaves, updated as leaves are appended
+  mixer_tree_watch: ["int", ["pointer", "size_t"]],
+  mixer_tree_unwatch: ["int", ["pointer", "size_t"]],
+  mixer_tree_watched_path: [
+    "int",
+    [
+      "pointer", // tree
+      "size_t", // in_offset
+      PointerArray, // out_path
+      "char *" // out_address
+    ]
+  ],
+
+  // Native merkle tree which serves paths against any previous root
+  mixer_versioned_tree_new: ["pointer", []],
+  mixer_versioned_tree_free: ["void", ["pointer"]],
+  mixer_versioned_tree_append: ["long", ["pointer", "string"]],
+  mixer_versioned_tree_size: ["size_t", ["pointer"]],
+  mixer_versioned_tree_root: ["pointer", ["pointer", "size_t"]],
+  mixer_versioned_tree_find_root: ["long", ["pointer", "string"]],
+  mixer_versioned_tree_path: [
+    "int",
+    [
+      "pointer", // tree
+      "size_t", // in_version
+      "size_t", // in_offset
+      PointerArray, // out_path
+      "char *" // out_address
+    ]
+  ],
+
   // Verify a proof
   mixer_verify: [
     "bool",
@@ -30,3 +121,24 @@ module.exports = ffi.Library("../.build/libmixer", {
     ]
   ]
 });
+
+// Copies a string returned by the library and frees it, NULL gives null
+function takeCString(ptr) {
+  if (ref.isNull(ptr)) {
+    return null;
+  }
+  const str = ref.readCString(ptr, 0);
+  lib.mixer_free(ptr);
+  return str;
+}
+
+// Copies and frees the nodes written into a PointerArray out_path
+function takePath(outPath) {
+  const path = [];
+  for (let i = 0; i < outPath.length; i++) {
+    path.push(takeCString(outPath[i]));
+  }
+  return path;
+}
+
+module.exports = Object.assign({ PointerArray, takeCString, takePath }, lib);
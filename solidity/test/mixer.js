@@ -17,7 +17,11 @@ const PROVING_KEY_PATH = path.resolve("../.keys/mixer.pk.raw");
 const vk = require(VERIFYING_KEY_PATH);
 const { proof_to_flat, vk_to_flat } = require("../utils");
 
-const { mixer_prove, mixer_verify } = require("./helpers/libmixer");
+const {
+  mixer_prove,
+  mixer_verify,
+  takeCString
+} = require("./helpers/libmixer");
 
 const SKIP_SLOW_TESTS = true;
 
@@ -71,7 +75,7 @@ contract("Mixer", function([withdrawer1, withdrawer2, withdrawer3, relayer]) {
       leaf_address,
       path_neighbours.map(h => h.toString(10))
     ];
-    const proof_json = mixer_prove(...args);
+    const proof_json = takeCString(mixer_prove(...args));
     assert.notEqual(
       proof_json,
       null,